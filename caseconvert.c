@@ -19,8 +19,16 @@
 
 #include "caseconvert.h"
 #include "caseconvert_ui.h"
+#include "caseconvert_probes.h"
+#include "caseconvert_record.h"
+#include "caseconvert_words.h"
+#include "caseconvert_occur.h"
+#include "caseconvert_scan.h"
+#include "caseconvert_plan.h"
+#include "caseconvert_map.h"
 #include "Scintilla.h"
 #include <geany/search.h>
+#include <gio/gio.h>
 #include <stdlib.h>
 
 GeanyPlugin     *geany_plugin;
@@ -34,514 +42,369 @@ PLUGIN_SET_INFO("Case Converter",
                 "1.0",
                 "Ahmad Amireh <ahmad@amireh.net>")
 
-/* helper for freeing a list */
-#define CC_LIST_FREE(list, item_t)        \
-  item_t *__item, *__tmp_item = NULL;     \
-  for (__item = list; __item != NULL;)    \
-  {                                       \
-    __tmp_item = __item;                  \
-    __item = __item->next;                \
-    g_free(__tmp_item);                   \
-    __tmp_item = NULL;                    \
-  }
-
-static config_t config;
-
-/* tokens are generated by splitting a string using a delimiter */
-typedef struct token_t token_t;
-struct token_t {
-  gchar   *value;
-  size_t  valsz;
-  token_t *next;
-};
+static gchar *cfg_file;
 
-/* returns a set of tokens by splitting "str" using "delim" */
-static token_t* tokenize(gchar *str, gchar delim, int *nr_tokens)
+/* what caseconvert.conf held when it was last read or written; whatever
+ * differs from this in the file was edited by someone else and is merged
+ * in, never overwritten, see merge_settings() */
+typedef struct {
+  gchar     *rules;
+  rule_t    *parsed;      /* the rules, compiled, when merging them */
+  gchar     *acronyms;
+  gchar     *boundaries;
+  gboolean  capitalize;
+} settings_t;
+
+static settings_t synced;
+
+/* saves are written by a worker, a save queued while another one waits
+ * replaces it; the results are picked up on the main thread */
+typedef struct {
+  settings_t  ours;     /* to write */
+  settings_t  base;     /* what we last synced with */
+  gint        nr_rules;
+} save_job_t;
+
+static struct {
+  GThreadPool *pool;
+  GMutex      lock;
+  save_job_t  *job;       /* waiting to be written */
+  settings_t  *written;   /* written, not yet synced with */
+  settings_t  *conflict;  /* the file as someone else edited it, to be merged */
+  gboolean    failed;
+  settings_t  last;       /* last written, only the worker touches it */
+} saver;
+
+/* the file is watched and re-read in the background once it settles */
+static struct {
+  GFileMonitor  *monitor;
+  guint         timer;
+  GThread       *thread;
+  gboolean      pending;  /* it changed again while being read */
+} reload;
+
+/* state of cc_cycle_selection(): the words of the name being cycled are kept
+ * so every further style is a single emit pass over them */
+static struct {
+  GeanyDocument *doc;
+  gint          pos;    /* where the name starts in the document */
+  gchar         *src;   /* the name as first selected, the words point into it */
+  gchar         *last;  /* what was last put in the document */
+  cc_style_t    style;  /* the style of "last" */
+  cc_words_t    words;
+  cc_grammar_t  *grammar;  /* the words were split with, held until reset */
+  cc_acronyms_t *acronyms;
+} cycle;
+
+static void reset_cycle();
+
+/* the identifier index of a document (see caseconvert_occur.h) is built in
+ * the background a chunk of lines at a time, and follows the edits from then
+ * on; range conversions and counts go through it once it's complete */
+typedef struct {
+  GeanyDocument *doc;
+  cc_occur_t    *index;
+  gint          built;        /* the lines before this are indexed */
+  gboolean      complete;
+  guint         idle;         /* building it */
+  gint          edit_pos;     /* the edit announced ahead, -1 if none */
+  gint          edit_len;
+  gint          edit_first;   /* the first line it touches */
+  gint          edit_lines;   /* how many more */
+  gboolean      edit_past;    /* whether they run into those not indexed yet */
+} doc_index_t;
+
+#define CC_INDEX_CHUNK 65536 /* bytes indexed per idle call */
+
+static struct {
+  gboolean    enabled;
+  GHashTable  *docs;  /* GeanyDocument => doc_index_t */
+} indexes;
+
+/* the project wide conversion under way, see cc_convert_everywhere(); the
+ * files are scanned, listed in the message window and, once confirmed,
+ * rewritten by the workers or edited through Scintilla if they're open */
+static struct {
+  cc_scan_t *scan;
+  guint     timer;      /* polling the scan */
+  gchar     *symbol;
+  gchar     *to;
+  GPtrArray *files;     /* where it was found, real paths */
+  gboolean  rewriting;
+  gint      nr_hits;
+  gint      nr_replaced;
+  gint      nr_failed;
+} everywhere;
+
+#define CC_EVERYWHERE_POLL 100 /* ms */
+
+/* edits seen in any document, a plan is only good while none was made */
+static guint nr_edits;
+
+/* the last plan cc_plan_range() worked out, it's handed out again while
+ * the document, the rules and what was asked for stay the same; so the
+ * Convert More preview and the conversion that follows plan once */
+static struct {
+  cc_plan_t     *plan;
+  GeanyDocument *doc;
+  GeanyFiletype *filetype;    /* rules may be scoped to it */
+  guint         edits;        /* nr_edits when it was planned */
+  guint         generation;   /* the rules' */
+  gchar         *txt;
+  gint          flags;
+  gint          r_begin;
+  gint          r_end;
+} planned;
+
+/* indexes, or removes, the identifiers of lines [first, last] */
+static void index_lines(doc_index_t *di, gint first, gint last, gboolean add)
 {
-  token_t *first = NULL, *tok = NULL, *tmptok = NULL;
-  gint    bufsz = strlen(str);
-  gint    i;
-  gint    toksz = 0;
-  *nr_tokens    = 0;
-
-  for (i = 0; i < bufsz; ++i)
-  {
-    if (str[i] == delim || (i + 1 == bufsz && ++i && ++toksz))
-    {
-      /* define token */
-      tok = g_malloc(sizeof(token_t));
-      tok->next = NULL;
-      tok->valsz = toksz;
-      tok->value = g_strndup(&str[i-toksz], toksz);
+  ScintillaObject *sci = di->doc->editor->sci;
+  gint            begin = sci_get_position_from_line(sci, first);
+  gint            end = sci_get_line_end_position(sci, last);
+  gchar           *text = NULL;
 
-      if (tmptok)
-      {
-        tmptok->next = tok;
-      }
-
-      if (!first) first = tok;
-
-      tmptok = tok;
-      toksz = 0;
-
-      ++(*nr_tokens);
+  if (first > last || begin >= end)
+    return;
 
-      continue;
-    }
+  text = sci_get_contents_range(sci, begin, end);
 
-    ++toksz;
-  }
+  if (add)
+    cc_occur_add_text(di->index, text, end - begin, first);
+  else
+    cc_occur_remove_text(di->index, text, end - begin, first);
 
-  return first;
+  g_free(text);
 }
 
-#ifdef VERBOSE
-  void cc_log(const char *fmt, ...)
-  {
-    va_list args;
-    char *msg = NULL;
-    va_start(args, fmt);
-    g_vasprintf(&msg, fmt, args);
-    va_end(args);
-
-    g_printf(msg);
-    free(msg);
-  }
-#else
-  void cc_log(G_GNUC_UNUSED const char *fmt, ...)
-  {
-  }
-#endif
-
-void cc_add_rule(rule_t *r)
+static gboolean on_index_idle(gpointer data)
 {
-  action_t *act = NULL;
-  rule_t   *tmprule  = NULL;
-  gint i = 0;
+  doc_index_t     *di = data;
+  ScintillaObject *sci = di->doc->editor->sci;
+  gint            begin = sci_get_position_from_line(sci, di->built);
+  gint            last = sci_get_line_from_position(sci,
+                           MIN(begin + CC_INDEX_CHUNK, sci_get_length(sci)));
 
-  cc_log("adding rule: \n");
-  cc_log("\tlabel: '%s'\n", r->label ? r->label : "Unlabelled");
-  cc_log("\tdomain: '%s'\n", r->domain == CC_RULE_C2S ? "camelToSnake" : "snake_to_camel");
-  cc_log("\tcondition: '%s' (%d)\n", r->condition->value, r->condition->type);
+  index_lines(di, di->built, last, TRUE);
+  di->built = last + 1;
 
-  cc_log("\tactions: \n");
-  for (act = r->actions; act != NULL; act = act->next, ++i)
-  {
-    cc_log("\t\t(%d). '%s' (%d)\n", i, act->value, act->type);
-  }
+  if (di->built < sci_get_line_count(sci))
+    return TRUE;
 
-  if (!config.rules) {
-    /* first rule */
-    config.rules = r;
-  }
-  else {
-    /* append to the end of the rule list */
-    for (tmprule = config.rules; tmprule != NULL; tmprule = tmprule->next) {
-      if (tmprule->next == NULL) {
-        tmprule->next = r;
-        break;
-      }
-    }
-  }
-}
+  cc_debug("indexed %d identifiers in document %d\n", cc_occur_size(di->index), di->doc->index);
 
-void cc_rem_rule(G_GNUC_UNUSED gint id)
-{
+  di->complete = TRUE;
+  di->idle = 0;
+  return FALSE;
 }
 
-void plugin_init(G_GNUC_UNUSED GeanyData *data)
+/* drops the index and builds it again, once it lost track of the document */
+static void reindex(doc_index_t *di)
 {
-  config.capitalize = FALSE;
-  config.rules = NULL;
+  cc_occur_free(di->index);
 
-  cc_ui_init();
-  cc_load_settings();
+  di->index = cc_occur_new();
+  di->built = 0;
+  di->complete = FALSE;
+  di->edit_pos = -1;
+
+  if (!di->idle)
+    di->idle = g_idle_add_full(G_PRIORITY_LOW, on_index_idle, di, NULL);
 }
 
-void plugin_cleanup(void)
+static void index_document(GeanyDocument *doc)
 {
-  rule_t *rule, *tmprule = NULL;
-
-  /* save rules */
-  cc_save_settings();
+  doc_index_t *di = NULL;
 
-  /* free rules, their actions and conditions */
-  for (rule = config.rules; rule != NULL;) {
-    tmprule = rule;
-    rule = rule->next;
-    cc_free_rule(&tmprule);
-  }
+  if (!indexes.enabled || !doc || g_hash_table_lookup(indexes.docs, doc))
+    return;
 
-  rule = tmprule = NULL;
+  di = cc_malloc0(CC_MEM_INDEX, sizeof(doc_index_t));
+  di->doc = doc;
+  reindex(di);
 
-  /* free up the UI resources */
-  cc_ui_cleanup();
+  g_hash_table_insert(indexes.docs, doc, di);
 }
 
-static gboolean is_snake(gchar const* in, size_t insz)
+static void free_doc_index(gpointer data)
 {
-  guint i;
-  gboolean has_lc = FALSE; /* any lowercase letters ? */
-
-  /* a string is considered snake_cased if there's any single underscore in the middle
-   * of the string and it contains lowercase letter(s) */
-  for (i = 0; i < insz; ++i) {
-    if (in[i] == '_') {
-      if (i+1 < insz && in[i+1] == '_') {
-        /* skip consecutive underscores */
-        while (i+1 < insz && in[i+1] == '_') ++i;
-        continue;
-      }
-
-      if (has_lc)
-        return TRUE;
-    }
-    else if (islower(in[i])) has_lc = TRUE;
-  }
-  return FALSE;
-}
+  doc_index_t *di = data;
 
-static gboolean is_camel(gchar const* in, size_t insz)
-{
-  guint i;
+  if (di->idle)
+    g_source_remove(di->idle);
 
-  /* a string is considered camelCased if any upper case letter is preceded
-   * or followed by a lower one */
-  for (i = 0; i < insz; ++i) {
-    if (isupper(in[i])
-    && ((i+1 < insz && isalpha(in[i+1]) && !isupper(in[i+1])) || (i > 0 && isalpha(in[i-1]) && !isupper(in[i-1]))))
-    {
-      return TRUE;
-    }
-  }
-  return FALSE;
+  cc_occur_free(di->index);
+  cc_free(di);
 }
 
-static gchar* do_convert(gchar const* in, size_t insz, gint *outsz)
+/* the lines touched by an edit are taken out of the index ahead of it, and
+ * put back as they read after it */
+static gboolean on_editor_notify(G_GNUC_UNUSED GObject *obj, GeanyEditor *editor,
+                                 SCNotification *nt, G_GNUC_UNUSED gpointer user_data)
 {
-  typedef struct {
-    token_t* tokens;
-    size_t   nr_tokens;
-  } expr_t;
+  ScintillaObject *sci = editor->sci;
+  doc_index_t     *di = NULL;
+  gint            mod = nt->modificationType;
+  gint            limit, last;
 
-  /* iterators */
-  guint   i = 0;       /* used to iterate tmp buffers */
-  guint   cursor = 0;  /* used to iterate tmp buffers */
-  guint   icursor = 0; /* used to iterate the input buffer */
-  guint   ocursor = 0; /* used to iterate the out buffer */
-  size_t  begin = 0;
-  size_t  end = insz;
+  if (nt->nmhdr.code != SCN_MODIFIED)
+    return FALSE;
 
-  /* flags */
-  gboolean to_camel = FALSE; /* converting to CamelCase? (CC_RULE_S2C) */
-  gboolean to_snake = FALSE; /* converting to snake_case? (CC_RULE_C2S) */
-  gboolean upcasing = FALSE; /* used in CC_RULE_S2C conversion */
+  if (mod & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+    ++nr_edits;
 
-  /* buffers and sizes */
-  gchar *input    = NULL;   /* the transformed input buffer */
-  gchar *out      = NULL;   /* the final result buffer */
-  gchar *tmp      = NULL;   /* a temp buffer */
-  gchar c         = 0;      /* a character iterator */
-  size_t inputsz  = 0;      /* the size of the transformed input */
-  /*size_t outsz    = 0;*/      /* the size of the result string */
+  if (!indexes.docs)
+    return FALSE;
 
-  /* used for snake2camel conversion */
-  expr_t  *expr = NULL;
-  token_t *tok = NULL;
-  token_t *tmptok = NULL;
-  gboolean tCase, testCase, testCASETwo; /* see below */
+  if (!(mod & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE | SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+    return FALSE;
 
-  rule_t      *rule = NULL;
-  action_t    *act = NULL;
-  gboolean    rule_met = FALSE;
-  const gchar *prefix = NULL;
-  const gchar *suffix = NULL;
+  if (!(di = g_hash_table_lookup(indexes.docs, editor->document)))
+    return FALSE;
 
-  /* are we converting to CamelCase? */
-  if (is_snake(in, insz)) {
-    to_camel = TRUE;
+  limit = di->complete ? G_MAXINT : di->built;
 
-    cc_log("input '%s' is snake_cased\n", in);
-  }
-  /* to snake_case? */
-  else if (is_camel(in, insz)) {
-    to_snake = TRUE;
+  if (mod & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE)) {
+    last = nt->position + ((mod & SC_MOD_BEFOREDELETE) ? nt->length : 0);
 
-    cc_log("input '%s' is camelCased\n", in);
+    di->edit_pos = nt->position;
+    di->edit_len = nt->length;
+    di->edit_first = sci_get_line_from_position(sci, nt->position);
+    di->edit_lines = sci_get_line_from_position(sci, last) - di->edit_first;
+    di->edit_past = di->edit_first + di->edit_lines >= limit;
+
+    index_lines(di, di->edit_first, MIN(di->edit_first + di->edit_lines, limit - 1), FALSE);
+    return FALSE;
   }
-  /* unable to identify the string case, abort */
-  else {
-    return NULL;
+
+  if (di->edit_pos != nt->position || di->edit_len != nt->length) {
+    cc_warn("WARN: document %d was edited unannounced, indexing it again\n", di->doc->index);
+    reindex(di);
+    return FALSE;
   }
 
-  /* find any matching rule and perform its transformation actions */
-  for (rule = config.rules; rule != NULL; rule = rule->next)
-  {
-    if (!rule->enabled) continue;
+  di->edit_pos = -1;
+  cc_occur_shift(di->index, di->edit_first + di->edit_lines + 1, nt->linesAdded);
 
-    /* verify that the condition applies to this domain */
-    if (rule->domain == CC_RULE_S2C && !to_camel) continue;
-    else if (rule->domain == CC_RULE_C2S && !to_snake) continue;
-    else if (rule->domain == CC_RULE_NULL) {
-      cc_log("WARN: invalid rule domain (%d => '%s')!\n", rule->id, rule->label);
-      continue;
-    }
+  /* the lines not indexed yet are left to the idle builder */
+  if (di->edit_past) {
+    di->built = MIN(di->built, di->edit_first);
+    return FALSE;
+  }
 
-    switch (rule->condition->type)
-    {
-      case CC_CND_HAS_PREFIX:
-        if (g_str_has_prefix(in, rule->condition->value)) { rule_met = TRUE; break; }
-      break;
-      case CC_CND_HAS_SUFFIX:
-        if (g_str_has_suffix(in, rule->condition->value)) { rule_met = TRUE; break; }
-      break;
-      case CC_CND_ALWAYS_TRUE: rule_met = TRUE; break;
-      default: rule_met = FALSE;
-    }
+  if (!di->complete)
+    di->built += nt->linesAdded;
 
-    if (rule_met)
-    {
-      cc_log("rule has been met! (%d) => (%s)\n", rule->condition->type, rule->condition->value);
-
-      /* perform the rule actions */
-      for (act = rule->actions; act != NULL; act = act->next)
-      {
-        switch (act->type)
-        {
-          /* converting to snake_case will cost an additional '_' for prefixes and suffixes */
-          case CC_ACT_ADD_PREFIX:
-            prefix = act->value;
-            inputsz += strlen(prefix) + (to_snake ? 1 : 0);
-            cc_log("adding prefix '%s'\n", prefix);
-          break;
-          case CC_ACT_ADD_SUFFIX:
-            suffix = act->value;
-            inputsz += strlen(suffix) + (to_snake ? 1 : 0);
-          break;
-
-          case CC_ACT_REM_PREFIX:
-            begin += strlen(act->value);
-          break;
-          case CC_ACT_REM_SUFFIX:
-            end -= strlen(act->value);
-          break;
-          default: ;
-        }
-      }
-
-      break;
-    }
-  }
+  index_lines(di, di->edit_first, di->edit_first + di->edit_lines + nt->linesAdded, TRUE);
+  return FALSE;
+}
 
-  /* nothing left to convert? :D */
-  if (end == 0) {
-    return NULL;
-  }
+/* rules scoped to filetypes only apply to documents of those, the rules for
+ * the current one are picked whenever it changes */
+static void on_document_activate(G_GNUC_UNUSED GObject *obj, GeanyDocument *doc,
+                                 G_GNUC_UNUSED gpointer user_data)
+{
+  cc_set_filetype(doc && doc->file_type ? doc->file_type->name : NULL);
+  index_document(doc);
+}
 
-  /* clone the stripped input */
-  tmp = g_malloc(sizeof(gchar) * (end + 1));
-  memset(tmp, 0, sizeof(gchar) * (end + 1));
-  i = 0;
-  for (cursor = begin; cursor < end; ++cursor, ++i) {
-    tmp[i] = in[cursor];
-  }
-  tmp[cursor] = '\0';
-  inputsz += cursor;
+static void on_document_close(G_GNUC_UNUSED GObject *obj, GeanyDocument *doc,
+                              G_GNUC_UNUSED gpointer user_data)
+{
+  if (indexes.docs)
+    g_hash_table_remove(indexes.docs, doc);
+}
 
-  /* create the transformed input */
-  input = g_malloc(sizeof(gchar) * inputsz);
-  memset(input, 0, sizeof(gchar) * inputsz);
-  g_snprintf(input, inputsz, "%s%s%s",
-    (prefix ? prefix : ""),
-    tmp,
-    (suffix ? suffix : ""));
+static void on_document_filetype_set(G_GNUC_UNUSED GObject *obj, GeanyDocument *doc,
+                                     G_GNUC_UNUSED GeanyFiletype *filetype_old,
+                                     G_GNUC_UNUSED gpointer user_data)
+{
+  if (doc == document_get_current())
+    on_document_activate(obj, doc, user_data);
+}
 
-  g_free(tmp);
-  tmp = NULL;
+PluginCallback plugin_callbacks[] =
+{
+  { "document-activate", (GCallback) &on_document_activate, TRUE, NULL },
+  { "document-filetype-set", (GCallback) &on_document_filetype_set, TRUE, NULL },
+  { "document-close", (GCallback) &on_document_close, TRUE, NULL },
+  { "editor-notify", (GCallback) &on_editor_notify, TRUE, NULL },
+  { NULL, NULL, FALSE, NULL }
+};
 
-  if (to_camel)
-  {
-    /* convert snake_case => [prefix][c|C]amelCase[suffix]
-     *
-     * case 1:    "foo_bar"      => "fooBar"
-     * case 2:    "foo_bar"      => "FooBar"       (capitalize)
-     * case 3:    "singleton"    => "getSingleton" (add prefix)
-     * case 4:    "member_"      => "mMember"      (remove suffix, add prefix)
-     * case 5:    "foo_BAR"      => "fooBAR"       (maintain consecutive case)
-     * case 6.a:  "foo_BAR_zoo"  => "fooBARZoo"    (be smart about #5)
-     * case 6.b   "foo_bAR_zoo"  => "fooBARZoo"
-     * case 7:    "foo_bar__"    => "fooBar__"     (consecutive '_' are untouched)
-     */
-
-    /* capitalize the word? */
-    if (config.capitalize) {
-      upcasing = 1;
-    }
+static void watch_settings();
+static void unwatch_settings();
+static void flush_settings();
+static void free_settings(settings_t *settings);
+static void stop_everywhere();
+static void forget_plan();
 
-    /* if a prefix was added, we need to capitalize the first original letter */
-    if (prefix)
-    {
-      size_t pos = strlen(prefix);
-      input[pos] = toupper(input[pos]);
-    }
+void plugin_init(G_GNUC_UNUSED GeanyData *data)
+{
+  /* the Edit Rules list registers a GType, which can't be unloaded */
+  plugin_module_make_resident(geany_plugin);
 
-    /* the resulting buffer will be at most the original buffer size */
-    tmp = g_malloc(sizeof(char) * (inputsz + 1));
-    memset(tmp, 0, sizeof(char) * (inputsz + 1));
-
-    for (icursor = 0; icursor < inputsz; ++icursor)
-    {
-      /* case 7: write any consecutive underscores without modification */
-      if (input[icursor] == '_' && ((icursor + 1 < inputsz) && (input[icursor+1] == '_'))) {
-        tmp[ocursor++] = input[icursor];
-        while ((icursor + 1 < inputsz) && (input[icursor+1] == '_'))
-          tmp[ocursor++] = input[++icursor];
-        upcasing = 0;
-        continue;
-      }
-
-      /* otherwise, if it's a single underscore, skip it and upcase next */
-      if (input[icursor] == '_') {
-        upcasing = 1;
-        continue;
-      }
-
-      if (upcasing) {
-        tmp[ocursor++] = toupper(input[icursor]);
-        upcasing = 0;
-        continue;
-      }
-
-      tmp[ocursor++] = input[icursor];
-    }
+  cc_get_config()->capitalize = FALSE;
+  indexes.docs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_doc_index);
 
-    *outsz = ocursor;
-    out = g_malloc(sizeof(gchar) * (*outsz + 1));
-    g_snprintf(out, *outsz + 1, "%s", tmp);
-    g_free(tmp);
-    tmp = NULL;
+  cc_ui_init();
+  cc_load_settings();
+  watch_settings();
 
-    cc_log("converted from snake_case '%s' into camelCase '%s'\n", input, out);
-  }
-  else
-  {
-    /* convert camelCase => snake_case */
-
-    tmp = g_malloc(sizeof(char) * (inputsz + 1));
-    memset(tmp, 0, sizeof(char) * (inputsz + 1));
-
-    expr = g_malloc(sizeof(expr_t));
-    expr->tokens = NULL;
-    expr->nr_tokens = 0;
-
-    tok = g_malloc(sizeof(token_t));
-    tok->value = NULL;
-    tok->valsz = 0;
-    tok->next = NULL;
-
-    expr->tokens = tok;
-    ++expr->nr_tokens;
-
-    c = input[icursor];
-    for (icursor = 0; icursor < inputsz; ++icursor)
-    {
-      c = input[icursor];
-
-      tCase = (icursor == 0 && icursor + 1 < inputsz && islower(c) && isupper(input[icursor+1]));
-
-      /* case 2: "fooBar" => foo_bar
-       *
-       * if the cursor points to an uppercase, we peek 1 char behind, if it's
-       * lower, then a new token is defined
-       */
-      testCase = (icursor > 1 && !isupper(input[icursor-1]) && isupper(c) && tok->valsz > 0);
-
-      /* case 3: "mCURLObj" => m_curl_obj
-       *
-       * if the cursor points to an uppercase, the last char is an upper as well,
-       * and the next is a lower case char
-       */
-      testCASETwo =
-        (icursor > 1 && icursor +1 < inputsz && isupper(c) && isupper(input[icursor-1]) && islower(input[icursor+1]));
-
-      if (tCase || testCase || testCASETwo)
-      {
-        if (tCase) {
-          tmp[0] = c;
-          ++tok->valsz;
-        }
-
-        /* extract the token value and reset the buffer */
-        tok->value = g_malloc(sizeof(gchar) * (tok->valsz + 1));
-        memset(tok->value, 0, sizeof(gchar) * (tok->valsz + 1));
-        g_snprintf(tok->value, tok->valsz + 1, "%s", tmp);
-        memset(tmp, 0, sizeof(gchar) * (inputsz + 1));
-
-        /* define the next token */
-        tmptok = g_malloc(sizeof(token_t));
-        tmptok->value = NULL;
-        tmptok->valsz = 0;
-        tmptok->next = NULL;
-
-        /* and link it */
-        tok->next = tmptok;
-        tok = tmptok;
-        tmptok = NULL;
-        ++expr->nr_tokens;
-
-        if (tCase) continue;
-      }
-
-      /* parse token */
-      tmp[tok->valsz] = isupper(c) ? tolower(c) : c;
-      ++tok->valsz;
-    }
+  /* documents may have been opened before the plugin got loaded */
+  on_document_activate(NULL, document_get_current(), NULL);
+}
 
-    /* assign the trailing data to the last token */
-    if (!tok->value && tok->valsz > 0) {
-      tok->value = g_malloc(sizeof(char) * (tok->valsz + 1));
-      memset(tok->value, 0, sizeof(char) * (tok->valsz + 1));
-      g_snprintf(tok->value, tok->valsz, "%s", tmp);
-      memset(tmp, 0, inputsz + 1);
-    }
+void plugin_cleanup(void)
+{
+  /* save rules, merging whatever the file got meanwhile, and wait for
+   * them to be written */
+  unwatch_settings();
+  cc_save_settings();
+  flush_settings();
+  free_settings(&synced);
 
-    cc_log("extracted (%d) tokens from expr '%s'\n", (int)expr->nr_tokens, input);
+  /* free rules, their actions and conditions */
+  cc_clear_rules();
+  cc_set_acronyms(NULL);
+  cc_set_boundaries(NULL);
 
-    g_free(tmp);
+  reset_cycle();
+  forget_plan();
 
-    /* now join the tokens and delimit them by '_' except for the last */
-    *outsz = inputsz + expr->nr_tokens - 1;
-    out = g_malloc(sizeof(gchar) * (*outsz + 1));
-    memset(out, 0, sizeof(gchar) * (*outsz + 1));
+  g_hash_table_destroy(indexes.docs);
+  memset(&indexes, 0, sizeof(indexes));
 
-    ocursor = 0;
-    tok = NULL;
-    for (tok = expr->tokens; tok != NULL; ) {
-      for (i = 0; i < tok->valsz; ++i)
-      {
-        out[ocursor+i] = tok->value[i];
-      }
-      ocursor += tok->valsz;
+  /* waits for the workers, a file being rewritten is finished */
+  stop_everywhere();
 
-      if (tok->next)
-        out[ocursor++] = '_';
+  cc_rec_stop();
 
-      cc_log("out buf now has '%s' (%d), wrote '%s' (%d)\n", out, ocursor, tok->value, (int)tok->valsz);
+  /* dump the recorded trace next to the config file */
+  if (cc_trace_enabled && cfg_file) {
+    gchar *trace_file = g_strconcat(cfg_file, ".trace", NULL);
+    FILE  *out = fopen(trace_file, "w");
 
-      tmptok = tok;
-      tok = tok->next;
-      g_free(tmptok);
-      tmptok = NULL;
+    if (out) {
+      cc_trace_dump(out);
+      cc_mem_dump(out);
+      fclose(out);
     }
 
-    out[ocursor] = '\0';
-    expr->tokens = NULL;
-    g_free(expr);
-    expr = NULL;
+    cc_trace_enable(FALSE);
+    g_free(trace_file);
   }
 
-  /* ... */
-  return out;
+  g_free(cfg_file);
+  cfg_file = NULL;
+
+  /* free up the UI resources */
+  cc_ui_cleanup();
+
+  /* anything still live at this point has leaked */
+#if CC_TRACE_LEVEL >= CC_TRACE_INFO
+  cc_mem_dump(stdout);
+#endif
 }
 
 /* cc_get_selected_text():
@@ -589,7 +452,7 @@ gchar* cc_get_selected_text(gint* sz)
 
       /* get the text in question */
       txtsz = endpos - startpos;
-      txt = g_malloc(txtsz + 1);
+      txt = cc_malloc(CC_MEM_CONVERTER, txtsz + 1);
       sci_get_selected_text(sci, txt);
 
       *sz = txtsz + 1;
@@ -611,370 +474,1316 @@ void cc_convert_selection(void)
   ScintillaObject *sci = document_get_current()->editor->sci;
 
   if (txt) {
+    cc_rec_selection(txt, txtsz);
+
     /* put the new text in */
-    repl = do_convert(txt, txtsz, &replsz);
+    repl = cc_convert_text(txt, txtsz, &replsz);
     if (repl) {
       sci_replace_sel(sci, repl);
-      g_free(repl);
+      cc_free(repl);
     }
 
-    g_free(txt);
+    cc_free(txt);
   }
 
   txt = repl = NULL;
 }
 
+static void reset_cycle()
+{
+  if (cycle.src)
+    cc_words_clear(&cycle.words);
+
+  cc_free(cycle.src);
+  cc_free(cycle.last);
+  cc_grammar_unref(cycle.grammar);
+  cc_acronyms_unref(cycle.acronyms);
+
+  memset(&cycle, 0, sizeof(cycle));
+}
+
+/* replaces the selected name with the next case style, keeping it selected */
+void cc_cycle_selection(void)
+{
+  gint  txtsz = 0;
+  gint  start = 0;
+  gint  replsz = 0;
+  gint  i = 0;
+  gchar *repl = NULL;
+  gchar *txt = cc_get_selected_text(&txtsz);
+  GeanyDocument   *doc = document_get_current();
+  ScintillaObject *sci = doc->editor->sci;
+
+  if (!txt)
+    return;
+
+  start = MIN(sci_get_selection_start(sci), sci_get_selection_end(sci));
+
+  /* unless this is the name we cycled last, find its words */
+  if (!cycle.src || cycle.doc != doc || cycle.pos != start || strcmp(cycle.last, txt) != 0)
+  {
+    cc_ruleset_t *rs = cc_acquire_ruleset();
+
+    reset_cycle();
+
+    /* the grammar and acronyms may change while cycling, the words keep
+     * the ones they were split with; unlike the converter, cycling reads
+     * the delimiters of every style */
+    cycle.grammar = cc_grammar_with_delims(rs ? rs->grammar : NULL, CC_STYLE_DELIMS);
+    if (rs && rs->acronyms)
+      cycle.acronyms = cc_acronyms_ref(rs->acronyms);
+    cc_release_ruleset(rs);
+
+    if (!cc_words_split(txt, txtsz, cycle.grammar, cycle.acronyms, &cycle.words)) {
+      reset_cycle();
+      cc_free(txt);
+      return;
+    }
+
+    cycle.doc = doc;
+    cycle.pos = start;
+    cycle.src = txt;
+    cycle.last = cc_strdup(CC_MEM_CONVERTER, txt);
+    cycle.style = cc_words_style(txt, txtsz);
+  }
+  else
+    cc_free(txt);
+
+  txt = NULL;
+
+  /* the next style that actually changes the name, "foo" is the same in most */
+  for (i = 1; i < CC_STYLE_COUNT; ++i) {
+    cc_style_t style = (cycle.style + i) % CC_STYLE_COUNT;
+
+    repl = cc_words_convert(&cycle.words, style, &replsz);
+
+    if (strcmp(repl, cycle.last) != 0) {
+      cc_debug("cycling '%s' into %s '%s'\n", cycle.last, cc_style_name(style), repl);
+
+      sci_replace_sel(sci, repl);
+      sci_set_selection_start(sci, start);
+      sci_set_selection_end(sci, start + replsz);
+
+      cc_free(cycle.last);
+      cycle.last = repl;
+      cycle.style = style;
+      return;
+    }
+
+    cc_free(repl);
+  }
+}
+
 #ifndef SSM
 # define SSM(m, w, l) scintilla_send_message(sci, m, w, l)
 #endif
 
-/* converts the case of all occurences of the given text in the specified range */
-void cc_convert_range(int r_begin, int r_end, gchar const *txt, gint txtsz, int flags)
+/* where "txt" may occur in [r_begin, r_end] going by the document's index,
+ * ascending, or NULL if it can't tell */
+static GArray* find_indexed(GeanyDocument *doc, gchar const *txt, gint txtsz, int flags,
+                            int r_begin, int r_end)
 {
-  gchar *repl = NULL;
-  gint  replsz = 0;
-  /* get a pointer to the scintilla object */
-  ScintillaObject *sci = document_get_current()->editor->sci;
+  doc_index_t     *di = indexes.docs ? g_hash_table_lookup(indexes.docs, doc) : NULL;
+  ScintillaObject *sci = doc->editor->sci;
+  GArray          *found = NULL, *hits = NULL;
+  cc_occur_pos_t  *at = NULL;
+  guint           i;
+  gint            pos;
+
+  if (!di || !di->complete)
+    return NULL;
 
-  /* if no text was given, try to see if there's a selection */
-  if (!txt) {
-    txt = cc_get_selected_text(&txtsz);
+  found = g_array_new(FALSE, FALSE, sizeof(cc_occur_pos_t));
 
-    if (!txt) /* there isn't, abort */
-      return;
+  if (!cc_occur_find(di->index, txt, txtsz, flags & SCFIND_WHOLEWORD, flags & SCFIND_MATCHCASE, found)) {
+    g_array_free(found, TRUE);
+    return NULL;
   }
 
-  /* get the converted version */
-  repl = do_convert(txt, txtsz, &replsz);
+  hits = g_array_sized_new(FALSE, FALSE, sizeof(gint), found->len);
 
-  if (!repl) {
-    return;
+  for (i = 0; i < found->len; ++i) {
+    at = &g_array_index(found, cc_occur_pos_t, i);
+    pos = sci_get_position_from_line(sci, at->line) + at->col;
+
+    if (pos >= r_begin && pos + txtsz <= r_end + 1)
+      g_array_append_val(hits, pos);
   }
 
-  cc_log("converting '%s'(%d) to '%s'(%d) in [%d..%d]\n", txt, txtsz, repl, replsz, r_begin, r_end);
+  g_array_free(found, TRUE);
 
-  sci_start_undo_action(sci);
+  return hits;
+}
+
+/* whether the search flags have "txt" at "pos", targeting it if so; the
+ * index knows nothing of them, Scintilla decides */
+static gboolean occurs_at(ScintillaObject *sci, gint pos, gchar const *txt, gint txtsz)
+{
+  SSM(SCI_SETTARGETSTART, pos, 0);
+  SSM(SCI_SETTARGETEND,   pos + txtsz, 0);
+
+  return SSM(SCI_SEARCHINTARGET, txtsz, (uptr_t)txt) == pos;
+}
+
+gint cc_count_occurrences(gchar const *txt, int flags)
+{
+  GeanyDocument   *doc = document_get_current();
+  ScintillaObject *sci = NULL;
+  GArray          *hits = NULL;
+  gint            nr_hits = 0;
+  gint            txtsz = txt ? strlen(txt) : 0;
+  guint           i;
+
+  if (!doc || !txtsz)
+    return -1;
+
+  sci = doc->editor->sci;
+
+  if (!(hits = find_indexed(doc, txt, txtsz, flags, 0, sci_get_length(sci))))
+    return -1;
 
   SSM(SCI_SETSEARCHFLAGS, flags, 0);
-  SSM(SCI_SETTARGETSTART, r_begin, 0);
-  SSM(SCI_SETTARGETEND,   r_end + 1, 0);
 
-  while (SSM(SCI_SEARCHINTARGET, txtsz, (uptr_t)txt) != -1) {
-    SSM(SCI_REPLACETARGET, -1, (uptr_t)repl);
-    SSM(SCI_SETTARGETSTART, r_begin, 0);
-    SSM(SCI_SETTARGETEND,   r_end + 1, 0);
-  }
+  for (i = 0; i < hits->len; ++i)
+    if (occurs_at(sci, g_array_index(hits, gint, i), txt, txtsz))
+      ++nr_hits;
 
   SSM(SCI_SETSEARCHFLAGS, 0, 0);
 
-  sci_end_undo_action(sci);
+  g_array_free(hits, TRUE);
 
-  g_free(repl);
+  return nr_hits;
+}
 
-  repl = NULL;
+static void forget_plan()
+{
+  cc_plan_free(planned.plan);
+  cc_free(planned.txt);
+  memset(&planned, 0, sizeof(planned));
 }
 
-void cc_convert_all()
+/* where "txt" occurs in [r_begin, r_end], through the index if the
+ * document has one or searching for it otherwise; the document is left
+ * alone, but for the target and search flags */
+static void plan_occurrences(cc_plan_t *plan, gint text, GeanyDocument *doc,
+                             int r_begin, int r_end, gchar const *txt, gint txtsz, int flags)
 {
-  ScintillaObject *sci = document_get_current()->editor->sci;
+  ScintillaObject *sci = doc->editor->sci;
+  GArray          *hits = NULL;
+  gint            pos = 0;
+  guint           i;
 
-  /* sanity check */
-  if (document_get_current() == NULL) {
-    return;
+  SSM(SCI_SETSEARCHFLAGS, flags, 0);
+
+  if ((hits = find_indexed(doc, txt, txtsz, flags, r_begin, r_end)) != NULL) {
+    for (i = 0; i < hits->len; ++i) {
+      pos = g_array_index(hits, gint, i);
+
+      if (occurs_at(sci, pos, txt, txtsz))
+        cc_plan_add_edit(plan, pos, txtsz, text);
+    }
+
+    g_array_free(hits, TRUE);
   }
+  else {
+    r_end = MIN(r_end + 1, sci_get_length(sci));
 
-  cc_convert_range(0, sci_get_length(sci)+1, NULL, 0, 0);
-}
+    for (pos = r_begin; pos < r_end; pos = SSM(SCI_GETTARGETEND, 0, 0)) {
+      SSM(SCI_SETTARGETSTART, pos, 0);
+      SSM(SCI_SETTARGETEND,   r_end, 0);
 
+      if ((pos = SSM(SCI_SEARCHINTARGET, txtsz, (uptr_t)txt)) == -1)
+        break;
 
-rule_t* cc_get_rule(gint id)
-{
-  rule_t *iter = NULL;
-  for (iter = config.rules; iter != NULL; iter = iter->next)
-    if (iter->id == id) return iter;
+      cc_plan_add_edit(plan, pos, txtsz, text);
+    }
+  }
 
-  return NULL;
+  SSM(SCI_SETSEARCHFLAGS, 0, 0);
 }
 
-rule_t* cc_get_rules()
+const cc_plan_t* cc_plan_range(int r_begin, int r_end, gchar const *txt, gint txtsz, int flags)
 {
-  return config.rules;
+  GeanyDocument *doc = document_get_current();
+  cc_plan_t     *plan = NULL;
+  gchar         *repl = NULL;
+  gint          replsz = 0;
+  gint          searchsz = 0;
+
+  if (!doc || !txt)
+    return NULL;
+
+  /* the given size may count the NUL, which must not be searched for */
+  for (searchsz = 0; searchsz < txtsz && txt[searchsz] != '\0'; ++searchsz);
+
+  if (planned.plan && planned.doc == doc && planned.filetype == doc->file_type &&
+      planned.edits == nr_edits && planned.generation == cc_rules_generation() &&
+      planned.flags == flags && planned.r_begin == r_begin && planned.r_end == r_end &&
+      strlen(planned.txt) == (gsize)searchsz && strncmp(planned.txt, txt, searchsz) == 0)
+    return planned.plan;
+
+  forget_plan();
+
+  if (!searchsz || !(repl = cc_convert_text(txt, txtsz, &replsz)))
+    return NULL;
+
+  plan = cc_plan_new();
+  plan_occurrences(plan, cc_plan_add_text(plan, repl), doc, r_begin, r_end, txt, searchsz, flags);
+  plan->nr_names = plan->edits->len;
+  plan->nr_distinct = 1;
+
+  planned.plan = plan;
+  planned.doc = doc;
+  planned.filetype = doc->file_type;
+  planned.edits = nr_edits;
+  planned.generation = cc_rules_generation();
+  planned.txt = cc_strndup(CC_MEM_CONVERTER, txt, searchsz);
+  planned.flags = flags;
+  planned.r_begin = r_begin;
+  planned.r_end = r_end;
+
+  return plan;
 }
 
-static gchar *cfg_file;
+gchar* cc_preview_plan(const cc_plan_t *plan, gint max_hunks)
+{
+  GeanyDocument   *doc = document_get_current();
+  ScintillaObject *sci = NULL;
+  gchar           *text = NULL, *name = NULL, *diff = NULL;
 
-void cc_load_settings(void)
+  if (!doc || !plan)
+    return NULL;
+
+  sci = doc->editor->sci;
+  text = sci_get_contents(sci, -1);
+  name = doc->file_name ? g_path_get_basename(doc->file_name) : g_strdup(GEANY_STRING_UNTITLED);
+
+  diff = cc_plan_diff(plan, text, sci_get_length(sci), 0, name, max_hunks);
+
+  g_free(name);
+  g_free(text);
+
+  return diff;
+}
+
+/* the line of every edit of a plan; NULL if the plan may add or remove
+ * some, which the index can't follow line by line */
+static gint* edited_lines(ScintillaObject *sci, const cc_plan_t *plan)
 {
-	GKeyFile *cfg = g_key_file_new();
+  cc_plan_edit_t  *edit = NULL;
+  const gchar     *text = NULL;
+  gint            *lines = NULL;
+  guint           i;
 
-  /* the following variables are used for parsing rule definitions */
-  gchar     *rules = NULL;  /* rule definitions stored in cfg file */
-  gint      bufsz = 0;      /* length of rule definitions buffer */
-  gint      i = 0, x = 0;
-  gchar     c = 0;
+  for (i = 0; i < plan->texts->len; ++i) {
+    text = g_ptr_array_index(plan->texts, i);
 
-	cfg_file = g_strconcat(geany->app->configdir, G_DIR_SEPARATOR_S, "plugins", G_DIR_SEPARATOR_S,
-		"caseconvert", G_DIR_SEPARATOR_S, "caseconvert.conf", NULL);
-	g_key_file_load_from_file(cfg, cfg_file, G_KEY_FILE_NONE, NULL);
+    if (strchr(text, '\n') || strchr(text, '\r'))
+      return NULL;
+  }
 
-  config.capitalize = g_key_file_get_boolean(cfg, "caseconvert", "capitalize", NULL);
-	rules = utils_get_setting_string(cfg, "caseconvert", "rules", "");
-  bufsz = strlen(rules);
-
-  /* parse rules */
-  for (i = 0; i < bufsz; ++i) {
-    rule_t    *r = NULL;
-    gboolean  bracket_found = FALSE; /* used for validating a rule definition */
-    token_t   *tokens = NULL;
-    token_t   *tok = NULL;
-    gint      nr_tokens = 0;
-    gchar     *rbuf = NULL;
-    gint      rbufsz = 0;  /* length of a single rule definition */
-
-    c = rules[i];
-
-    /* rule format:
-     * [id,label,enabled,domain,cnd_type,cnd_val,act1_type,act1_val,...,actN_type,actN_val]
-     */
-    if (c == '[') {
-      /* begin new rule definition */
-      bracket_found = FALSE;
-      rbufsz = 0;
-
-      for (x = i+1; x < bufsz; ++x)
-      {
-        if (rules[x] == ']') {
-          rbuf = g_strndup(&rules[i+1], x - i - 1);
-          rbufsz = strlen(rbuf);
-          cc_log("tokenizing %s\n", rbuf);
-          tokens = tokenize(rbuf, ',', &nr_tokens);
-          g_free(rbuf);
-          rbuf = NULL;
-
-          bracket_found = TRUE;
-          break;
-        }
-      }
-
-      if (!bracket_found || !tokens)
-      {
-        /* abort */
-        break;
-      }
+  lines = cc_malloc(CC_MEM_CONVERTER, sizeof(gint) * plan->edits->len);
+
+  for (i = 0; i < plan->edits->len; ++i) {
+    edit = &g_array_index(plan->edits, cc_plan_edit_t, i);
+    lines[i] = sci_get_line_from_position(sci, edit->pos);
 
-      i += rbufsz;
+    if (lines[i] != sci_get_line_from_position(sci, edit->pos + edit->len)) {
+      cc_free(lines);
+      return NULL;
     }
+  }
 
-    if (!tokens) continue;
+  return lines;
+}
 
-    /* validate the number of tokens, can't be less than 8 */
-    if (nr_tokens < 8 || nr_tokens % 2 != 0) {
-      cc_log("warn: number of tokens in rule defintion is invalid: %d, expected an even number GE than 8\n", nr_tokens);
-      continue;
-    }
+/* takes the lines edited out of the index, or puts them back */
+static void index_edited(doc_index_t *di, const gint *lines, guint nr_lines, gboolean add)
+{
+  guint i;
 
-    tok = tokens;
-    r = cc_alloc_rule();
-    if (!r) {
-      break;
-    }
+  for (i = 0; i < nr_lines; ++i)
+    if (!i || lines[i] != lines[i-1])
+      index_lines(di, lines[i], lines[i], add);
+}
 
-    /* parse ID */
-    r->id = atoi(tok->value);
-    cc_log("rule id: %d\n", r->id);
-    tok = tok->next;
-
-    /* parse label */
-    r->label = g_strdup(tok->value);
-    cc_log("rule label: %s\n", r->label);
-    tok = tok->next;
-
-    /* parse "enabled" flag */
-    r->enabled = atoi(tok->value);
-    cc_log("rule enabled? %s(%d)\n", r->enabled ? "yes" : "no", r->enabled);
-    tok = tok->next;
-
-    /* parse "enabled" flag */
-    r->domain = atoi(tok->value);
-    cc_log("rule domain? %s(%d)\n", r->domain == 0 ? "CC_RULE_C2S" : "CC_RULE_S2C", r->domain);
-    tok = tok->next;
-
-    /* rule condition now: */
-    {
-      condition_t *cnd = cc_alloc_cnd();
-      if (!cnd)
-      {
-        cc_free_rule(&r);
-        break;
-      }
+/* makes the edits of a plan as a single undo action, last first so they
+ * don't move those left, the way cc_plan_estimate() finds cheapest for the
+ * undo history. Nobody is told of each replacement: Geany, and our own
+ * index, would otherwise handle as many notifications as there are; the
+ * index is kept up to date here instead. Nor is the view redrawn before
+ * they're all made */
+static void apply_plan(GeanyDocument *doc, const cc_plan_t *plan, cc_plan_cost_t *cost)
+{
+  ScintillaObject *sci = doc->editor->sci;
+  doc_index_t     *di = indexes.docs ? g_hash_table_lookup(indexes.docs, doc) : NULL;
+  GArray          *spans = NULL;
+  cc_plan_span_t  *span = NULL;
+  gchar           *old = NULL, *text = NULL;
+  gint            *lines = NULL;
+  gint            mask;
+  gboolean        kept = TRUE;  /* whether the edits keep the lines as they are */
+  guint           i;
+
+  memset(cost, 0, sizeof(cc_plan_cost_t));
+
+  if (!plan->edits->len)
+    return;
+
+  /* the edits that could break a line can't be joined either, so they're
+   * weighed as if each was on a line of its own */
+  if (!(lines = edited_lines(sci, plan))) {
+    lines = cc_malloc(CC_MEM_CONVERTER, sizeof(gint) * plan->edits->len);
+    kept = FALSE;
 
-      r->condition = cnd;
+    for (i = 0; i < plan->edits->len; ++i)
+      lines[i] = i;
+  }
+  else if (di && di->complete)
+    index_edited(di, lines, plan->edits->len, FALSE);
 
-      /* parse the type */
-      cnd->type = atoi(tok->value);
-      cc_log("\tcondition type => %d\n", cnd->type);
-      tok = tok->next;
+  spans = g_array_new(FALSE, FALSE, sizeof(cc_plan_span_t));
+  cc_plan_estimate(plan, lines, cost, spans);
 
-      cnd->value = g_strdup(tok->value);
-      cc_log("\tcondition value => %s\n", cnd->value);
-      tok = tok->next;
-      cnd = NULL;
-    }
+  cc_info("applying %d edits %s: %d replacements, about %lu bytes of undo history\n",
+    plan->edits->len, cc_plan_mode_name(cost->mode), spans->len, (gulong)cost->undo[cost->mode]);
 
-    /* rule actions now */
-    {
-      gint offset = 6;
-      gint nr_actions = (nr_tokens - offset) / 2;
-      action_t  *act = NULL, *tmpact = NULL;
-
-      for (x = 0; x < nr_actions; ++x)
-      {
-        act = cc_alloc_act();
-        if (!act)
-        {
-          /* abort */
-          cc_free_rule(&r);
-          g_free(rules);
-          g_key_file_free(cfg);
-          return;
-        }
-
-        /* parse the type */
-        act->type = atoi(tok->value);
-        cc_log("\taction type => %d\n", act->type);
-        tok = tok->next;
-
-        act->value = g_strdup(tok->value);
-        cc_log("\tact value => %s\n", act->value);
-        tok = tok->next;
-
-        /* connect the actions */
-        if (!tmpact) {
-          r->actions = act;
-        } else {
-          tmpact->next = act;
-        }
-
-        tmpact = act;
-      }
-      act = tmpact = NULL;
-    }
+  mask = SSM(SCI_GETMODEVENTMASK, 0, 0);
+  SSM(SCI_SETMODEVENTMASK, 0, 0);
+  SSM(SCI_SETREDRAW, FALSE, 0);
+
+  sci_start_undo_action(sci);
+
+  for (i = spans->len; i-- > 0; ) {
+    span = &g_array_index(spans, cc_plan_span_t, i);
 
-    /* register the rule and clean up */
-    {
-      CC_LIST_FREE(tokens, token_t);
-      cc_add_rule(r);
-      rbufsz = 0;
-      tok = NULL;
-      r = NULL;
+    if (span->last - span->first == 1)
+      text = g_ptr_array_index(plan->texts, g_array_index(plan->edits, cc_plan_edit_t, span->first).text);
+    else {
+      old = sci_get_contents_range(sci, span->pos, span->pos + span->len);
+      text = cc_plan_compose(plan, span, old);
+      g_free(old);
     }
+
+    SSM(SCI_SETTARGETSTART, span->pos, 0);
+    SSM(SCI_SETTARGETEND,   span->pos + span->len, 0);
+    SSM(SCI_REPLACETARGET, -1, (uptr_t)text);
+
+    if (span->last - span->first > 1)
+      cc_free(text);
   }
 
-  g_free(rules);
-	g_key_file_free(cfg);
+  sci_end_undo_action(sci);
+
+  SSM(SCI_SETREDRAW, TRUE, 0);
+  SSM(SCI_SETMODEVENTMASK, mask, 0);
+  ++nr_edits;
+
+  if (di && di->complete && kept)
+    index_edited(di, lines, plan->edits->len, TRUE);
+  else if (di)
+    reindex(di);
+
+  g_array_free(spans, TRUE);
+  cc_free(lines);
 }
 
-void cc_save_settings(void)
+/* converts the case of all occurences of the given text in the specified
+ * range: plans the conversion, or takes the plan a preview worked out, and
+ * applies it */
+void cc_convert_range(int r_begin, int r_end, gchar const *txt, gint txtsz, int flags)
 {
-	GKeyFile  *cfg = NULL;
-	gchar     *cfg_data = NULL;
-	gchar     *cfg_dir = NULL;
-  gchar     *rules = NULL;
-  gint      bufsz = 0;
-  rule_t    *rule = NULL;
+  const cc_plan_t *plan = NULL;
+  cc_plan_edit_t  *edit = NULL;
+  cc_plan_cost_t  cost;
+  gchar           *sel = NULL; /* the selected text, if we had to fetch it */
+  guint           i;
+  gint            replsz = 0;
+  gint64          t0 = CC_PROBE_CLOCK(range__return);
+  GeanyDocument   *doc = document_get_current();
+  ScintillaObject *sci = doc->editor->sci;
 
-  cfg = g_key_file_new();
-  cfg_dir = g_path_get_dirname(cfg_file);
-	g_key_file_load_from_file(cfg, cfg_file, G_KEY_FILE_NONE, NULL);
+  /* if no text was given, try to see if there's a selection */
+  if (!txt) {
+    txt = sel = cc_get_selected_text(&txtsz);
 
-  /* serialize rules */
-  for (rule = config.rules; rule != NULL; rule = rule->next)
-  {
-    gchar     *rbuf;  /* buffer for the current rule's definition */
-    gint      rbufsz = 0; /* its size */
-    action_t  *act;
-
-    /* rule format:
-     * [id,label,enabled,domain,cnd_type,cnd_val,act1_type,act1_val,...,actN_type,actN_val]
-     */
-    rbufsz += sizeof(gint);
-    if (rule->label)
-      rbufsz += strlen(rule->label);
-    else
-      rbufsz += 11; /* "Unlabelled" */
-
-    rbufsz += strlen(rule->condition->value);
-    rbufsz += sizeof(gchar) * 3 /* enabled, doman, and cnd_type all have a size of 1 */;
-    rbufsz += 8; /* commas and brackets */
-
-    rbuf = g_malloc(sizeof(gchar) * (rbufsz+1));
-    g_snprintf(rbuf, rbufsz, "[%d,%s,%d,%d,%d,%s",
-      rule->id,
-      rule->label ? rule->label : "Unlabelled",
-      rule->enabled,
-      rule->domain,
-      rule->condition->type,
-      rule->condition->value);
-
-    /* rule actions */
-    for (act = rule->actions; act != NULL; act = act->next)
-    {
-      gchar     *tmp = NULL;
-      size_t    tmpsz = 1 + (strlen(act->value)) + 2;
-
-      rbufsz += tmpsz;
-
-      tmp = g_strdup(rbuf);
-      g_free(rbuf);
-      rbuf = g_malloc(sizeof(gchar) * (rbufsz + 1));
-      g_snprintf(rbuf, rbufsz, "%s,%d,%s", tmp, act->type, act->value);
-
-      g_free(tmp);
-    }
+    if (!txt) /* there isn't, abort */
+      return;
+  }
 
-    strcat(rbuf, "]");
-
-    cc_log("size of rule (%d) = %dbytes, serialized: \n%s\n", rule->id, rbufsz, rbuf);
-
-    /* append the rule definition to the master rules buffer */
-    {
-      /* increment the master buffer size */
-      bufsz += rbufsz;
-
-      if (rules)
-      {
-        /* this is not the first rule, we have to recreate the string */
-        gchar *tmp = g_strdup(rules);
-        g_free(rules);
-        rules = g_malloc(sizeof(gchar) + (bufsz + 1));
-        g_snprintf(rules, bufsz, "%s%s", tmp, rbuf);
-        g_free(tmp);
-      } else
-      {
-        rules = g_malloc(sizeof(gchar) + (bufsz + 1));
-        g_snprintf(rules, bufsz, "%s", rbuf);
-      }
-    }
+  if (cc_recording) {
+    gint  docsz = sci_get_length(sci);
+    gchar *range = sci_get_contents_range(sci, MIN(r_begin, docsz), MIN(r_end + 1, docsz));
 
-    g_free(rbuf);
-  }
-
-	g_key_file_set_boolean(cfg, "caseconvert", "capitalize", config.capitalize);
-	g_key_file_set_string(cfg, "caseconvert", "rules", rules);
-
-	if (! g_file_test(cfg_dir, G_FILE_TEST_IS_DIR) && utils_mkdir(cfg_dir, TRUE) != 0)
-	{
-		dialogs_show_msgbox(GTK_MESSAGE_ERROR,
-			_("Plugin cfguration directory could not be created."));
-	}
-	else
-	{
-		/* write cfg to file */
-		cfg_data = g_key_file_to_data(cfg, NULL, NULL);
-		utils_write_file(cfg_file, cfg_data);
-		g_free(cfg_data);
-	}
-	g_free(rules);
-	g_free(cfg_dir);
-	g_key_file_free(cfg);
+    cc_rec_range(r_begin, r_end, flags, txt, txtsz, range, strlen(range));
+    g_free(range);
+  }
+
+  if (!(plan = cc_plan_range(r_begin, r_end, txt, txtsz, flags))) {
+    cc_free(sel);
+    return;
+  }
+
+  cc_debug("converting '%s'(%d) to '%s' in [%d..%d], %d occurrences\n", txt, txtsz,
+    (gchar*)g_ptr_array_index(plan->texts, 0), r_begin, r_end, plan->edits->len);
+
+  cc_trace_event(CC_EV_RANGE_BEGIN, r_begin, r_end);
+  CC_PROBE3(range__entry, r_begin, r_end, txtsz);
+
+  replsz = strlen(g_ptr_array_index(plan->texts, 0));
+
+  for (i = plan->edits->len; i-- > 0; ) {
+    edit = &g_array_index(plan->edits, cc_plan_edit_t, i);
+
+    cc_trace_event(CC_EV_RANGE_HIT, edit->pos, edit->len);
+    CC_PROBE3(range__replace, edit->pos, edit->len, replsz);
+  }
+
+  apply_plan(doc, plan, &cost);
+
+  if (plan->edits->len)
+    ui_set_statusbar(FALSE, _("Converted %d occurrences in %lu replacements"),
+      plan->edits->len, (gulong)cost.calls[cost.mode]);
+
+  cc_trace_event(CC_EV_RANGE_END, plan->edits->len, 0);
+  CC_PROBE2(range__return, plan->edits->len, CC_PROBE_ELAPSED(t0));
+
+  /* the document changed under it */
+  forget_plan();
+  cc_free(sel);
+}
+
+void cc_convert_all()
+{
+  ScintillaObject *sci = document_get_current()->editor->sci;
+
+  /* sanity check */
+  if (document_get_current() == NULL) {
+    return;
+  }
+
+  cc_convert_range(0, sci_get_length(sci)+1, NULL, 0, 0);
+}
+
+/* converts every name of the selection, or of the document if there's none,
+ * through a plan worked out on several threads (see caseconvert_plan.h) */
+void cc_convert_document()
+{
+  GeanyDocument   *doc = document_get_current();
+  ScintillaObject *sci = NULL;
+  cc_plan_t       *plan = NULL;
+  cc_plan_cost_t  cost;
+  gchar           *text = NULL;
+  gint            begin = 0, end = 0;
+
+  if (!doc)
+    return;
+
+  sci = doc->editor->sci;
+  begin = sci_has_selection(sci) ? sci_get_selection_start(sci) : 0;
+  end = sci_has_selection(sci) ? sci_get_selection_end(sci) : sci_get_length(sci);
+
+  text = sci_get_contents_range(sci, begin, end);
+  plan = cc_plan_names(text, end - begin, begin, CC_PLAN_THREADS);
+  g_free(text);
+
+  apply_plan(doc, plan, &cost);
+
+  ui_set_statusbar(FALSE, _("Converted %d of %d names (%d distinct) in %lu replacements"),
+    plan->edits->len, plan->nr_names, plan->nr_distinct, (gulong)cost.calls[cost.mode]);
+
+  cc_plan_free(plan);
+}
+
+gint cc_convert_map(const gchar *path, gboolean whole_word, gboolean fallback,
+                    gboolean all_documents, gchar **problem)
+{
+  GeanyDocument   *doc = NULL;
+  ScintillaObject *sci = NULL;
+  cc_map_t        *map = cc_map_new(whole_word);
+  cc_plan_t       *plan = NULL;
+  cc_plan_cost_t  cost;
+  gchar           *text = NULL;
+  gint            nr_pairs, nr_mapped = 0, nr_changed = 0, nr_all_mapped = 0, nr_docs = 0;
+  guint           i;
+
+  if ((nr_pairs = cc_map_load(map, path, problem)) < 0) {
+    cc_map_free(map);
+    return -1;
+  }
+
+  foreach_document(i) {
+    doc = documents_array(i);
+
+    if (!all_documents && doc != document_get_current())
+      continue;
+
+    sci = doc->editor->sci;
+    text = sci_get_contents(sci, -1);
+    plan = cc_map_plan(map, text, sci_get_length(sci), 0, fallback, &nr_mapped);
+    g_free(text);
+
+    apply_plan(doc, plan, &cost);
+
+    nr_all_mapped += nr_mapped;
+    nr_changed += plan->edits->len;
+    nr_docs += plan->edits->len ? 1 : 0;
+
+    cc_plan_free(plan);
+  }
+
+  ui_set_statusbar(FALSE, _("Mapped %d names, and converted %d others, in %d documents (%d pairs)"),
+    nr_all_mapped, nr_changed - nr_all_mapped, nr_docs, nr_pairs);
+
+  cc_map_free(map);
+
+  return nr_changed;
+}
+
+static void stop_everywhere()
+{
+  guint i;
+
+  if (everywhere.timer)
+    g_source_remove(everywhere.timer);
+
+  cc_scan_free(everywhere.scan);
+
+  if (everywhere.files) {
+    for (i = 0; i < everywhere.files->len; ++i)
+      cc_free(g_ptr_array_index(everywhere.files, i));
+
+    g_ptr_array_free(everywhere.files, TRUE);
+  }
+
+  cc_free(everywhere.symbol);
+  cc_free(everywhere.to);
+
+  memset(&everywhere, 0, sizeof(everywhere));
+}
+
+/* whether the tag manager knows of a symbol of that name */
+static gboolean is_known_symbol(const gchar *name)
+{
+  GPtrArray *tags = geany->app->tm_workspace->work_object.tags_array;
+  guint     i;
+
+  for (i = 0; tags && i < tags->len; ++i)
+    if (strcmp(((TMTag*)g_ptr_array_index(tags, i))->name, name) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+/* the project's base directory, or the document's own if there's no
+ * project; a real path in the locale's encoding */
+static gchar* everywhere_root(GeanyDocument *doc)
+{
+  GeanyProject  *project = geany->app->project;
+  gchar         *base = NULL, *dir = NULL, *root = NULL;
+
+  if (project && project->base_path && *project->base_path) {
+    /* it may be relative to the project file */
+    if (g_path_is_absolute(project->base_path) || !project->file_name)
+      base = utils_get_locale_from_utf8(project->base_path);
+    else {
+      dir = g_path_get_dirname(project->file_name);
+      root = g_build_filename(dir, project->base_path, NULL);
+      base = utils_get_locale_from_utf8(root);
+      g_free(root);
+      g_free(dir);
+    }
+  }
+  else if (doc->real_path)
+    base = g_path_get_dirname(doc->real_path);
+
+  if (base) {
+    root = tm_get_real_path(base);
+    g_free(base);
+  }
+
+  return root;
+}
+
+static void list_hits(const gchar *path, GArray *hits, GeanyDocument *doc)
+{
+  gchar         *name = utils_get_utf8_from_locale(path);
+  cc_scan_hit_t *hit = NULL;
+  guint         i;
+
+  for (i = 0; i < hits->len; ++i) {
+    hit = &g_array_index(hits, cc_scan_hit_t, i);
+
+    /* Geany jumps to "file:line:" when the message is clicked */
+    msgwin_msg_add(COLOR_BLACK, hit->line + 1, doc, "%s:%d: %s", name, hit->line + 1,
+      g_utf8_validate(hit->text, -1, NULL) ? hit->text : "");
+  }
+
+  everywhere.nr_hits += hits->len;
+  g_free(name);
+}
+
+/* renames the symbol in an open document, a single undo action */
+static gint rename_in_document(GeanyDocument *doc)
+{
+  ScintillaObject *sci = doc->editor->sci;
+  GArray          *hits = g_array_new(FALSE, FALSE, sizeof(cc_scan_hit_t));
+  cc_scan_hit_t   *hit = NULL;
+  gchar           *text = sci_get_contents(sci, -1);
+  gint            symsz = strlen(everywhere.symbol), pos;
+  guint           i;
+
+  cc_scan_find(text, strlen(text), everywhere.symbol, symsz, hits);
+
+  sci_start_undo_action(sci);
+
+  /* last first, so the replacements don't move those left */
+  for (i = hits->len; i-- > 0; ) {
+    hit = &g_array_index(hits, cc_scan_hit_t, i);
+    pos = sci_get_position_from_line(sci, hit->line) + hit->col;
+
+    SSM(SCI_SETTARGETSTART, pos, 0);
+    SSM(SCI_SETTARGETEND,   pos + symsz, 0);
+    SSM(SCI_REPLACETARGET, -1, (uptr_t)everywhere.to);
+  }
+
+  sci_end_undo_action(sci);
+
+  i = hits->len;
+  cc_scan_free_hits(hits);
+  g_free(text);
+
+  return i;
+}
+
+static gboolean on_everywhere_poll(gpointer data);
+
+/* rewrites the files found, the open ones through Scintilla */
+static void apply_everywhere()
+{
+  GeanyDocument *doc = NULL;
+  const gchar   *path = NULL;
+  guint         i;
+
+  everywhere.rewriting = TRUE;
+
+  for (i = 0; i < everywhere.files->len; ++i) {
+    path = g_ptr_array_index(everywhere.files, i);
+
+    if ((doc = document_find_by_real_path(path)) != NULL)
+      everywhere.nr_replaced += rename_in_document(doc);
+    else
+      cc_scan_rewrite(everywhere.scan, path);
+  }
+
+  everywhere.timer = g_timeout_add(CC_EVERYWHERE_POLL, on_everywhere_poll, NULL);
+}
+
+/* picks up what the workers handed back, until they're done */
+static gboolean on_everywhere_poll(G_GNUC_UNUSED gpointer data)
+{
+  cc_scan_file_t  *file = NULL;
+  gchar           *name = NULL;
+  gboolean        busy = cc_scan_busy(everywhere.scan);
+
+  while ((file = cc_scan_pop(everywhere.scan)) != NULL) {
+    if (!file->rewritten) {
+      list_hits(file->path, file->hits, NULL);
+      g_ptr_array_add(everywhere.files, cc_strdup(CC_MEM_SCAN, file->path));
+    }
+    else if (file->error) {
+      name = utils_get_utf8_from_locale(file->path);
+      msgwin_msg_add(COLOR_RED, -1, NULL, _("%s could not be rewritten: %s"), name, file->error);
+      ++everywhere.nr_failed;
+      g_free(name);
+    }
+    else
+      everywhere.nr_replaced += file->nr_replaced;
+
+    cc_scan_file_free(file);
+  }
+
+  if (busy)
+    return TRUE;
+
+  everywhere.timer = 0;
+
+  if (everywhere.rewriting) {
+    msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Converted %d occurrences of '%s' to '%s'."),
+      everywhere.nr_replaced, everywhere.symbol, everywhere.to);
+    if (everywhere.nr_failed)
+      msgwin_msg_add(COLOR_RED, -1, NULL, _("%d files could not be rewritten."), everywhere.nr_failed);
+    ui_set_statusbar(FALSE, _("Converted %d occurrences of '%s' to '%s'"),
+      everywhere.nr_replaced, everywhere.symbol, everywhere.to);
+    stop_everywhere();
+    return FALSE;
+  }
+
+  msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Found %d occurrences of '%s' in %d files."),
+    everywhere.nr_hits, everywhere.symbol, everywhere.files->len);
+
+  if (everywhere.nr_hits && dialogs_show_question(_("Convert %d occurrences of '%s' to '%s' in %d files?"),
+      everywhere.nr_hits, everywhere.symbol, everywhere.to, everywhere.files->len))
+    apply_everywhere();
+  else
+    stop_everywhere();
+
+  return FALSE;
+}
+
+/* starts looking for the symbol, which with its conversion is taken over */
+static void start_everywhere(gchar *symbol, gchar *to, const gchar *root)
+{
+  GeanyDocument *doc = NULL;
+  GArray        *hits = NULL;
+  gchar         *text = NULL, *name = utils_get_utf8_from_locale(root);
+  gsize         rootsz = strlen(root);
+  guint         i;
+
+  stop_everywhere();
+
+  everywhere.symbol = symbol;
+  everywhere.to = to;
+  everywhere.files = g_ptr_array_new();
+  everywhere.scan = cc_scan_new(symbol, to, CC_SCAN_THREADS);
+
+  msgwin_clear_tab(MSG_MESSAGE);
+  msgwin_switch_tab(MSG_MESSAGE, TRUE);
+  msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Looking for '%s' in %s..."), symbol, name);
+  g_free(name);
+
+  /* the open documents are looked at as they read now, not as saved */
+  foreach_document(i) {
+    doc = documents_array(i);
+
+    if (!doc->real_path || strncmp(doc->real_path, root, rootsz) != 0
+    ||  doc->real_path[rootsz] != G_DIR_SEPARATOR)
+      continue;
+
+    cc_scan_skip(everywhere.scan, doc->real_path);
+
+    text = sci_get_contents(doc->editor->sci, -1);
+    hits = g_array_new(FALSE, FALSE, sizeof(cc_scan_hit_t));
+
+    if (cc_scan_find(text, strlen(text), symbol, strlen(symbol), hits)) {
+      list_hits(doc->real_path, hits, doc);
+      g_ptr_array_add(everywhere.files, cc_strdup(CC_MEM_SCAN, doc->real_path));
+    }
+
+    cc_scan_free_hits(hits);
+    g_free(text);
+  }
+
+  cc_scan_start(everywhere.scan, root,
+    geany->app->project ? geany->app->project->file_patterns : NULL);
+  everywhere.timer = g_timeout_add(CC_EVERYWHERE_POLL, on_everywhere_poll, NULL);
+}
+
+void cc_convert_everywhere()
+{
+  GeanyDocument *doc = document_get_current();
+  gchar         *txt = NULL, *repl = NULL, *root = NULL;
+  gint          txtsz = 0, replsz = 0, i;
+
+  if (!doc || !(txt = cc_get_selected_text(&txtsz)))
+    return;
+
+  for (i = 0; txt[i] && CC_OCCUR_IS_WORD_CHAR(txt[i]); ++i);
+
+  if (!i || txt[i])
+    ui_set_statusbar(FALSE, _("'%s' is not a symbol"), txt);
+  else if (!(repl = cc_convert_text(txt, txtsz, &replsz)) || strcmp(repl, txt) == 0)
+    ui_set_statusbar(FALSE, _("No rule converts '%s'"), txt);
+  else if (!(root = everywhere_root(doc)))
+    ui_set_statusbar(FALSE, _("There is no project, nor a saved document, to convert '%s' in"), txt);
+  else if (is_known_symbol(txt)
+       ||  dialogs_show_question(_("The tag manager knows of no symbol named '%s', convert it everywhere anyway?"), txt)) {
+    start_everywhere(txt, repl, root);
+    txt = repl = NULL;
+  }
+
+  g_free(root);
+  cc_free(repl);
+  cc_free(txt);
+}
+
+
+/* reads the settings that may be merged, without parsing the rules; this
+ * doesn't call into Geany so it can run off the main thread */
+static void read_settings(GKeyFile *cfg, settings_t *out)
+{
+  memset(out, 0, sizeof(settings_t));
+
+  out->rules = g_key_file_get_string(cfg, "caseconvert", "rules", NULL);
+  out->acronyms = g_key_file_get_string(cfg, "caseconvert", "acronyms", NULL);
+  out->boundaries = g_key_file_get_string(cfg, "caseconvert", "boundaries", NULL);
+  out->capitalize = g_key_file_get_boolean(cfg, "caseconvert", "capitalize", NULL);
+
+  if (!out->rules) out->rules = g_strdup("");
+  if (!out->acronyms) out->acronyms = g_strdup("");
+  if (!out->boundaries) out->boundaries = g_strdup("");
+}
+
+static void free_settings(settings_t *settings)
+{
+  g_free(settings->rules);
+  g_free(settings->acronyms);
+  g_free(settings->boundaries);
+  cc_free_rules(settings->parsed);
+
+  memset(settings, 0, sizeof(settings_t));
+}
+
+static void copy_settings(settings_t *out, const settings_t *in)
+{
+  out->rules = g_strdup(in->rules);
+  out->parsed = NULL;
+  out->acronyms = g_strdup(in->acronyms);
+  out->boundaries = g_strdup(in->boundaries);
+  out->capitalize = in->capitalize;
+}
+
+static gboolean same_settings(const settings_t *a, const settings_t *b)
+{
+  return a->capitalize == b->capitalize
+      && g_strcmp0(a->rules, b->rules) == 0
+      && g_strcmp0(a->acronyms, b->acronyms) == 0
+      && g_strcmp0(a->boundaries, b->boundaries) == 0;
+}
+
+/* the settings we have now, as they'd be written */
+static void current_settings(settings_t *out, gint *nr_rules)
+{
+  gchar *rules = cc_serialize_rules(nr_rules);
+
+  memset(out, 0, sizeof(settings_t));
+
+  out->rules = g_strdup(rules);
+  out->acronyms = g_strdup(cc_get_acronyms() ? cc_get_acronyms() : "");
+  out->boundaries = g_strdup(cc_get_boundaries() ? cc_get_boundaries() : "");
+  out->capitalize = cc_get_config()->capitalize;
+
+  cc_free(rules);
+}
+
+/*
+ * Takes whatever changed in "file" since we last synced with it: a setting
+ * someone else edited wins over ours, and rules are merged one by one (see
+ * cc_merge_rules()) so only those they touched are rebuilt. "file" is left
+ * empty, and is what we're synced with afterwards.
+ */
+static void merge_settings(settings_t *file)
+{
+  if (g_strcmp0(file->acronyms, synced.acronyms) != 0)
+    cc_set_acronyms(file->acronyms);
+
+  if (g_strcmp0(file->boundaries, synced.boundaries) != 0)
+    cc_set_boundaries(file->boundaries);
+
+  if (file->capitalize != synced.capitalize)
+    cc_get_config()->capitalize = file->capitalize;
+
+  if (g_strcmp0(file->rules, synced.rules) != 0) {
+    if (!file->parsed)
+      file->parsed = cc_load_rules(file->rules, NULL);
+
+    cc_merge_rules(synced.rules, file->parsed);
+    file->parsed = NULL;
+    cc_ui_rules_changed();
+    reset_cycle();
+  }
+
+  free_settings(&synced);
+  synced = *file;
+  memset(file, 0, sizeof(settings_t));
+}
+
+/* reads and compiles the file off the main thread */
+static gboolean on_settings_read(gpointer data);
+
+static gpointer read_settings_worker(gpointer path)
+{
+  GKeyFile    *cfg = g_key_file_new();
+  settings_t  *file = NULL;
+
+  if (g_key_file_load_from_file(cfg, path, G_KEY_FILE_NONE, NULL)) {
+    file = g_new0(settings_t, 1);
+    read_settings(cfg, file);
+    file->parsed = cc_load_rules(file->rules, NULL);
+  }
+
+  g_key_file_free(cfg);
+  g_free(path);
+
+  g_idle_add(on_settings_read, &reload);
+
+  return file;
+}
+
+static void start_reload()
+{
+  reload.pending = FALSE;
+  reload.thread = g_thread_new("caseconvert-reload", read_settings_worker, g_strdup(cfg_file));
+}
+
+static gboolean on_settings_read(G_GNUC_UNUSED gpointer data)
+{
+  settings_t *file = g_thread_join(reload.thread);
+
+  reload.thread = NULL;
+
+  if (file) {
+    cc_info("'%s' changed, merging it\n", cfg_file);
+    merge_settings(file);
+    g_free(file);
+  }
+
+  if (reload.pending)
+    start_reload();
+
+  return FALSE;
+}
+
+/* editors tend to write in several steps, the file is read once it settles */
+static gboolean on_settings_settled(G_GNUC_UNUSED gpointer data)
+{
+  reload.timer = 0;
+
+  if (reload.thread)
+    reload.pending = TRUE;
+  else
+    start_reload();
+
+  return FALSE;
+}
+
+static void on_settings_changed(G_GNUC_UNUSED GFileMonitor *monitor,
+                                G_GNUC_UNUSED GFile *file,
+                                G_GNUC_UNUSED GFile *other,
+                                GFileMonitorEvent event,
+                                G_GNUC_UNUSED gpointer user_data)
+{
+  if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT && event != G_FILE_MONITOR_EVENT_CREATED)
+    return;
+
+  if (reload.timer)
+    g_source_remove(reload.timer);
+
+  reload.timer = g_timeout_add(250, on_settings_settled, NULL);
+}
+
+static void watch_settings()
+{
+  GFile *file = g_file_new_for_path(cfg_file);
+
+  reload.monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+  if (reload.monitor)
+    g_signal_connect(reload.monitor, "changed", G_CALLBACK(on_settings_changed), NULL);
+  else
+    cc_warn("WARN: unable to watch '%s' for changes\n", cfg_file);
+
+  g_object_unref(file);
+}
+
+static void unwatch_settings()
+{
+  if (reload.monitor) {
+    g_file_monitor_cancel(reload.monitor);
+    g_object_unref(reload.monitor);
+  }
+
+  if (reload.timer)
+    g_source_remove(reload.timer);
+
+  /* a read in progress is dropped, saving merges the file anyway */
+  if (reload.thread) {
+    settings_t *file = g_thread_join(reload.thread);
+
+    g_source_remove_by_user_data(&reload);
+
+    if (file) {
+      free_settings(file);
+      g_free(file);
+    }
+  }
+
+  memset(&reload, 0, sizeof(reload));
+}
+
+void cc_load_settings(void)
+{
+	GKeyFile *cfg = g_key_file_new();
+
+  gchar     *rules = NULL;  /* rule definitions stored in cfg file */
+  gchar     *acronyms = NULL;
+  gchar     *boundaries = NULL;
+  gchar     *rec_file = NULL;
+  gint      nr_rules = 0;   /* number of successfully registered rules */
+  gint64    t0 = CC_PROBE_CLOCK(settings__load__return);
+
+  CC_PROBE0(settings__load__entry);
+
+	cfg_file = g_strconcat(geany->app->configdir, G_DIR_SEPARATOR_S, "plugins", G_DIR_SEPARATOR_S,
+		"caseconvert", G_DIR_SEPARATOR_S, "caseconvert.conf", NULL);
+	g_key_file_load_from_file(cfg, cfg_file, G_KEY_FILE_NONE, NULL);
+
+  cc_get_config()->capitalize = g_key_file_get_boolean(cfg, "caseconvert", "capitalize", NULL);
+
+  /* the runtime tracer can be turned on from the config or the environment */
+  if (g_key_file_get_boolean(cfg, "caseconvert", "trace", NULL) || g_getenv("CC_TRACE"))
+    cc_trace_enable(TRUE);
+
+  /* documents are indexed by identifier, see on_editor_notify() */
+  indexes.enabled = g_key_file_get_boolean(cfg, "caseconvert", "index_documents", NULL);
+
+  /* acronyms known to the word splitter, ie "HTTP;URL;XML" */
+  acronyms = utils_get_setting_string(cfg, "caseconvert", "acronyms", "");
+  cc_set_acronyms(acronyms);
+  g_free(acronyms);
+
+  /* where words break, see caseconvert_grammar.h */
+  boundaries = utils_get_setting_string(cfg, "caseconvert", "boundaries", "");
+  cc_set_boundaries(boundaries);
+  g_free(boundaries);
+
+	rules = utils_get_setting_string(cfg, "caseconvert", "rules", "");
+  nr_rules = cc_parse_rules(rules);
+
+  /* so is the conversion recorder, see caseconvert_record.h */
+  rec_file = g_strdup(g_getenv("CC_RECORD"));
+  if (!rec_file)
+    rec_file = utils_get_setting_string(cfg, "caseconvert", "record", NULL);
+  if (rec_file && *rec_file)
+    cc_rec_start(rec_file);
+  g_free(rec_file);
+
+  /* this is what the file is merged against from now on */
+  free_settings(&synced);
+  read_settings(cfg, &synced);
+
+  cc_trace_event(CC_EV_SETTINGS_LOAD, nr_rules, 0);
+  CC_PROBE2(settings__load__return, nr_rules, CC_PROBE_ELAPSED(t0));
+
+  g_free(rules);
+	g_key_file_free(cfg);
+}
+
+/*
+ * Writes a save unless the file was edited since we synced with it, the edit
+ * is returned in "conflict" then, compiled and ready to be merged. Only the
+ * keys we own are replaced, the file goes through a temporary file so it's
+ * never seen half written. Doesn't call into Geany.
+ *
+ * @return whether the file was written
+ */
+static gboolean write_settings(save_job_t *job, settings_t **conflict)
+{
+  GKeyFile  *cfg = g_key_file_new();
+  GError    *err = NULL;
+  gchar     *cfg_data = NULL;
+  gchar     *cfg_dir = g_path_get_dirname(cfg_file);
+  gsize     cfg_datasz = 0;
+  gboolean  written = FALSE;
+  gint64    t0 = CC_PROBE_CLOCK(settings__save__return);
+  settings_t file;
+
+  CC_PROBE0(settings__save__entry);
+
+  *conflict = NULL;
+
+  if (g_key_file_load_from_file(cfg, cfg_file, G_KEY_FILE_KEEP_COMMENTS, NULL)) {
+    read_settings(cfg, &file);
+
+    /* neither what we synced with nor what we wrote since */
+    if (!same_settings(&file, &job->base) && !same_settings(&file, &saver.last)) {
+      file.parsed = cc_load_rules(file.rules, NULL);
+      *conflict = g_new(settings_t, 1);
+      **conflict = file;
+
+      g_free(cfg_dir);
+      g_key_file_free(cfg);
+      return FALSE;
+    }
+
+    free_settings(&file);
+  }
+
+	g_key_file_set_boolean(cfg, "caseconvert", "capitalize", job->ours.capitalize);
+	g_key_file_set_string(cfg, "caseconvert", "rules", job->ours.rules);
+  g_key_file_set_string(cfg, "caseconvert", "acronyms", job->ours.acronyms);
+  g_key_file_set_string(cfg, "caseconvert", "boundaries", job->ours.boundaries);
+
+  cfg_data = g_key_file_to_data(cfg, &cfg_datasz, NULL);
+
+	if (g_mkdir_with_parents(cfg_dir, 0755) != 0)
+    cc_warn("WARN: unable to create '%s'\n", cfg_dir);
+  else if (!g_file_set_contents(cfg_file, cfg_data, cfg_datasz, &err)) {
+    cc_warn("WARN: unable to write '%s': %s\n", cfg_file, err->message);
+    g_error_free(err);
+  }
+  else {
+    free_settings(&saver.last);
+    copy_settings(&saver.last, &job->ours);
+    written = TRUE;
+  }
+
+  cc_trace_event(CC_EV_SETTINGS_SAVE, job->nr_rules, (gint32)cfg_datasz);
+  CC_PROBE3(settings__save__return, job->nr_rules, cfg_datasz, CC_PROBE_ELAPSED(t0));
+
+  g_free(cfg_data);
+  g_free(cfg_dir);
+	g_key_file_free(cfg);
+
+  return written;
+}
+
+static void free_job(save_job_t *job)
+{
+  free_settings(&job->ours);
+  free_settings(&job->base);
+  g_free(job);
+}
+
+/* the save we have now, against what we last synced with */
+static save_job_t* make_job()
+{
+  save_job_t *job = g_new0(save_job_t, 1);
+
+  current_settings(&job->ours, &job->nr_rules);
+  copy_settings(&job->base, &synced);
+
+  return job;
+}
+
+/* syncs with what the worker did, merging the file if it was edited
+ * meanwhile and saving again if "resave" is set, returns whether it was */
+static gboolean sync_saved(gboolean resave)
+{
+  settings_t  *written = NULL, *conflict = NULL;
+  gboolean    failed = FALSE;
+
+  g_mutex_lock(&saver.lock);
+  written = saver.written;
+  conflict = saver.conflict;
+  failed = saver.failed;
+  saver.written = saver.conflict = NULL;
+  saver.failed = FALSE;
+  g_mutex_unlock(&saver.lock);
+
+  if (written) {
+    free_settings(&synced);
+    synced = *written;
+    g_free(written);
+  }
+
+  if (conflict) {
+    cc_info("'%s' was edited meanwhile, merging it before saving\n", cfg_file);
+    merge_settings(conflict);
+    g_free(conflict);
+
+    if (resave)
+      cc_save_settings();
+  }
+
+  if (failed && resave)
+    dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Plugin configuration could not be saved."));
+
+  return conflict != NULL;
+}
+
+static gboolean on_settings_saved(G_GNUC_UNUSED gpointer data)
+{
+  sync_saved(TRUE);
+
+  return FALSE;
+}
+
+static void save_worker(G_GNUC_UNUSED gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+  save_job_t  *job = NULL;
+  settings_t  *conflict = NULL;
+  gboolean    written = FALSE;
+
+  g_mutex_lock(&saver.lock);
+  job = saver.job;
+  saver.job = NULL;
+  g_mutex_unlock(&saver.lock);
+
+  /* taken by an earlier run already */
+  if (!job)
+    return;
+
+  written = write_settings(job, &conflict);
+
+  g_mutex_lock(&saver.lock);
+
+  if (written) {
+    if (saver.written)
+      free_settings(saver.written);
+    else
+      saver.written = g_new(settings_t, 1);
+
+    *saver.written = job->ours;
+    memset(&job->ours, 0, sizeof(settings_t));
+  }
+  else if (conflict) {
+    if (saver.conflict) {
+      free_settings(saver.conflict);
+      g_free(saver.conflict);
+    }
+
+    saver.conflict = conflict;
+  }
+  else
+    saver.failed = TRUE;
+
+  g_mutex_unlock(&saver.lock);
+
+  g_idle_add(on_settings_saved, &saver);
+  free_job(job);
+}
+
+/* waits for the queued saves, then writes anything merged meanwhile */
+static void flush_settings()
+{
+  save_job_t  *job = NULL;
+  settings_t  *conflict = NULL;
+
+  if (!saver.pool)
+    return;
+
+  g_thread_pool_free(saver.pool, FALSE, TRUE);
+  saver.pool = NULL;
+
+  while (g_source_remove_by_user_data(&saver));
+
+  if (sync_saved(FALSE)) {
+    job = make_job();
+
+    if (!write_settings(job, &conflict) && conflict) {
+      cc_warn("WARN: '%s' keeps changing, its edits win\n", cfg_file);
+      free_settings(conflict);
+      g_free(conflict);
+    }
+
+    free_job(job);
+  }
+
+  free_settings(&saver.last);
+}
+
+void cc_save_settings(void)
+{
+  save_job_t *job = make_job();
+
+  g_mutex_lock(&saver.lock);
+  if (saver.job)
+    free_job(saver.job);
+  saver.job = job;
+  g_mutex_unlock(&saver.lock);
+
+  if (!saver.pool)
+    saver.pool = g_thread_pool_new(save_worker, NULL, 1, FALSE, NULL);
+
+  g_thread_pool_push(saver.pool, &saver, NULL);
 }
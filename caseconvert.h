@@ -40,34 +40,71 @@
 #include <glib/gprintf.h>
 #include <gdk/gdkkeysyms.h>
 
-#include "caseconvert_types.h"
-
-typedef struct {
-  /* when converting to camel case, always upcase the first character, ie:
-   *  CamelCase instead of camelCase
-   */
-  gboolean  capitalize;
-
-  rule_t    *rules; /* the registered conversion rules */
-} config_t;
-
-/* must compile with -DVERBOSE to log */
-void cc_log(const char *fmt, ...);
-
-void cc_add_rule(rule_t *);
-void cc_rem_rule(gint id);
-rule_t* cc_get_rule(gint id);
-rule_t* cc_get_rules();
+#include "caseconvert_engine.h"
+#include "caseconvert_plan.h"
 
 /** converts case found within the editor's cursor selection */
 void cc_convert_selection();
 
+/** replaces the selected name with the next case style, see caseconvert_words.h */
+void cc_cycle_selection();
+
 /** converts all occurences of txt found in the specified range */
 void cc_convert_range(int r_begin, int r_end, gchar const *txt, gint txtsz, int flags);
 
+/**
+ * Plans converting all occurences of txt in the specified range, without
+ * touching the document, see caseconvert_plan.h. The plan is kept, and
+ * handed out again for as long as nothing it depends on changes; it's the
+ * one cc_convert_range() applies then.
+ *
+ * @return the plan, owned by the plugin, or NULL if txt can't be converted
+ */
+const cc_plan_t* cc_plan_range(int r_begin, int r_end, gchar const *txt, gint txtsz, int flags);
+
+/**
+ * Formats a plan of the current document as a unified diff, no more than
+ * "max_hunks" lines of it.
+ *
+ * @return the diff, free it with g_free()
+ */
+gchar* cc_preview_plan(const cc_plan_t *plan, gint max_hunks);
+
 /** converts all occurences of the selected text found in the document */
 void cc_convert_all();
 
+/** converts every name found in the selection, or in the document if
+ * nothing is selected, see caseconvert_plan.h */
+void cc_convert_document();
+
+/**
+ * Converts the selected symbol in every file of the project (or under the
+ * current document's directory), see caseconvert_scan.h. The files are
+ * scanned in the background and listed in the message window, then
+ * rewritten once confirmed; the open documents are edited instead.
+ */
+void cc_convert_everywhere();
+
+/**
+ * Replaces the names of a map file (see caseconvert_map.h) in the current
+ * document, or in every open one, in a single pass; with "fallback", the
+ * names not in the map are converted by the rules instead.
+ *
+ * @return the number of replacements, or -1 if the map couldn't be read;
+ * "problem" then says why, free it with g_free()
+ */
+gint cc_convert_map(const gchar *path, gboolean whole_word, gboolean fallback,
+                    gboolean all_documents, gchar **problem);
+
+/**
+ * Counts the occurences of txt in the current document, honoring the search
+ * flags, through its identifier index (see caseconvert_occur.h).
+ *
+ * @return the count, or -1 if the document isn't indexed (yet) or txt isn't
+ * an identifier
+ */
+gint cc_count_occurrences(gchar const *txt, int flags);
+
 /**
  * Helper for returning the selected text in the editor if the selection
  * is a single-line.
@@ -81,7 +118,8 @@ gchar* cc_get_selected_text(gint* sz);
 /** reads plugin preferences and registers previously defined rules */
 void cc_load_settings();
 
-/** saves plugin preferences and all defined rules */
+/** saves plugin preferences and all defined rules in the background, a save
+ * still waiting to be written is replaced */
 void cc_save_settings();
 
 #endif
@@ -0,0 +1,293 @@
+/*
+ *  caseconvert_acronyms.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_acronyms.h"
+#include "caseconvert_trace.h"
+#include "caseconvert_mem.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Hash and displace: the acronyms are first hashed into buckets of about
+ * BUCKET_SIZE, then, biggest bucket first, every bucket gets the smallest
+ * displacement that hashes all its acronyms into free slots. A lookup hashes
+ * the word once to find its bucket and once more with the bucket's
+ * displacement to find the only slot it can be in.
+ */
+#define BUCKET_SIZE   4
+#define MAX_TRIES     (1 << 20) /* displacements tried per bucket */
+#define MAX_SEEDS     16        /* bucket hashes tried before giving up */
+
+struct cc_acronyms_t {
+  volatile gint refcount;
+
+  guint32   nr_keys;      /* and slots */
+  guint32   nr_buckets;
+  guint32   seed;         /* of the bucket hash */
+  gint      max_len;
+
+  guint32   *displacements; /* per bucket */
+  guint32   *offsets;       /* per slot, of its acronym in the pool */
+  gint      *lens;          /* per slot */
+  gchar     *pool;          /* the acronyms in capitals, NUL separated */
+};
+
+/* FNV-1a over the capitalized word, finished with murmur's mixer */
+static guint32 hash_word(guint32 seed, const gchar *word, gint len)
+{
+  guint32 h = 2166136261U ^ (seed * 16777619U);
+  gint    i;
+
+  for (i = 0; i < len; ++i) {
+    h ^= (guchar)g_ascii_toupper(word[i]);
+    h *= 16777619U;
+  }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+
+  return h;
+}
+
+/* the keys of the buckets are in "members", bucket b owning the ones from
+ * first[b] to first[b+1] */
+typedef struct {
+  guint32 *first;
+  guint32 *members;
+  guint32 *order;   /* buckets, biggest first */
+} buckets_t;
+
+static gint bucket_size(const buckets_t *b, guint32 bucket)
+{
+  return b->first[bucket + 1] - b->first[bucket];
+}
+
+static const buckets_t *sorting = NULL;
+
+static gint by_size(gconstpointer a, gconstpointer b)
+{
+  return bucket_size(sorting, *(const guint32*)b) - bucket_size(sorting, *(const guint32*)a);
+}
+
+/* tries to place every key with the current seed, FALSE if some bucket
+ * can't be placed */
+static gboolean place(cc_acronyms_t *acr, gchar **keys, buckets_t *b, gint *slot_key)
+{
+  guint32   n = acr->nr_keys, nb = acr->nr_buckets;
+  guint32   *hashes = g_new(guint32, n);
+  guint32   *fill = g_new0(guint32, nb);
+  guint32   *tried = g_new(guint32, BUCKET_SIZE * 8);
+  gboolean  placed = TRUE;
+  guint32   i, k, d, bucket;
+
+  memset(b->first, 0, sizeof(guint32) * (nb + 1));
+
+  for (i = 0; i < n; ++i) {
+    hashes[i] = hash_word(acr->seed, keys[i], strlen(keys[i])) % nb;
+    ++b->first[hashes[i] + 1];
+  }
+
+  for (i = 0; i < nb; ++i)
+    b->first[i + 1] += b->first[i];
+
+  for (i = 0; i < n; ++i)
+    b->members[b->first[hashes[i]] + fill[hashes[i]]++] = i;
+
+  for (i = 0; i < nb; ++i)
+    b->order[i] = i;
+
+  sorting = b;
+  qsort(b->order, nb, sizeof(guint32), by_size);
+
+  for (i = 0; i < n; ++i)
+    slot_key[i] = -1;
+
+  for (i = 0; i < nb && placed; ++i)
+  {
+    gint size = bucket_size(b, b->order[i]);
+
+    bucket = b->order[i];
+    acr->displacements[bucket] = 0;
+
+    if (size == 0)
+      continue;
+
+    /* a bucket bigger than expected still gets its room */
+    if (size > BUCKET_SIZE * 8) {
+      g_free(tried);
+      tried = g_new(guint32, size);
+    }
+
+    placed = FALSE;
+
+    for (d = 1; d < MAX_TRIES && !placed; ++d)
+    {
+      placed = TRUE;
+
+      for (k = 0; k < (guint32)size && placed; ++k) {
+        guint32 key = b->members[b->first[bucket] + k];
+        guint32 slot = hash_word(d, keys[key], strlen(keys[key])) % n;
+
+        if (slot_key[slot] >= 0) {
+          placed = FALSE;
+          break;
+        }
+
+        tried[k] = slot;
+        slot_key[slot] = key;
+      }
+
+      /* take back the slots of a failed try */
+      if (!placed)
+        while (k-- > 0)
+          slot_key[tried[k]] = -1;
+      else
+        acr->displacements[bucket] = d;
+    }
+  }
+
+  g_free(tried);
+  g_free(fill);
+  g_free(hashes);
+
+  return placed;
+}
+
+cc_acronyms_t* cc_acronyms_new(const gchar *list)
+{
+  cc_acronyms_t *acr = NULL;
+  GHashTable    *seen = g_hash_table_new(g_str_hash, g_str_equal);
+  GPtrArray     *keys = g_ptr_array_new_with_free_func(g_free);
+  gchar         **names = g_strsplit_set(list ? list : "", ";, \t", -1);
+  buckets_t     b;
+  gint          *slot_key = NULL;
+  gsize         poolsz = 0;
+  gchar         *pool = NULL;
+  gint          i;
+
+  for (i = 0; names[i]; ++i) {
+    gchar *key = g_ascii_strup(names[i], -1);
+
+    if (!*key || g_hash_table_lookup(seen, key)) {
+      g_free(key);
+      continue;
+    }
+
+    g_hash_table_insert(seen, key, key);
+    g_ptr_array_add(keys, key);
+    poolsz += strlen(key) + 1;
+  }
+
+  g_strfreev(names);
+  g_hash_table_destroy(seen);
+
+  if (keys->len == 0) {
+    g_ptr_array_free(keys, TRUE);
+    return NULL;
+  }
+
+  acr = cc_malloc0(CC_MEM_RULES, sizeof(cc_acronyms_t));
+  acr->refcount = 1;
+  acr->nr_keys = keys->len;
+  acr->nr_buckets = (keys->len + BUCKET_SIZE - 1) / BUCKET_SIZE;
+  acr->displacements = cc_malloc0(CC_MEM_RULES, sizeof(guint32) * acr->nr_buckets);
+  acr->offsets = cc_malloc0(CC_MEM_RULES, sizeof(guint32) * acr->nr_keys);
+  acr->lens = cc_malloc0(CC_MEM_RULES, sizeof(gint) * acr->nr_keys);
+  acr->pool = cc_malloc(CC_MEM_RULES, poolsz);
+
+  b.first = g_new(guint32, acr->nr_buckets + 1);
+  b.members = g_new(guint32, acr->nr_keys);
+  b.order = g_new(guint32, acr->nr_buckets);
+  slot_key = g_new(gint, acr->nr_keys);
+
+  for (acr->seed = 0; acr->seed < MAX_SEEDS; ++acr->seed)
+    if (place(acr, (gchar**)keys->pdata, &b, slot_key))
+      break;
+
+  if (acr->seed == MAX_SEEDS) {
+    cc_warn("WARN: unable to compile %d acronyms, ignoring them\n", acr->nr_keys);
+    acr->refcount = 1;
+    cc_acronyms_unref(acr);
+    acr = NULL;
+  }
+  else {
+    pool = acr->pool;
+
+    for (i = 0; i < (gint)acr->nr_keys; ++i) {
+      const gchar *key = g_ptr_array_index(keys, slot_key[i]);
+
+      acr->offsets[i] = pool - acr->pool;
+      acr->lens[i] = strlen(key);
+      acr->max_len = MAX(acr->max_len, acr->lens[i]);
+      memcpy(pool, key, acr->lens[i] + 1);
+      pool += acr->lens[i] + 1;
+    }
+
+    cc_debug("compiled %d acronyms into %d buckets (seed %d)\n",
+      acr->nr_keys, acr->nr_buckets, acr->seed);
+  }
+
+  g_free(slot_key);
+  g_free(b.order);
+  g_free(b.members);
+  g_free(b.first);
+  g_ptr_array_free(keys, TRUE);
+
+  return acr;
+}
+
+cc_acronyms_t* cc_acronyms_ref(cc_acronyms_t *acr)
+{
+  g_atomic_int_inc(&acr->refcount);
+
+  return acr;
+}
+
+void cc_acronyms_unref(cc_acronyms_t *acr)
+{
+  if (!acr || !g_atomic_int_dec_and_test(&acr->refcount))
+    return;
+
+  cc_free(acr->displacements);
+  cc_free(acr->offsets);
+  cc_free(acr->lens);
+  cc_free(acr->pool);
+  cc_free(acr);
+}
+
+gboolean cc_acronyms_lookup(const cc_acronyms_t *acr, const gchar *word, gint len)
+{
+  guint32 bucket, slot;
+
+  if (!acr || len <= 0 || len > acr->max_len)
+    return FALSE;
+
+  bucket = hash_word(acr->seed, word, len) % acr->nr_buckets;
+  slot = hash_word(acr->displacements[bucket], word, len) % acr->nr_keys;
+
+  return acr->lens[slot] == len && g_ascii_strncasecmp(acr->pool + acr->offsets[slot], word, len) == 0;
+}
+
+gint cc_acronyms_max_len(const cc_acronyms_t *acr)
+{
+  return acr ? acr->max_len : 0;
+}
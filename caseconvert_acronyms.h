@@ -0,0 +1,58 @@
+/*
+ *  caseconvert_acronyms.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_ACRONYMS_H
+#define H_GEANY_CASE_CONVERT_ACRONYMS_H
+
+#include <glib.h>
+
+/*
+ * The acronym dictionary.
+ *
+ * A list of acronyms ("HTTP;URL;XML", from acronyms= in caseconvert.conf)
+ * compiled into a minimal perfect hash: n acronyms take n slots, and telling
+ * whether a word is one of them costs two hashes of the word and one
+ * comparison, whatever the size of the list. Lookups ignore case.
+ *
+ * The word splitter uses it to cut runs of capitals into the acronyms they
+ * are made of ("HTTPURLParser" => HTTP URL Parser, "IDs" => IDs) and the
+ * camelCase emitters to spell acronyms in capitals ("http_url" => "httpURL").
+ *
+ * A compiled dictionary never changes and may be shared across threads.
+ */
+
+typedef struct cc_acronyms_t cc_acronyms_t;
+
+/**
+ * Compiles the acronyms in "list", separated by ';', ',' or spaces.
+ * Duplicates are ignored.
+ *
+ * @return the dictionary holding one reference, or NULL if the list is empty
+ */
+cc_acronyms_t*  cc_acronyms_new(const gchar *list);
+cc_acronyms_t*  cc_acronyms_ref(cc_acronyms_t*);
+void            cc_acronyms_unref(cc_acronyms_t*);
+
+/* whether the "len" bytes at "word" spell an acronym, in any case */
+gboolean        cc_acronyms_lookup(const cc_acronyms_t*, const gchar *word, gint len);
+
+/* the length of the longest acronym */
+gint            cc_acronyms_max_len(const cc_acronyms_t*);
+
+#endif
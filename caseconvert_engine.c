@@ -0,0 +1,1259 @@
+/*
+ *  caseconvert_engine.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_engine.h"
+#include "caseconvert_probes.h"
+#include "caseconvert_ruleset.h"
+#include "caseconvert_words.h"
+#include <stdlib.h>
+#include <string.h>
+
+static config_t config;
+
+/* what conversions go through, laid out from the analyzed rules whenever
+ * they change and published for any thread to pick up, see build_ruleset() */
+static cc_ruleset_t * volatile ruleset = NULL;
+static gboolean     ruleset_stale = TRUE;
+
+/* readers pick up the published rule set within a grace period, counted
+ * per epoch, which publishers wait out before releasing the previous one;
+ * publishers take turns (they're always on the main thread anyway) */
+static volatile gint readers[2];
+static volatile gint epoch = 0;
+G_LOCK_DEFINE_STATIC(publish);
+
+/* filetype scopes are numbered as they're first seen and keep their number
+ * for good, so the active one stays valid across rule sets; 0 stands for no
+ * filetype in particular, see cc_set_filetype() */
+static GHashTable     *scopes = NULL;
+static gint           nr_scopes = 1;
+static volatile gint  active_scope = 0;
+
+/* the acronym list and the word boundary grammar as the user wrote them,
+ * and compiled */
+static gchar          *acronyms_src = NULL;
+static cc_acronyms_t  *acronyms = NULL;
+static gchar          *grammar_src = NULL;
+static cc_grammar_t   *grammar = NULL;
+
+static void build_ruleset();
+
+/* tokens are generated by splitting a string using a delimiter */
+typedef struct token_t token_t;
+struct token_t {
+  gchar   *value;
+  size_t  valsz;
+  token_t *next;
+};
+
+/* returns a set of tokens by splitting "str" using "delim", a backslash
+ * escapes the character following it (see append_escaped()) */
+static token_t* tokenize(const gchar *str, gchar delim, int *nr_tokens)
+{
+  token_t     *first = NULL, *tok = NULL, *tmptok = NULL;
+  GString     *val = g_string_sized_new(32);
+  const gchar *c = NULL;
+  *nr_tokens   = 0;
+
+  for (c = str; ; ++c)
+  {
+    if (*c == '\\' && c[1] != '\0') {
+      g_string_append_c(val, *++c);
+      continue;
+    }
+
+    if (*c != delim && *c != '\0') {
+      g_string_append_c(val, *c);
+      continue;
+    }
+
+    /* define token, empty ones included */
+    tok = cc_malloc(CC_MEM_SETTINGS, sizeof(token_t));
+    tok->next = NULL;
+    tok->valsz = val->len;
+    tok->value = cc_strndup(CC_MEM_SETTINGS, val->str, val->len);
+
+    if (tmptok)
+    {
+      tmptok->next = tok;
+    }
+
+    if (!first) first = tok;
+
+    tmptok = tok;
+    g_string_truncate(val, 0);
+
+    ++(*nr_tokens);
+
+    if (*c == '\0')
+      break;
+  }
+
+  g_string_free(val, TRUE);
+
+  return first;
+}
+
+/* escapes the characters of a value that delimit rule definitions */
+static void append_escaped(GString *out, const gchar *value)
+{
+  for (; value && *value; ++value) {
+    if (*value == '\\' || *value == ',' || *value == '[' || *value == ']')
+      g_string_append_c(out, '\\');
+
+    g_string_append_c(out, *value);
+  }
+}
+
+/* frees a list of tokens along with their values */
+static void free_tokens(token_t *tokens)
+{
+  token_t *tok = NULL;
+
+  while (tokens) {
+    tok = tokens;
+    tokens = tokens->next;
+    cc_free(tok->value);
+    cc_free(tok);
+  }
+}
+
+config_t* cc_get_config()
+{
+  return &config;
+}
+
+/* appends a list of compiled rules to the rule set at once, without
+ * publishing it */
+static void register_rules(rule_t *rules)
+{
+  rule_t  **tail = &config.rules;
+  rule_t  *r = NULL;
+
+  if (!rules)
+    return;
+
+  for (r = rules; r != NULL; r = r->next) {
+    cc_debug("adding rule %d: '%s', %s\n", r->id, r->label ? r->label : "Unlabelled",
+      r->domain == CC_RULE_C2S ? "camelToSnake" : "snake_to_camel");
+
+    config.max_id = MAX(config.max_id, r->id);
+  }
+
+  /* append to the end of the rule list */
+  while (*tail)
+    tail = &(*tail)->next;
+
+  *tail = rules;
+
+  /* only the new rules need compiling */
+  ruleset_stale = TRUE;
+  ++config.generation;
+}
+
+/* adds a single rule, compiling it first */
+static void register_rule(rule_t *r)
+{
+  action_t *act = NULL;
+  gint i = 0;
+
+  cc_debug("\tcondition: '%s' (%d)\n", r->condition->value, r->condition->type);
+
+  cc_debug("\tactions: \n");
+  for (act = r->actions; act != NULL; act = act->next, ++i)
+  {
+    cc_debug("\t\t(%d). '%s' (%d)\n", i, act->value, act->type);
+  }
+
+  cc_compile_rule(r);
+
+  r->next = NULL;
+  register_rules(r);
+}
+
+void cc_add_rule(rule_t *r)
+{
+  register_rule(r);
+  cc_analyze_rules();
+}
+
+void cc_rem_rule(G_GNUC_UNUSED gint id)
+{
+}
+
+rule_t* cc_get_rule(gint id)
+{
+  rule_t *iter = NULL;
+  for (iter = config.rules; iter != NULL; iter = iter->next)
+    if (iter->id == id) return iter;
+
+  return NULL;
+}
+
+rule_t* cc_get_rules()
+{
+  return config.rules;
+}
+
+void cc_clear_rules()
+{
+  rule_t *rule, *tmprule = NULL;
+
+  /* free rules, their actions and conditions */
+  for (rule = config.rules; rule != NULL;) {
+    tmprule = rule;
+    rule = rule->next;
+    cc_free_rule(&tmprule);
+  }
+
+  config.rules = NULL;
+  cc_rules_changed();
+}
+
+void cc_rules_changed()
+{
+  rule_t *rule = NULL;
+
+  /* rules may have been edited in place, their programs are stale */
+  for (rule = config.rules; rule != NULL; rule = rule->next)
+    cc_compile_rule(rule);
+
+  ruleset_stale = TRUE;
+  ++config.generation;
+
+  cc_analyze_rules();
+}
+
+void cc_rule_changed(rule_t *rule)
+{
+  cc_rules_edited(&rule, 1);
+}
+
+void cc_rules_edited(rule_t **rules, gint nr_rules)
+{
+  gint i;
+
+  for (i = 0; i < nr_rules; ++i)
+    cc_compile_rule(rules[i]);
+
+  ruleset_stale = TRUE;
+  ++config.generation;
+
+  cc_analyze_rules();
+}
+
+guint cc_rules_generation()
+{
+  return config.generation;
+}
+
+/* whether the removals of a rule only ever remove what its condition
+ * guarantees the input has: removals are blind, they strip as many bytes as
+ * their value has without looking at them, so only a HAS_PREFIX condition
+ * can vouch for a prefix removal and a HAS_SUFFIX one for a suffix removal.
+ * Empty removals remove nothing, or the match of a MATCHES condition */
+static gboolean removes_guaranteed(const cc_prog_t *prog)
+{
+  const cc_op_t *op = NULL;
+  gint          prefix = 0, suffix = 0; /* removed so far */
+  gint          i;
+
+  for (i = 0; i < prog->nr_ops; ++i) {
+    op = &prog->ops[i];
+
+    if (op->len == 0)
+      continue;
+
+    if (op->type == CC_ACT_REM_PREFIX) {
+      if (prog->cnd_type != CC_CND_HAS_PREFIX
+      ||  prefix + op->len > prog->cnd_len
+      ||  memcmp(prog->cnd_value + prefix, op->value, op->len) != 0)
+        return FALSE;
+
+      prefix += op->len;
+    }
+    else if (op->type == CC_ACT_REM_SUFFIX) {
+      if (prog->cnd_type != CC_CND_HAS_SUFFIX
+      ||  suffix + op->len > prog->cnd_len
+      ||  memcmp(prog->cnd_value + prog->cnd_len - suffix - op->len, op->value, op->len) != 0)
+        return FALSE;
+
+      suffix += op->len;
+    }
+  }
+
+  return TRUE;
+}
+
+/* the earlier live rule with the given condition value, as indexed in
+ * "seen" by its scope and value */
+static rule_t* lookup_seen(GHashTable *seen, GString *key, const gchar *scope,
+                           const gchar *value, gint len)
+{
+  g_string_truncate(key, 0);
+  for (; scope && *scope; ++scope)
+    g_string_append_c(key, g_ascii_tolower(*scope));
+  g_string_append_c(key, '\n');
+  g_string_append_len(key, value, len);
+
+  return g_hash_table_lookup(seen, key->str);
+}
+
+/* an earlier rule only covers "rule" if it applies to no filetype in
+ * particular or to the very same ones */
+static rule_t* find_covering(GHashTable *seen, GString *key, const rule_t *rule,
+                             const gchar *value, gint len)
+{
+  rule_t *shadow = lookup_seen(seen, key, NULL, value, len);
+
+  if (!shadow && rule->filetypes)
+    shadow = lookup_seen(seen, key, rule->filetypes, value, len);
+
+  return shadow;
+}
+
+/* flags "rule" if an earlier live rule of the domain always applies first */
+static void find_shadow(rule_t *rule, GHashTable **seen, GString *key)
+{
+  cc_prog_t *prog = &rule->prog;
+  rule_t    *shadow = NULL;
+  gint      i;
+
+  if ((shadow = find_covering(seen[CC_CND_ALWAYS_TRUE], key, rule, "", 0))) {
+    prog->status = prog->cnd_type == CC_CND_ALWAYS_TRUE ? CC_RULE_DUPLICATE : CC_RULE_SHADOWED;
+    prog->shadowed_by = shadow->id;
+    return;
+  }
+
+  /* any rule with a prefix of this rule's prefix (or a suffix of its suffix)
+   * takes every input this one would */
+  for (i = 0; i <= prog->cnd_len && !shadow; ++i)
+  {
+    switch (prog->cnd_type)
+    {
+      case CC_CND_HAS_PREFIX:
+        shadow = find_covering(seen[CC_CND_HAS_PREFIX], key, rule, prog->cnd_value, i);
+      break;
+      case CC_CND_HAS_SUFFIX:
+        shadow = find_covering(seen[CC_CND_HAS_SUFFIX], key, rule, prog->cnd_value + prog->cnd_len - i, i);
+      break;
+      case CC_CND_MATCHES:
+        /* expressions are only compared as a whole */
+        if (i == prog->cnd_len)
+          shadow = find_covering(seen[CC_CND_MATCHES], key, rule, prog->cnd_value, i);
+      break;
+    }
+
+    if (shadow) {
+      prog->status = i == prog->cnd_len ? CC_RULE_DUPLICATE : CC_RULE_SHADOWED;
+      prog->shadowed_by = shadow->id;
+    }
+  }
+}
+
+/* analyzes the rules of a domain, see cc_analyze_rules() */
+static void analyze_domain(gint domain)
+{
+  GHashTable  *seen[CC_CND_MATCHES + 1]; /* live rules by scope and condition value */
+  GString     *key = g_string_sized_new(32);
+  rule_t      *rule = NULL;
+  cc_prog_t   *prog = NULL;
+  gint        i;
+
+  for (i = 0; i <= CC_CND_MATCHES; ++i)
+    seen[i] = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (rule = config.rules; rule != NULL; rule = rule->next)
+  {
+    if ((gint)rule->domain != domain || !rule->enabled)
+      continue;
+
+    prog = &rule->prog;
+    prog->status = CC_RULE_LIVE;
+    prog->shadowed_by = 0;
+
+    if (prog->cnd_type == CC_CND_NULL || !removes_guaranteed(prog))
+      prog->status = CC_RULE_IMPOSSIBLE;
+    else
+      find_shadow(rule, seen, key);
+
+    if (prog->status != CC_RULE_LIVE) {
+      if (prog->status == CC_RULE_IMPOSSIBLE)
+        cc_info("rule (%d => '%s') can never apply as written\n", rule->id, rule->label);
+      else
+        cc_info("rule (%d => '%s') can never apply: %s rule %d\n", rule->id, rule->label,
+          prog->status == CC_RULE_DUPLICATE ? "duplicate of" : "shadowed by", prog->shadowed_by);
+      continue;
+    }
+
+    lookup_seen(seen[prog->cnd_type], key, rule->filetypes,
+      prog->cnd_type == CC_CND_ALWAYS_TRUE ? "" : prog->cnd_value,
+      prog->cnd_type == CC_CND_ALWAYS_TRUE ? 0 : prog->cnd_len);
+    g_hash_table_insert(seen[prog->cnd_type], g_strdup(key->str), rule);
+  }
+
+  for (i = 0; i <= CC_CND_MATCHES; ++i)
+    g_hash_table_destroy(seen[i]);
+
+  g_string_free(key, TRUE);
+}
+
+/* returns once every reader that may have picked up the rule set published
+ * before the call is done with it, flipping the epoch twice as a reader may
+ * have read it right before the first flip */
+static void wait_for_readers()
+{
+  gint i, e;
+
+  for (i = 0; i < 2; ++i) {
+    e = g_atomic_int_get(&epoch);
+    g_atomic_int_set(&epoch, e + 1);
+
+    while (g_atomic_int_get(&readers[e & 1]) > 0)
+      g_thread_yield();
+  }
+}
+
+/* swaps in a new rule set, the previous one is released when its last
+ * reader is done with it */
+static void publish_ruleset(cc_ruleset_t *rs)
+{
+  cc_ruleset_t *old = NULL;
+
+  G_LOCK(publish);
+
+  old = g_atomic_pointer_get(&ruleset);
+  g_atomic_pointer_set(&ruleset, rs);
+  wait_for_readers();
+
+  G_UNLOCK(publish);
+
+  cc_ruleset_unref(old);
+}
+
+cc_ruleset_t* cc_acquire_ruleset()
+{
+  cc_ruleset_t  *rs = NULL;
+  gint          e = g_atomic_int_get(&epoch) & 1;
+
+  g_atomic_int_inc(&readers[e]);
+
+  rs = g_atomic_pointer_get(&ruleset);
+  if (rs)
+    cc_ruleset_ref(rs);
+
+  g_atomic_int_add(&readers[e], -1);
+
+  return rs;
+}
+
+void cc_release_ruleset(cc_ruleset_t *rs)
+{
+  cc_ruleset_unref(rs);
+}
+
+/* the number of a filetype's scope, numbering it if it's new */
+static gint scope_of(const gchar *filetype)
+{
+  gchar     *name = g_ascii_strdown(filetype, -1);
+  gpointer  scope = NULL;
+
+  if (!scopes)
+    scopes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  g_strstrip(name);
+
+  if (!*name) {
+    g_free(name);
+    return 0;
+  }
+
+  if (!g_hash_table_lookup_extended(scopes, name, NULL, &scope)) {
+    scope = GINT_TO_POINTER(nr_scopes++);
+    g_hash_table_insert(scopes, name, scope);
+    cc_debug("filetype '%s' is scope %d\n", name, GPOINTER_TO_INT(scope));
+  }
+  else
+    g_free(name);
+
+  return GPOINTER_TO_INT(scope);
+}
+
+void cc_set_filetype(const gchar *filetype)
+{
+  g_atomic_int_set(&active_scope, filetype ? scope_of(filetype) : 0);
+}
+
+/* analyzes the rules and publishes them laid out for conversions */
+static void build_ruleset()
+{
+  rule_t  *rule = NULL;
+  gchar   **names = NULL;
+  gint    i;
+
+  /* every filetype the rules are scoped to needs its number */
+  for (rule = config.rules; rule != NULL; rule = rule->next) {
+    if (!rule->filetypes)
+      continue;
+
+    names = g_strsplit(rule->filetypes, ";", -1);
+    for (i = 0; names[i]; ++i)
+      scope_of(names[i]);
+    g_strfreev(names);
+  }
+
+  /* rules of no domain at all can't apply either */
+  for (rule = config.rules; rule != NULL; rule = rule->next) {
+    if (rule->domain != CC_RULE_S2C && rule->domain != CC_RULE_C2S) {
+      rule->prog.status = CC_RULE_IMPOSSIBLE;
+      cc_warn("WARN: invalid rule domain (%d => '%s')!\n", rule->id, rule->label);
+    }
+  }
+
+  analyze_domain(CC_RULE_S2C);
+  analyze_domain(CC_RULE_C2S);
+
+  publish_ruleset(config.rules || grammar || acronyms
+    ? cc_ruleset_new(config.rules, scopes, nr_scopes, grammar, acronyms)
+    : NULL);
+
+  ruleset_stale = FALSE;
+}
+
+void cc_analyze_rules()
+{
+  if (ruleset_stale)
+    build_ruleset();
+}
+
+void cc_set_acronyms(const gchar *list)
+{
+  cc_free(acronyms_src);
+  cc_acronyms_unref(acronyms);
+
+  acronyms_src = list && *list ? cc_strdup(CC_MEM_SETTINGS, list) : NULL;
+  acronyms = cc_acronyms_new(list);
+
+  ruleset_stale = TRUE;
+  ++config.generation;
+
+  cc_analyze_rules();
+}
+
+const gchar* cc_get_acronyms()
+{
+  return acronyms_src;
+}
+
+void cc_set_boundaries(const gchar *src)
+{
+  cc_free(grammar_src);
+  cc_grammar_unref(grammar);
+
+  grammar_src = src && *src ? cc_strdup(CC_MEM_SETTINGS, src) : NULL;
+  grammar = cc_grammar_new(src);
+
+  ruleset_stale = TRUE;
+  ++config.generation;
+
+  cc_analyze_rules();
+}
+
+const gchar* cc_get_boundaries()
+{
+  return grammar_src;
+}
+
+static gboolean is_snake(const cc_grammar_t *g, gchar const* in, size_t insz)
+{
+  guint i;
+  gboolean has_lc = FALSE; /* any lowercase letters ? */
+
+  /* a string is considered snake_cased if there's any single delimiter in the middle
+   * of the string and it contains lowercase letter(s) */
+  for (i = 0; i < insz; ++i) {
+    if (CC_GRAMMAR_CLASS(g, in[i]) == CC_CLASS_DELIM) {
+      if (i+1 < insz && CC_GRAMMAR_CLASS(g, in[i+1]) == CC_CLASS_DELIM) {
+        /* skip consecutive delimiters */
+        while (i+1 < insz && CC_GRAMMAR_CLASS(g, in[i+1]) == CC_CLASS_DELIM) ++i;
+        continue;
+      }
+
+      if (has_lc)
+        return TRUE;
+    }
+    else if (islower(in[i])) has_lc = TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean is_camel(gchar const* in, size_t insz)
+{
+  guint i;
+
+  /* a string is considered camelCased if any upper case letter is preceded
+   * or followed by a lower one */
+  for (i = 0; i < insz; ++i) {
+    if (isupper(in[i])
+    && ((i+1 < insz && isalpha(in[i+1]) && !isupper(in[i+1])) || (i > 0 && isalpha(in[i-1]) && !isupper(in[i-1]))))
+    {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* performs the actual conversion against "rs", see cc_convert_text() */
+static gchar* convert_text(const cc_ruleset_t *rs, gchar const* in, size_t insz,
+                           gint *outsz, gint *rule_id)
+{
+  /* the input, ignoring the NUL if it's counted in insz */
+  gint    n = 0;
+  gint    begin = 0;
+  gint    end = 0;
+
+  /* flags */
+  gboolean to_camel = FALSE; /* converting to CamelCase? (CC_RULE_S2C) */
+  gint     domain = CC_RULE_NULL; /* the rules that apply */
+
+  gchar *out      = NULL;   /* the final result buffer */
+
+  /* the transformed input, viewed as [prefix][stripped input][suffix] */
+  const gchar *segs[3] = { NULL, NULL, NULL };
+  gint        seglens[3] = { 0, 0, 0 };
+
+  /* its words, and the style to emit them in */
+  cc_words_t  words;
+  cc_style_t  style;
+
+  cc_match_t  match;
+
+  /* are we converting to CamelCase? */
+  if (is_snake(rs && rs->grammar ? rs->grammar : cc_grammar_default(), in, insz)) {
+    to_camel = TRUE;
+    domain = CC_RULE_S2C;
+
+    cc_debug("input '%s' is snake_cased\n", in);
+  }
+  /* to snake_case? */
+  else if (is_camel(in, insz)) {
+    domain = CC_RULE_C2S;
+
+    cc_debug("input '%s' is camelCased\n", in);
+  }
+  /* unable to identify the string case, abort */
+  else {
+    return NULL;
+  }
+
+  while ((size_t)n < insz && in[n] != '\0') ++n;
+  end = n;
+
+  /* the first matching rule tells how to transform the input */
+  if (rs && cc_ruleset_match(rs, domain, g_atomic_int_get(&active_scope), in, n, &match))
+  {
+    *rule_id = rs->ids[match.rule];
+
+    cc_debug("rule has been met! (%d) => (%s)\n", rs->cnd_types[match.rule],
+      rs->pool + rs->cnd_values[match.rule]);
+    cc_trace_event(CC_EV_RULE_MATCH, *rule_id, rs->cnd_types[match.rule]);
+    CC_PROBE3(rule__match, *rule_id, rs->cnd_types[match.rule], insz);
+
+    begin = match.begin;
+    end = match.end;
+    segs[0] = match.add_prefix;
+    seglens[0] = match.add_prefix_len;
+    segs[2] = match.add_suffix;
+    seglens[2] = match.add_suffix_len;
+  }
+
+  segs[1] = in + begin;
+  seglens[1] = end - begin;
+
+  if (to_camel)
+  {
+    /* convert snake_case => [prefix][c|C]amelCase[suffix]
+     *
+     * case 1:    "foo_bar"      => "fooBar"
+     * case 2:    "foo_bar"      => "FooBar"       (capitalize)
+     * case 3:    "singleton"    => "getSingleton" (add prefix)
+     * case 4:    "member_"      => "mMember"      (remove suffix, add prefix)
+     * case 5:    "foo_BAR"      => "fooBAR"       (maintain consecutive case)
+     * case 6.a:  "foo_BAR_zoo"  => "fooBARZoo"    (be smart about #5)
+     * case 6.b   "foo_bAR_zoo"  => "fooBARZoo"
+     * case 7:    "foo_bar__"    => "fooBar__"     (consecutive '_' are untouched)
+     */
+    style = config.capitalize ? CC_STYLE_PASCAL : CC_STYLE_CAMEL;
+  }
+  else
+  {
+    /* convert camelCase => snake_case
+     *
+     * case 1:    "fooBar"       => "foo_bar"
+     * case 2:    "mCURLObj"     => "m_curl_obj"
+     */
+    style = CC_STYLE_SNAKE;
+  }
+
+  /* an added prefix or suffix is a word of its own, so "singleton" gets the
+   * 'S' of "getSingleton" without touching the input; nothing left to
+   * convert if there are no words at all */
+  if (cc_words_split_view(segs, seglens, 3, rs ? rs->grammar : NULL, rs ? rs->acronyms : NULL, &words)) {
+    cc_debug("extracted (%d) words from '%s'\n", words.nr_words, in);
+    cc_trace_event(CC_EV_TOKENIZED, words.nr_words, style);
+
+    out = cc_words_convert(&words, style, outsz);
+    cc_words_clear(&words);
+
+    cc_debug("converted '%s' into %s '%s'\n", in, cc_style_name(style), out);
+  }
+
+  return out;
+}
+
+/* converts the case of "in", returns NULL if the case couldn't be identified */
+gchar* cc_convert_text(gchar const* in, size_t insz, gint *outsz)
+{
+  cc_ruleset_t  *rs = NULL;
+  gchar   *out = NULL;
+  gint    rule_id = -1;
+  gint64  t0 = CC_PROBE_CLOCK(convert__return);
+  cc_mem_stats_t snap;
+
+  cc_mem_get_thread_stats(CC_MEM_CONVERTER, &snap);
+  cc_trace_event(CC_EV_CONVERT_BEGIN, (gint32)insz, 0);
+  CC_PROBE1(convert__entry, insz);
+
+  rs = cc_acquire_ruleset();
+  out = convert_text(rs, in, insz, outsz, &rule_id);
+  cc_release_ruleset(rs);
+
+  /* nothing but the result may outlive a conversion, and the result is the
+   * only allocation unless the name has more than CC_WORDS_INLINE words */
+  CC_MEM_BUDGET(CC_MEM_CONVERTER, &snap, 2, out ? 1 : 0);
+
+  cc_trace_event(CC_EV_CONVERT_END, (gint32)insz, out ? *outsz : -1);
+  CC_PROBE4(convert__return, insz, out ? *outsz : -1, rule_id, CC_PROBE_ELAPSED(t0));
+
+  return out;
+}
+
+/*
+ * Finds the next rule definition in [p, end), skipping '#' comments up to
+ * the end of their line, and counting the lines it goes through in "line"
+ * if given.
+ *
+ * @return the definition, without its brackets, or NULL if there's no
+ * complete one left
+ */
+static const gchar* next_def(const gchar *p, const gchar *end, gint *defsz, gint *line)
+{
+  const gchar *def = NULL;
+
+  for (; p < end; ++p) {
+    if (*p == '\n' && line)
+      ++(*line);
+    else if (*p == '#') {
+      while (p + 1 < end && p[1] != '\n') ++p;
+    }
+    else if (*p == '[')
+      break;
+  }
+
+  if (p >= end)
+    return NULL;
+
+  for (def = ++p; p < end; ++p) {
+    if (*p == '\\') {
+      ++p;
+      continue;
+    }
+
+    if (*p == ']') {
+      *defsz = p - def;
+      return def;
+    }
+
+    if (*p == '\n' && line)
+      ++(*line);
+  }
+
+  return NULL;
+}
+
+/*
+ * Parses a single rule definition, as found by next_def(); the rule is
+ * neither compiled nor checked for anything but its syntax.
+ *
+ * @return the rule, or NULL if the definition is malformed
+ */
+static rule_t* parse_rule(const gchar *def, gint defsz)
+{
+  rule_t    *r = NULL;
+  token_t   *tokens = NULL;
+  token_t   *tok = NULL;
+  gint      nr_tokens = 0;
+  gchar     *rbuf = NULL;
+  gint      x = 0;
+
+  /* rule format:
+   * [id,label,enabled,domain[@filetypes],cnd_type,cnd_val,act1_type,act1_val,...,actN_type,actN_val]
+   */
+  rbuf = cc_strndup(CC_MEM_SETTINGS, def, defsz);
+  cc_debug("tokenizing %s\n", rbuf);
+  tokens = tokenize(rbuf, ',', &nr_tokens);
+  cc_free(rbuf);
+
+  /* validate the number of tokens, can't be less than 8 */
+  if (nr_tokens < 8 || nr_tokens % 2 != 0) {
+    cc_warn("warn: number of tokens in rule defintion is invalid: %d, expected an even number GE than 8\n", nr_tokens);
+    free_tokens(tokens);
+    return NULL;
+  }
+
+  tok = tokens;
+  r = cc_alloc_rule_id(atoi(tok->value));
+
+  /* parse ID */
+  cc_debug("rule id: %d\n", r->id);
+  tok = tok->next;
+
+  /* parse label */
+  r->label = cc_strdup(CC_MEM_RULES, tok->value);
+  cc_debug("rule label: %s\n", r->label);
+  tok = tok->next;
+
+  /* parse "enabled" flag */
+  r->enabled = atoi(tok->value);
+  cc_debug("rule enabled? %s(%d)\n", r->enabled ? "yes" : "no", r->enabled);
+  tok = tok->next;
+
+  /* parse the domain, and the filetypes it's scoped to if any: "1@C;C++" */
+  r->domain = atoi(tok->value);
+  cc_debug("rule domain? %s(%d)\n", r->domain == 0 ? "CC_RULE_C2S" : "CC_RULE_S2C", r->domain);
+  if (strchr(tok->value, '@') && strchr(tok->value, '@')[1] != '\0')
+    r->filetypes = cc_strdup(CC_MEM_RULES, strchr(tok->value, '@') + 1);
+  tok = tok->next;
+
+  /* rule condition now: */
+  {
+    condition_t *cnd = cc_alloc_cnd();
+
+    r->condition = cnd;
+
+    /* parse the type */
+    cnd->type = atoi(tok->value);
+    cc_debug("\tcondition type => %d\n", cnd->type);
+    tok = tok->next;
+
+    cnd->value = cc_strdup(CC_MEM_RULES, tok->value);
+    cc_debug("\tcondition value => %s\n", cnd->value);
+    tok = tok->next;
+  }
+
+  /* rule actions now */
+  {
+    gint offset = 6;
+    gint nr_actions = (nr_tokens - offset) / 2;
+    action_t  *act = NULL, *tmpact = NULL;
+
+    for (x = 0; x < nr_actions; ++x)
+    {
+      act = cc_alloc_act();
+
+      /* parse the type */
+      act->type = atoi(tok->value);
+      cc_debug("\taction type => %d\n", act->type);
+      tok = tok->next;
+
+      act->value = cc_strdup(CC_MEM_RULES, tok->value);
+      cc_debug("\tact value => %s\n", act->value);
+      tok = tok->next;
+
+      /* connect the actions */
+      if (!tmpact) {
+        r->actions = act;
+      } else {
+        tmpact->next = act;
+      }
+
+      tmpact = act;
+    }
+  }
+
+  free_tokens(tokens);
+
+  return r;
+}
+
+/* parses rule definitions into a list of uncompiled rules, appended to "out" */
+static gint parse_rules(const gchar *rules, rule_t **out)
+{
+  const gchar *p = rules, *end = rules + strlen(rules);
+  const gchar *def = NULL;
+  gint        defsz = 0;
+  gint        nr_rules = 0;         /* number of successfully parsed rules */
+  rule_t      *r = NULL, **tail = out;
+
+  while (*tail)
+    tail = &(*tail)->next;
+
+  while ((def = next_def(p, end, &defsz, NULL)) != NULL) {
+    p = def + defsz + 1;
+
+    if (!(r = parse_rule(def, defsz)))
+      continue;
+
+    /* queue the rule */
+    *tail = r;
+    tail = &r->next;
+    ++nr_rules;
+  }
+
+  return nr_rules;
+}
+
+gint cc_parse_rules(const gchar *defs)
+{
+  gint    nr_rules = 0;
+  rule_t  *rules = cc_load_rules(defs, &nr_rules);
+
+  /* the whole set is published at once */
+  register_rules(rules);
+  cc_analyze_rules();
+
+  return nr_rules;
+}
+
+rule_t* cc_load_rules(const gchar *defs, gint *nr_rules)
+{
+  rule_t  *rules = NULL, *rule = NULL;
+  gint    n = parse_rules(defs, &rules);
+
+  for (rule = rules; rule != NULL; rule = rule->next)
+    cc_compile_rule(rule);
+
+  if (nr_rules)
+    *nr_rules = n;
+
+  return rules;
+}
+
+void cc_free_rules(rule_t *rules)
+{
+  rule_t *next = NULL;
+
+  for (; rules != NULL; rules = next) {
+    next = rules->next;
+    cc_free_rule(&rules);
+  }
+}
+
+/* the definition of a single rule, as cc_serialize_rules() writes it */
+static void serialize_rule(GString *out, const rule_t *rule)
+{
+  action_t *act = NULL;
+
+  /* rule format:
+   * [id,label,enabled,domain[@filetypes],cnd_type,cnd_val,act1_type,act1_val,...,actN_type,actN_val]
+   */
+  g_string_append_printf(out, "[%d,", rule->id);
+  append_escaped(out, rule->label ? rule->label : "Unlabelled");
+  g_string_append_printf(out, ",%d,%d", rule->enabled, rule->domain);
+  if (rule->filetypes) {
+    g_string_append_c(out, '@');
+    append_escaped(out, rule->filetypes);
+  }
+  g_string_append_printf(out, ",%d,", rule->condition->type);
+  append_escaped(out, rule->condition->value);
+
+  /* rule actions */
+  for (act = rule->actions; act != NULL; act = act->next) {
+    g_string_append_printf(out, ",%d,", act->type);
+    append_escaped(out, act->value);
+  }
+
+  g_string_append_c(out, ']');
+}
+
+/* maps the id of every rule to its definition */
+static GHashTable* index_rules(const rule_t *rules)
+{
+  GHashTable  *defs = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  GString     *def = g_string_new("");
+
+  for (; rules != NULL; rules = rules->next) {
+    g_string_truncate(def, 0);
+    serialize_rule(def, rules);
+    g_hash_table_insert(defs, GINT_TO_POINTER(rules->id), g_strdup(def->str));
+  }
+
+  g_string_free(def, TRUE);
+
+  return defs;
+}
+
+static gboolean same_def(GHashTable *a, GHashTable *b, gint id)
+{
+  const gchar *x = g_hash_table_lookup(a, GINT_TO_POINTER(id));
+  const gchar *y = g_hash_table_lookup(b, GINT_TO_POINTER(id));
+
+  return x == y || (x && y && strcmp(x, y) == 0);
+}
+
+gint cc_merge_rules(const gchar *base, rule_t *theirs)
+{
+  rule_t      *base_rules = NULL, *rule = NULL, *next = NULL;
+  rule_t      *merged = NULL, **tail = &merged;
+  GHashTable  *base_defs, *our_defs, *their_defs;
+  GHashTable  *ours = g_hash_table_new(g_direct_hash, g_direct_equal);
+  GPtrArray   *order = g_ptr_array_new();
+  gint        nr_changed = 0, max_id = 0;
+  guint       i;
+
+  parse_rules(base ? base : "", &base_rules);
+  base_defs = index_rules(base_rules);
+  our_defs = index_rules(config.rules);
+  their_defs = index_rules(theirs);
+  cc_free_rules(base_rules);
+
+  /* our rules get relinked as they're merged */
+  for (rule = config.rules; rule != NULL; rule = rule->next) {
+    g_hash_table_insert(ours, GINT_TO_POINTER(rule->id), rule);
+    g_ptr_array_add(order, rule);
+    max_id = MAX(max_id, rule->id);
+  }
+
+  for (rule = theirs; rule != NULL; rule = rule->next)
+    max_id = MAX(max_id, rule->id);
+
+  /* their rules, in their order: ours where they didn't touch it, and
+   * theirs where they did, whatever we did to it meanwhile */
+  for (rule = theirs; rule != NULL; rule = next)
+  {
+    rule_t *our = g_hash_table_lookup(ours, GINT_TO_POINTER(rule->id));
+
+    next = rule->next;
+    rule->next = NULL;
+
+    if (same_def(base_defs, their_defs, rule->id)) {
+      cc_free_rule(&rule);
+
+      /* unless we removed it */
+      if (!our)
+        continue;
+
+      rule = our;
+      g_hash_table_remove(ours, GINT_TO_POINTER(our->id));
+    }
+    else {
+      if (!same_def(our_defs, their_defs, rule->id))
+        ++nr_changed;
+
+      /* a rule we added meanwhile which happens to have the same id keeps
+       * going under another one */
+      if (our && !g_hash_table_lookup(base_defs, GINT_TO_POINTER(our->id))) {
+        g_hash_table_remove(ours, GINT_TO_POINTER(our->id));
+        cc_set_rule_id(our, ++max_id);
+        g_hash_table_insert(ours, GINT_TO_POINTER(our->id), our);
+      }
+      else if (our) {
+        g_hash_table_remove(ours, GINT_TO_POINTER(our->id));
+        cc_free_rule(&our);
+      }
+    }
+
+    *tail = rule;
+    tail = &rule->next;
+  }
+
+  /* then the rules we added, the others were removed by them */
+  for (i = 0; i < order->len; ++i)
+  {
+    rule = g_ptr_array_index(order, i);
+
+    if (g_hash_table_lookup(ours, GINT_TO_POINTER(rule->id)) != rule)
+      continue;
+
+    if (g_hash_table_lookup(base_defs, GINT_TO_POINTER(rule->id))) {
+      cc_free_rule(&rule);
+      ++nr_changed;
+      continue;
+    }
+
+    *tail = rule;
+    tail = &rule->next;
+  }
+
+  *tail = NULL;
+
+  g_ptr_array_free(order, TRUE);
+  g_hash_table_destroy(ours);
+  g_hash_table_destroy(base_defs);
+  g_hash_table_destroy(our_defs);
+  g_hash_table_destroy(their_defs);
+
+  config.rules = merged;
+  config.max_id = MAX(config.max_id, max_id);
+
+  cc_info("merged rule definitions, %d rules changed\n", nr_changed);
+
+  /* only their rules are new, and they come compiled */
+  if (nr_changed) {
+    ruleset_stale = TRUE;
+    ++config.generation;
+    cc_analyze_rules();
+  }
+
+  return nr_changed;
+}
+
+/* the definition of a rule, serialized again only if it was edited since */
+static const gchar* rule_def(rule_t *rule)
+{
+  GString *def = NULL;
+
+  if (!rule->def) {
+    def = g_string_sized_new(64);
+    serialize_rule(def, rule);
+    rule->def = cc_strndup(CC_MEM_RULES, def->str, def->len);
+    g_string_free(def, TRUE);
+  }
+
+  return rule->def;
+}
+
+gchar* cc_serialize_rules(gint *nr_rules)
+{
+  GString   *rules = g_string_new("");
+  gchar     *out = NULL;
+  rule_t    *rule = NULL;
+
+  *nr_rules = 0;
+
+  for (rule = config.rules; rule != NULL; rule = rule->next)
+  {
+    g_string_append(rules, rule_def(rule));
+    ++(*nr_rules);
+  }
+
+  cc_debug("serialized (%d) rules: \n%s\n", *nr_rules, rules->str);
+
+  out = cc_strndup(CC_MEM_SETTINGS, rules->str, rules->len);
+  g_string_free(rules, TRUE);
+
+  return out;
+}
+
+gint cc_import_rules(const gchar *path, gchar **problem)
+{
+  GMappedFile *file = NULL;
+  const gchar *p = NULL, *end = NULL, *def = NULL, *q = NULL, *why = NULL;
+  gint        defsz = 0, line = 1, def_line = 1;
+  gint        nr_rules = 0, nr_invalid = 0;
+  gint64      t0 = g_get_monotonic_time();
+  rule_t      *rules = NULL, **tail = &rules, *r = NULL;
+
+  *problem = NULL;
+
+  file = g_mapped_file_new(path, FALSE, NULL);
+  if (!file) {
+    *problem = g_strdup_printf("'%s' can't be read", path);
+    return -1;
+  }
+
+  p = g_mapped_file_get_contents(file);
+  end = p + g_mapped_file_get_length(file);
+
+  /* one pass over the pack: every rule is parsed, compiled and checked as
+   * it's read, and numbered after the registered ones */
+  while ((def = next_def(p, end, &defsz, &line)) != NULL) {
+    p = def + defsz + 1;
+
+    /* the line the definition starts on */
+    for (def_line = line, q = def; q < p; ++q)
+      def_line -= (*q == '\n');
+
+    r = parse_rule(def, defsz);
+
+    if (r) {
+      cc_compile_rule(r);
+      why = cc_check_rule(r);
+    }
+    else
+      why = "malformed definition";
+
+    if (why) {
+      cc_warn("WARN: %s:%d: %s\n", path, def_line, why);
+
+      if (!nr_invalid++)
+        *problem = g_strdup_printf("line %d: %s", def_line, why);
+
+      if (r)
+        cc_free_rule(&r);
+
+      continue;
+    }
+
+    cc_set_rule_id(r, config.max_id + ++nr_rules);
+    *tail = r;
+    tail = &r->next;
+  }
+
+  g_mapped_file_unref(file);
+
+  /* a pack is taken as a whole or not at all */
+  if (nr_invalid) {
+    cc_free_rules(rules);
+    return -1;
+  }
+
+  register_rules(rules);
+  cc_analyze_rules();
+
+  cc_info("imported %d rules from '%s' in %.2fms\n", nr_rules, path,
+    (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+  return nr_rules;
+}
+
+gboolean cc_export_rules(const gchar *path, gint *nr_rules)
+{
+  GString   *pack = g_string_new(CC_PACK_HEADER "\n");
+  rule_t    *rule = NULL;
+  GError    *err = NULL;
+  gboolean  written = FALSE;
+
+  *nr_rules = 0;
+
+  for (rule = config.rules; rule != NULL; rule = rule->next) {
+    g_string_append(pack, rule_def(rule));
+    g_string_append_c(pack, '\n');
+    ++(*nr_rules);
+  }
+
+  if (!(written = g_file_set_contents(path, pack->str, pack->len, &err))) {
+    cc_warn("WARN: unable to write '%s': %s\n", path, err->message);
+    g_error_free(err);
+  }
+
+  g_string_free(pack, TRUE);
+
+  return written;
+}
@@ -0,0 +1,213 @@
+/*
+ *  caseconvert_engine.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_ENGINE_H
+#define H_GEANY_CASE_CONVERT_ENGINE_H
+
+/*
+ * The conversion engine and the rule store.
+ *
+ * Nothing in here depends on Geany, GTK or Scintilla so the engine can be
+ * driven headlessly (see caseconvert_tool.c).
+ *
+ * The rules are edited on the main thread only. Every edit that goes through
+ * cc_add_rule(), cc_parse_rules(), cc_rules_changed() or cc_clear_rules()
+ * publishes a new immutable rule set (see caseconvert_ruleset.h), which is
+ * what conversions work on, so cc_convert_text() may be called from any
+ * thread and never waits for the rules nor sees them half-edited.
+ */
+
+#include <glib.h>
+#include <ctype.h>
+
+#include "caseconvert_types.h"
+#include "caseconvert_ruleset.h"
+#include "caseconvert_trace.h"
+#include "caseconvert_mem.h"
+
+typedef struct {
+  /* when converting to camel case, always upcase the first character, ie:
+   *  CamelCase instead of camelCase
+   */
+  gboolean  capitalize;
+
+  rule_t    *rules;       /* the registered conversion rules */
+  guint     generation;   /* bumped whenever the rule set changes */
+  gint      max_id;       /* the highest id ever registered, new rules are
+                           * numbered after it */
+} config_t;
+
+config_t* cc_get_config();
+
+void cc_add_rule(rule_t *);
+void cc_rem_rule(gint id);
+rule_t* cc_get_rule(gint id);
+rule_t* cc_get_rules();
+
+/** unregisters and frees all the rules */
+void cc_clear_rules();
+
+/** must be called after rules are edited in place */
+void cc_rules_changed();
+
+/** same as cc_rules_changed() when only "rule" was edited, the others are
+ * neither recompiled nor serialized again */
+void cc_rule_changed(rule_t *rule);
+
+/** likewise for several rules, the rule set is published once */
+void cc_rules_edited(rule_t **rules, gint nr_rules);
+
+/** identifies the current state of the rule set, see cc_rules_changed() */
+guint cc_rules_generation();
+
+/**
+ * Analyzes the rule set, unless it's unchanged since the last analysis, and
+ * flags the enabled rules that can never apply in their program's status:
+ *
+ *  - shadowed: an earlier rule of the domain always applies first, ie one
+ *    that's always true, or has the prefix "get" when this one has "get_"
+ *  - duplicate: an earlier rule of the domain has the same condition
+ *  - impossible: the rule has no valid domain or condition, or removes more
+ *    of the input than its condition guarantees is there (a prefix removal
+ *    that isn't a prefix of the HAS_PREFIX value, any prefix removal under
+ *    another condition, and so on; only MATCHES rules' empty removals,
+ *    which remove the match, are left alone)
+ *
+ * Conversions only ever try the live rules. Publishing the rule set runs
+ * the analysis, this is for presenting its results.
+ */
+void cc_analyze_rules();
+
+/**
+ * Picks up the published rule set, without ever blocking.
+ *
+ * @return
+ * The rule set, or NULL if there are no rules. It stays valid until it's
+ * released with cc_release_ruleset(), however the rules change meanwhile.
+ */
+cc_ruleset_t* cc_acquire_ruleset();
+void          cc_release_ruleset(cc_ruleset_t*);
+
+/**
+ * Picks the rules scoped to "filetype" (a Geany filetype name, case doesn't
+ * matter) along with the unscoped ones for the conversions that follow. NULL
+ * picks the unscoped rules only.
+ *
+ * Meant to be called when the current document changes, conversions only
+ * read the number it resolves the name to.
+ */
+void          cc_set_filetype(const gchar *filetype);
+
+/**
+ * Replaces the acronym dictionary with the acronyms in "list" (see
+ * caseconvert_acronyms.h), NULL or an empty list clears it. Like a rule
+ * edit, this publishes a new rule set.
+ */
+void          cc_set_acronyms(const gchar *list);
+
+/* the list last given to cc_set_acronyms(), NULL if none */
+const gchar*  cc_get_acronyms();
+
+/**
+ * Replaces the word boundary grammar with "src" (see caseconvert_grammar.h),
+ * NULL or an empty one restores CC_GRAMMAR_DEFAULT. Like a rule edit, this
+ * publishes a new rule set.
+ */
+void          cc_set_boundaries(const gchar *src);
+
+/* the grammar last given to cc_set_boundaries(), NULL if none */
+const gchar*  cc_get_boundaries();
+
+/**
+ * Converts "in" from snake_case to camelCase or vice versa, applying the
+ * first matching rule.
+ *
+ * @return
+ * The converted text, or NULL if the case of "in" couldn't be identified.
+ * The result must be freed by the caller using cc_free().
+ */
+gchar* cc_convert_text(gchar const* in, size_t insz, gint *outsz);
+
+/**
+ * Parses and registers rule definitions in the format:
+ *  [id,label,enabled,domain[@filetypes],cnd_type,cnd_val,act1_type,act1_val,...]...
+ *
+ * where the optional filetypes scope the rule, ie "1@C;C++".
+ *
+ * @return the number of registered rules
+ */
+gint cc_parse_rules(const gchar *defs);
+
+/**
+ * Parses and compiles rule definitions without registering them, unlike the
+ * rest of the rule store this may be called from any thread.
+ *
+ * @return the rules, free them with cc_free_rules() unless they're merged
+ */
+rule_t* cc_load_rules(const gchar *defs, gint *nr_rules);
+void    cc_free_rules(rule_t *rules);
+
+/**
+ * Merges rules loaded by cc_load_rules() into the registered ones, given the
+ * definitions both started from ("base", ie what the config file held when
+ * it was last read or written). Rule by rule id:
+ *
+ *  - a rule they left as it was in "base" is kept as we have it, or left
+ *    out if we removed it
+ *  - a rule they added, edited or removed is taken from them, even if we
+ *    edited it too
+ *  - a rule we added is kept, under a new id if theirs took its id
+ *
+ * Kept rules aren't touched, and the rule set is only published if anything
+ * changed. "theirs" is taken over.
+ *
+ * @return the number of rules that changed
+ */
+gint    cc_merge_rules(const gchar *base, rule_t *theirs);
+
+/**
+ * Rule packs hold rule definitions, one per line after the header, and may
+ * have '#' comments between them:
+ *
+ *  # caseconvert rule pack
+ *  [1,Getter,1,1,1,get_,2,get_]
+ *  ...
+ *
+ * cc_import_rules() reads a pack in one pass and registers its rules after
+ * ours, numbered after ours whatever ids they had, as a single change to the
+ * rule set. Every rule is checked (see cc_check_rule()) and a pack with any
+ * invalid rule isn't imported at all; "problem" then describes the first
+ * one, free it with g_free().
+ *
+ * @return the number of rules imported, or -1
+ */
+#define CC_PACK_HEADER "# caseconvert rule pack"
+
+gint      cc_import_rules(const gchar *path, gchar **problem);
+
+/* writes all the registered rules into a pack, replacing "path" as a whole */
+gboolean  cc_export_rules(const gchar *path, gint *nr_rules);
+
+/**
+ * Serializes all the registered rules in the format understood by
+ * cc_parse_rules(). The result must be freed by the caller using cc_free().
+ */
+gchar* cc_serialize_rules(gint *nr_rules);
+
+#endif
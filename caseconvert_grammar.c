@@ -0,0 +1,187 @@
+/*
+ *  caseconvert_grammar.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_grammar.h"
+#include "caseconvert_trace.h"
+#include "caseconvert_mem.h"
+#include <string.h>
+
+/* the class named by a pattern letter, -1 if it's none */
+static gint class_of(gchar letter)
+{
+  switch (letter) {
+    case 'a': return CC_CLASS_LOWER;
+    case 'A': return CC_CLASS_UPPER;
+    case '0': return CC_CLASS_DIGIT;
+    case '*': return CC_CLASS_OTHER;
+    default:  return -1;
+  }
+}
+
+static void compile(cc_grammar_t *g, const gchar *src)
+{
+  gchar         **patterns = NULL;
+  const gchar   *delims = "_";
+  gboolean      breaks[CC_CLASS_DELIM][CC_CLASS_DELIM];
+  gboolean      backs[CC_CLASS_DELIM][CC_CLASS_DELIM];
+  gint          i, c, state;
+
+  memset(breaks, 0, sizeof(breaks));
+  memset(backs, 0, sizeof(backs));
+
+  patterns = g_strsplit_set(src, " \t", -1);
+
+  /* the delimiters are known before any sigil is */
+  for (i = 0; patterns[i]; ++i)
+    if (g_str_has_prefix(patterns[i], "delims="))
+      delims = patterns[i] + strlen("delims=");
+
+  for (c = 0; c < 256; ++c) {
+    if (c >= 'a' && c <= 'z')
+      g->classes[c] = CC_CLASS_LOWER;
+    else if (c >= 'A' && c <= 'Z')
+      g->classes[c] = CC_CLASS_UPPER;
+    else if (c >= '0' && c <= '9')
+      g->classes[c] = CC_CLASS_DIGIT;
+    else if (c && strchr(delims, c))
+      g->classes[c] = CC_CLASS_DELIM;
+    else
+      g->classes[c] = CC_CLASS_OTHER;
+  }
+
+  for (i = 0; patterns[i]; ++i)
+  {
+    const gchar *p = patterns[i];
+    gint        len = strlen(p);
+
+    if (!len)
+      continue;
+
+    if (g_str_has_prefix(p, "delims="))
+      continue;
+    else if (g_str_has_prefix(p, "sigils=")) {
+      for (p += strlen("sigils="); *p; ++p)
+        if (g->classes[(guchar)*p] == CC_CLASS_OTHER)
+          g->classes[(guchar)*p] = CC_CLASS_SIGIL;
+    }
+    else if (len == 2 && class_of(p[0]) >= 0 && class_of(p[1]) >= 0)
+      breaks[class_of(p[0])][class_of(p[1])] = TRUE;
+    else if (len == 3 && p[0] == p[1] && class_of(p[0]) >= 0 && class_of(p[2]) >= 0)
+      backs[class_of(p[0])][class_of(p[2])] = TRUE;
+    else
+      cc_warn("WARN: unknown word boundary pattern '%s', ignoring it\n", p);
+  }
+
+  g_strfreev(patterns);
+
+  /* every state knows what every byte does */
+  for (state = 0; state < CC_GRAMMAR_STATES; ++state)
+  {
+    gint prev = (state - 1) / 2;
+    gint run = (state - 1) % 2;
+
+    for (c = 0; c < 256; ++c)
+    {
+      gint cls = g->classes[c] == CC_CLASS_SIGIL ? CC_CLASS_OTHER : g->classes[c];
+      gint step = CC_STEP_JOIN;
+      gint next = CC_GRAMMAR_START;
+
+      if (cls == CC_CLASS_DELIM)
+        step = CC_STEP_DELIM;
+      else if (state == CC_GRAMMAR_START) {
+        step = CC_STEP_BREAK;
+        next = CC_GRAMMAR_STATE(cls, 0);
+      }
+      else {
+        if (breaks[prev][cls])
+          step = CC_STEP_BREAK;
+        else if (run && backs[prev][cls])
+          step = CC_STEP_BREAK_BACK;
+
+        next = CC_GRAMMAR_STATE(cls, prev == cls);
+      }
+
+      g->table[state][c] = (guint8)(next << 2 | step);
+    }
+  }
+
+  cc_debug("compiled word boundary grammar '%s'\n", src);
+}
+
+cc_grammar_t* cc_grammar_new(const gchar *src)
+{
+  cc_grammar_t *g = NULL;
+
+  if (!src || !*src)
+    return NULL;
+
+  g = cc_malloc0(CC_MEM_RULES, sizeof(cc_grammar_t));
+  g->refcount = 1;
+  compile(g, src);
+
+  return g;
+}
+
+cc_grammar_t* cc_grammar_with_delims(const cc_grammar_t *g, const gchar *delims)
+{
+  cc_grammar_t  *d = cc_malloc(CC_MEM_RULES, sizeof(cc_grammar_t));
+  gint          state;
+
+  memcpy(d, g ? g : cc_grammar_default(), sizeof(cc_grammar_t));
+  d->refcount = 1;
+
+  /* a delimiter ends the word whatever the state, so only its column changes */
+  for (; *delims; ++delims) {
+    d->classes[(guchar)*delims] = CC_CLASS_DELIM;
+
+    for (state = 0; state < CC_GRAMMAR_STATES; ++state)
+      d->table[state][(guchar)*delims] = (guint8)(CC_GRAMMAR_START << 2 | CC_STEP_DELIM);
+  }
+
+  return d;
+}
+
+cc_grammar_t* cc_grammar_ref(cc_grammar_t *g)
+{
+  g_atomic_int_inc(&g->refcount);
+
+  return g;
+}
+
+void cc_grammar_unref(cc_grammar_t *g)
+{
+  if (!g || !g_atomic_int_dec_and_test(&g->refcount))
+    return;
+
+  cc_free(g);
+}
+
+const cc_grammar_t* cc_grammar_default()
+{
+  static cc_grammar_t   grammar;
+  static volatile gsize compiled = 0;
+
+  if (g_once_init_enter(&compiled)) {
+    grammar.refcount = 1;
+    compile(&grammar, CC_GRAMMAR_DEFAULT);
+    g_once_init_leave(&compiled, 1);
+  }
+
+  return &grammar;
+}
@@ -0,0 +1,112 @@
+/*
+ *  caseconvert_grammar.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_GRAMMAR_H
+#define H_GEANY_CASE_CONVERT_GRAMMAR_H
+
+#include <glib.h>
+
+/*
+ * The word boundary grammar.
+ *
+ * Where a name breaks into words is told by a few patterns over classes of
+ * characters:
+ *
+ *  a  lower case letter      A  upper case letter
+ *  0  digit                  *  anything else
+ *
+ *  XY              a word starts at Y when it follows X: "aA" splits fooBar
+ *  XXY             a run of X followed by Y gives its last X to the next
+ *                  word, as long as two characters stay behind: "AAa" splits
+ *                  CURLObj into CURL Obj but keeps IDs whole
+ *  delims=<chars>  characters delimiting words, "_" if not given; anything
+ *                  else that isn't a letter or a digit is part of the word
+ *                  it's in: "self.foo_bar" => "self.fooBar"
+ *  sigils=<chars>  characters kept verbatim ahead of the name along with the
+ *                  leading delimiters: "$fooBar" => "$foo_bar"
+ *
+ * Patterns are separated by spaces, so a space can't be a delimiter. Digits
+ * join the word they follow unless "a0 A0" says otherwise.
+ *
+ * A run of delimiters is a single boundary, and it's kept as it is in every
+ * style; camelCase and PascalCase keep the letter following it as it is too:
+ * "foo__bar_baz" => "foo__barBaz" => "foo__bar_baz". Delimiters leading or
+ * trailing the name are kept as well. A name is only read as snake_case if a
+ * single delimiter follows a lower case letter, so "foo__bar" and "__init__"
+ * are left as they are, there's nothing to convert in them.
+ *
+ * A grammar is compiled into a transition table indexed by the state of the
+ * splitter and the next byte, so both conversion directions find the
+ * boundaries with one lookup per byte. Compiled grammars never change and
+ * may be shared across threads.
+ */
+
+#define CC_GRAMMAR_DEFAULT "aA 0A *A AAa delims=_ sigils=$@"
+
+typedef enum {
+  CC_CLASS_OTHER = 0,
+  CC_CLASS_LOWER,
+  CC_CLASS_UPPER,
+  CC_CLASS_DIGIT,
+  CC_CLASS_DELIM,
+  CC_CLASS_SIGIL,   /* leading the name, anything else otherwise */
+  CC_CLASS_COUNT
+} cc_class_t;
+
+/* what a byte does to the word being read */
+typedef enum {
+  CC_STEP_JOIN = 0,   /* continues it */
+  CC_STEP_BREAK,      /* starts the next one */
+  CC_STEP_BREAK_BACK, /* the byte before it starts the next one */
+  CC_STEP_DELIM       /* ends it, and is no part of any word */
+} cc_step_t;
+
+/* the splitter is either between words or follows a character of one of the
+ * word classes, once or in a run of at least two */
+#define CC_GRAMMAR_START 0
+#define CC_GRAMMAR_STATE(cls, run) (1 + (cls) * 2 + ((run) ? 1 : 0))
+#define CC_GRAMMAR_STATES (CC_GRAMMAR_STATE(CC_CLASS_DIGIT, 1) + 1)
+
+typedef struct {
+  volatile gint refcount;
+
+  guint8  classes[256];
+  /* the next state << 2 | the step */
+  guint8  table[CC_GRAMMAR_STATES][256];
+} cc_grammar_t;
+
+#define CC_GRAMMAR_CLASS(g, c) ((g)->classes[(guchar)(c)])
+
+/**
+ * Compiles the grammar in "src", patterns it doesn't understand are left out
+ * with a warning.
+ *
+ * @return the grammar holding one reference, or NULL if "src" is NULL or empty
+ */
+cc_grammar_t*       cc_grammar_new(const gchar *src);
+/* a copy of "g" (the default one if NULL) where "delims" delimit words too,
+ * holding one reference */
+cc_grammar_t*       cc_grammar_with_delims(const cc_grammar_t *g, const gchar *delims);
+cc_grammar_t*       cc_grammar_ref(cc_grammar_t*);
+void                cc_grammar_unref(cc_grammar_t*);
+
+/* CC_GRAMMAR_DEFAULT, compiled once and never freed */
+const cc_grammar_t* cc_grammar_default();
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ *  caseconvert_map.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_map.h"
+#include "caseconvert_occur.h"
+#include "caseconvert_mem.h"
+#include "caseconvert_trace.h"
+#include <string.h>
+
+/* the nodes of the trie are numbered in 24 bits, the edges are keyed by
+ * the node they leave and their byte */
+#define CC_MAP_NODES_MAX  (1 << 24)
+#define EDGE_KEY(node, c) GUINT_TO_POINTER(((guint)(node) << 8) | (guchar)(c))
+
+typedef struct {
+  gint    fail;     /* the node of the longest proper suffix of its path */
+  gint    out;      /* the pair whose old name ends here, -1 if none */
+  gint    next;     /* the closest node down the fail links with one, -1 if none */
+  gint    depth;
+  gint    child;    /* the first of its children, -1 if none */
+  gint    sibling;  /* the next child of its parent */
+  guchar  c;        /* the byte leading here */
+} node_t;
+
+struct cc_map_t {
+  gboolean    whole_word;
+  GHashTable  *pairs;     /* old name => its pair's id + 1 */
+  GPtrArray   *from;      /* pair id => old name */
+  GPtrArray   *to;        /* pair id => new name */
+  GArray      *nodes;     /* node_t, the root first */
+  GHashTable  *edges;     /* EDGE_KEY() => child + 1 */
+  gint        root[256];  /* the root's children, the root itself where it has none */
+  gboolean    linked;     /* whether the fail links are up to date */
+};
+
+/* a name found, at "pos" in the text */
+typedef struct {
+  gint  pos;
+  gint  len;
+  gint  pair;
+} match_t;
+
+#define NODE(map, n) (&g_array_index((map)->nodes, node_t, (n)))
+
+cc_map_t* cc_map_new(gboolean whole_word)
+{
+  cc_map_t  *map = cc_malloc0(CC_MEM_CONVERTER, sizeof(cc_map_t));
+  node_t    root;
+
+  map->whole_word = whole_word;
+  map->pairs = g_hash_table_new(g_str_hash, g_str_equal);
+  map->from = g_ptr_array_new();
+  map->to = g_ptr_array_new();
+  map->nodes = g_array_new(FALSE, FALSE, sizeof(node_t));
+  map->edges = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  memset(&root, 0, sizeof(root));
+  root.out = root.next = root.child = root.sibling = -1;
+  g_array_append_val(map->nodes, root);
+
+  return map;
+}
+
+void cc_map_free(cc_map_t *map)
+{
+  guint i;
+
+  if (!map)
+    return;
+
+  for (i = 0; i < map->from->len; ++i) {
+    cc_free(g_ptr_array_index(map->from, i));
+    cc_free(g_ptr_array_index(map->to, i));
+  }
+
+  g_hash_table_destroy(map->pairs);
+  g_ptr_array_free(map->from, TRUE);
+  g_ptr_array_free(map->to, TRUE);
+  g_array_free(map->nodes, TRUE);
+  g_hash_table_destroy(map->edges);
+  cc_free(map);
+}
+
+/* the child of a node by a byte, -1 if it has none */
+static gint edge(const cc_map_t *map, gint node, guchar c)
+{
+  if (!node)
+    return map->root[c] ? map->root[c] : -1;
+
+  return GPOINTER_TO_INT(g_hash_table_lookup(map->edges, EDGE_KEY(node, c))) - 1;
+}
+
+void cc_map_add(cc_map_t *map, const gchar *from, const gchar *to)
+{
+  node_t  child;
+  gint    pair = GPOINTER_TO_INT(g_hash_table_lookup(map->pairs, from)) - 1;
+  gint    node = 0, next;
+
+  if (!*from)
+    return;
+
+  if (pair >= 0) {
+    cc_free(g_ptr_array_index(map->to, pair));
+    g_ptr_array_index(map->to, pair) = cc_strdup(CC_MEM_CONVERTER, to);
+    return;
+  }
+
+  if (map->nodes->len + strlen(from) > CC_MAP_NODES_MAX) {
+    cc_warn("WARN: the name map is full, '%s' is left out\n", from);
+    return;
+  }
+
+  pair = map->from->len;
+  g_ptr_array_add(map->from, cc_strdup(CC_MEM_CONVERTER, from));
+  g_ptr_array_add(map->to, cc_strdup(CC_MEM_CONVERTER, to));
+  g_hash_table_insert(map->pairs, g_ptr_array_index(map->from, pair), GINT_TO_POINTER(pair + 1));
+
+  /* its path in the trie */
+  for (; *from; ++from, node = next) {
+    if ((next = edge(map, node, *from)) >= 0)
+      continue;
+
+    next = map->nodes->len;
+
+    memset(&child, 0, sizeof(child));
+    child.out = child.next = child.child = -1;
+    child.depth = NODE(map, node)->depth + 1;
+    child.sibling = NODE(map, node)->child;
+    child.c = *from;
+    g_array_append_val(map->nodes, child);
+
+    NODE(map, node)->child = next;
+
+    if (node)
+      g_hash_table_insert(map->edges, EDGE_KEY(node, *from), GINT_TO_POINTER(next + 1));
+    else
+      map->root[(guchar)*from] = next;
+  }
+
+  NODE(map, node)->out = pair;
+  map->linked = FALSE;
+}
+
+/* where reading "c" from a node leads, following the fail links until a
+ * node has a child by it; the root takes any byte */
+static gint step(const cc_map_t *map, gint node, guchar c)
+{
+  gint next = -1;
+
+  while (node && (next = edge(map, node, c)) < 0)
+    node = NODE(map, node)->fail;
+
+  return node ? next : map->root[c];
+}
+
+/* links every node to its longest proper suffix in the trie, breadth first
+ * so the suffix is always linked before */
+static void link_nodes(cc_map_t *map)
+{
+  GArray  *queue = g_array_new(FALSE, FALSE, sizeof(gint));
+  node_t  *node = NULL, *child = NULL, *fail = NULL;
+  guint   head;
+  gint    n = 0, c;
+
+  g_array_append_val(queue, n);
+
+  for (head = 0; head < queue->len; ++head) {
+    n = g_array_index(queue, gint, head);
+
+    for (c = NODE(map, n)->child; c >= 0; c = NODE(map, c)->sibling) {
+      node = NODE(map, n);
+      child = NODE(map, c);
+
+      child->fail = n ? step(map, node->fail, child->c) : 0;
+
+      fail = NODE(map, child->fail);
+      child->next = fail->out >= 0 ? child->fail : fail->next;
+
+      g_array_append_val(queue, c);
+    }
+  }
+
+  g_array_free(queue, TRUE);
+  map->linked = TRUE;
+}
+
+gint cc_map_size(const cc_map_t *map)
+{
+  return map->from->len;
+}
+
+gint cc_map_load(cc_map_t *map, const gchar *path, gchar **problem)
+{
+  GError    *error = NULL;
+  GPtrArray *pairs = g_ptr_array_new();
+  gchar     *text = NULL, **lines = NULL, **fields = NULL, *line = NULL;
+  gint      i, j, nr_fields, nr_pairs = 0;
+
+  *problem = NULL;
+
+  if (!g_file_get_contents(path, &text, NULL, &error)) {
+    *problem = g_strdup(error->message);
+    g_error_free(error);
+    g_ptr_array_free(pairs, TRUE);
+    return -1;
+  }
+
+  lines = g_strsplit(text, "\n", -1);
+  g_free(text);
+
+  /* every line is checked before any pair is added */
+  for (i = 0; lines[i] && !*problem; ++i) {
+    line = g_strstrip(lines[i]);
+
+    if (!*line || *line == '#')
+      continue;
+
+    fields = g_strsplit_set(line, " \t,=", -1);
+
+    for (j = 0, nr_fields = 0; fields[j]; ++j)
+      if (*fields[j])
+        fields[nr_fields++] = fields[j];
+      else
+        g_free(fields[j]);
+
+    fields[nr_fields] = NULL;
+
+    if (nr_fields == 2)
+      g_ptr_array_add(pairs, fields);
+    else {
+      *problem = g_strdup_printf("line %d isn't a pair of names", i + 1);
+      g_strfreev(fields);
+    }
+  }
+
+  for (i = 0; i < (gint)pairs->len; ++i) {
+    fields = g_ptr_array_index(pairs, i);
+
+    if (!*problem) {
+      cc_map_add(map, fields[0], fields[1]);
+      ++nr_pairs;
+    }
+
+    g_strfreev(fields);
+  }
+
+  g_ptr_array_free(pairs, TRUE);
+  g_strfreev(lines);
+
+  return *problem ? -1 : nr_pairs;
+}
+
+static gint compare_matches(gconstpointer a, gconstpointer b)
+{
+  const match_t *ma = a, *mb = b;
+
+  if (ma->pos != mb->pos)
+    return ma->pos < mb->pos ? -1 : 1;
+
+  return mb->len - ma->len;
+}
+
+/* the names of the map in the text, ascending and not overlapping */
+static GArray* find_names(cc_map_t *map, const gchar *text, gsize textsz)
+{
+  GArray  *found = g_array_new(FALSE, FALSE, sizeof(match_t));
+  match_t match, *kept = NULL;
+  gsize   i;
+  guint   j, nr_kept = 0;
+  gint    state = 0, n;
+
+  if (!map->linked)
+    link_nodes(map);
+
+  for (i = 0; i < textsz; ++i) {
+    state = step(map, state, text[i]);
+
+    /* every name ending here that counts */
+    for (n = NODE(map, state)->out >= 0 ? state : NODE(map, state)->next; n > 0; n = NODE(map, n)->next) {
+      match.len = NODE(map, n)->depth;
+      match.pos = i + 1 - match.len;
+      match.pair = NODE(map, n)->out;
+
+      if (map->whole_word &&
+          ((match.pos > 0 && CC_OCCUR_IS_WORD_CHAR(text[match.pos - 1])) ||
+           (i + 1 < textsz && CC_OCCUR_IS_WORD_CHAR(text[i + 1]))))
+        continue;
+
+      g_array_append_val(found, match);
+    }
+  }
+
+  /* those starting first win, then the longest */
+  g_array_sort(found, compare_matches);
+
+  for (j = 0; j < found->len; ++j) {
+    match = g_array_index(found, match_t, j);
+
+    if (kept && match.pos < kept->pos + kept->len)
+      continue;
+
+    g_array_index(found, match_t, nr_kept) = match;
+    kept = &g_array_index(found, match_t, nr_kept++);
+  }
+
+  g_array_set_size(found, nr_kept);
+
+  return found;
+}
+
+/* the id of a text in the plan, adding a copy of it the first time */
+static gint plan_text(cc_plan_t *plan, gint *ids, gint id, const gchar *text)
+{
+  if (ids[id] == -1)
+    ids[id] = cc_plan_add_text(plan, cc_strdup(CC_MEM_CONVERTER, text));
+
+  return ids[id];
+}
+
+cc_plan_t* cc_map_plan(cc_map_t *map, const gchar *text, gsize textsz, gint base,
+                       gboolean fallback, gint *nr_mapped)
+{
+  cc_plan_t       *plan = cc_plan_new(), *names = NULL;
+  cc_plan_edit_t  *edit = NULL;
+  GArray          *found = find_names(map, text, textsz);
+  match_t         *match = NULL;
+  gint            *pair_ids = NULL, *name_ids = NULL, end;
+  guint           i, j = 0, nr_names = 0;
+
+  pair_ids = cc_malloc(CC_MEM_CONVERTER, sizeof(gint) * MAX(map->from->len, 1));
+  memset(pair_ids, -1, sizeof(gint) * MAX(map->from->len, 1));
+
+  if (fallback) {
+    names = cc_plan_names(text, textsz, base, CC_PLAN_THREADS);
+    nr_names = names->edits->len;
+
+    name_ids = cc_malloc(CC_MEM_CONVERTER, sizeof(gint) * MAX(names->texts->len, 1));
+    memset(name_ids, -1, sizeof(gint) * MAX(names->texts->len, 1));
+  }
+
+  plan->nr_names = found->len;
+  *nr_mapped = 0;
+
+  for (i = 0; i <= found->len; ++i) {
+    match = i < found->len ? &g_array_index(found, match_t, i) : NULL;
+    end = match ? match->pos : G_MAXINT;
+
+    /* the names converted by the rules before it, and those it overlaps */
+    for (; j < nr_names; ++j) {
+      edit = &g_array_index(names->edits, cc_plan_edit_t, j);
+
+      if (edit->pos - base + edit->len <= end)
+        cc_plan_add_edit(plan, edit->pos, edit->len,
+          plan_text(plan, name_ids, edit->text, g_ptr_array_index(names->texts, edit->text)));
+      else if (!match || edit->pos - base >= match->pos + match->len)
+        break;
+    }
+
+    if (!match)
+      break;
+
+    /* those mapped to themselves are found all the same */
+    if (strcmp(g_ptr_array_index(map->to, match->pair), g_ptr_array_index(map->from, match->pair)) == 0) {
+      pair_ids[match->pair] = -2;
+      continue;
+    }
+
+    cc_plan_add_edit(plan, base + match->pos, match->len,
+      plan_text(plan, pair_ids, match->pair, g_ptr_array_index(map->to, match->pair)));
+    ++*nr_mapped;
+  }
+
+  /* the distinct names mapped */
+  for (i = 0; i < map->from->len; ++i)
+    if (pair_ids[i] != -1)
+      ++plan->nr_distinct;
+
+  if (names) {
+    plan->nr_names = names->nr_names;
+    plan->nr_distinct = names->nr_distinct;
+  }
+
+  cc_free(pair_ids);
+  cc_free(name_ids);
+  cc_plan_free(names);
+  g_array_free(found, TRUE);
+
+  return plan;
+}
@@ -0,0 +1,77 @@
+/*
+ *  caseconvert_map.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_MAP_H
+#define H_GEANY_CASE_CONVERT_MAP_H
+
+#include "caseconvert_plan.h"
+
+/*
+ * Name maps: explicit old => new pairs, as migrations generated by other
+ * tools come with, applied to a text in a single pass however many pairs
+ * there are.
+ *
+ * The old names are laid out in an Aho-Corasick automaton: a trie of them,
+ * where every node also links to the longest suffix of its path that's in
+ * the trie too, so the text is read once and every name is found as it
+ * ends. Where names found overlap, the one starting first wins, then the
+ * longest; in whole word mode, a name only counts if no identifier
+ * character (see CC_OCCUR_IS_WORD_CHAR) is next to it.
+ *
+ * Map files hold a pair per line, the names separated by blanks, a ',' or
+ * a '=', and may have '#' comments and empty lines:
+ *
+ *  # from the 2.0 migration
+ *  getFooBar   get_foo_bar
+ *  FOO_MAX=FooMax
+ *
+ * Doesn't call into Geany.
+ */
+
+typedef struct cc_map_t cc_map_t;
+
+cc_map_t*   cc_map_new(gboolean whole_word);
+void        cc_map_free(cc_map_t *map);
+
+/* adds a pair, or replaces what an old name maps to */
+void        cc_map_add(cc_map_t *map, const gchar *from, const gchar *to);
+
+/**
+ * Adds the pairs of a map file, or none at all if it has a line that isn't
+ * one; "problem" then says which, free it with g_free().
+ *
+ * @return the number of pairs read, or -1
+ */
+gint        cc_map_load(cc_map_t *map, const gchar *path, gchar **problem);
+
+/* the number of pairs */
+gint        cc_map_size(const cc_map_t *map);
+
+/**
+ * Plans replacing the old names found in "text" with their new ones; with
+ * "fallback", the names not in the map are converted by the rules instead,
+ * as cc_plan_names() would. The edits' positions are offset by "base".
+ *
+ * The plan's nr_names counts the names found, nr_distinct the distinct
+ * ones; "nr_mapped" gets how many of its edits come from the map.
+ */
+cc_plan_t*  cc_map_plan(cc_map_t *map, const gchar *text, gsize textsz, gint base,
+                        gboolean fallback, gint *nr_mapped);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ *  caseconvert_mem.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_mem.h"
+#include "caseconvert_trace.h"
+#include <glib/gprintf.h>
+#include <string.h>
+
+/* every block is prefixed with a header recording its size and owner, the
+ * header is 16 bytes so the returned pointer keeps malloc's alignment */
+typedef struct {
+  gsize   size;
+  guint32 subsys;
+  guint32 magic;
+} mem_hdr_t;
+
+#define CC_MEM_MAGIC 0xCCA110C8
+
+/* counters are updated atomically, conversions may run off the main thread */
+static cc_mem_stats_t stats[CC_MEM_COUNT];
+
+/* and every thread counts what it allocates itself, which is what budgets
+ * look at: the process wide counters move with whatever other threads do */
+static GPrivate thread_stats = G_PRIVATE_INIT(g_free);
+
+static const gchar *subsys_names[CC_MEM_COUNT] = {
+  "converter",
+  "rules",
+  "settings",
+  "ui",
+  "index",
+  "scan"
+};
+
+/* the counters of the calling thread, the first allocation of a thread
+ * allocates them (from GLib, they can't account for themselves) */
+static cc_mem_stats_t* get_thread_stats()
+{
+  cc_mem_stats_t *t = g_private_get(&thread_stats);
+
+  if (!t) {
+    t = g_new0(cc_mem_stats_t, CC_MEM_COUNT);
+    g_private_set(&thread_stats, t);
+  }
+
+  return t;
+}
+
+static void charge(cc_mem_subsys_t subsys, gsize sz)
+{
+  cc_mem_stats_t *s = &stats[subsys];
+  cc_mem_stats_t *t = &get_thread_stats()[subsys];
+
+  g_atomic_int_inc((gint*)&s->nr_allocs);
+  g_atomic_int_add((gint*)&s->bytes, (gint)sz);
+  g_atomic_int_inc(&s->live);
+  g_atomic_int_add(&s->live_bytes, (gint)sz);
+
+  ++t->nr_allocs;
+  t->bytes += sz;
+  ++t->live;
+  t->live_bytes += sz;
+}
+
+/* a block freed by another thread than the one that allocated it is taken
+ * off the counters of the thread freeing it */
+static void credit(cc_mem_subsys_t subsys, gsize sz)
+{
+  cc_mem_stats_t *s = &stats[subsys];
+  cc_mem_stats_t *t = &get_thread_stats()[subsys];
+
+  g_atomic_int_inc((gint*)&s->nr_frees);
+  g_atomic_int_add(&s->live, -1);
+  g_atomic_int_add(&s->live_bytes, -(gint)sz);
+
+  ++t->nr_frees;
+  --t->live;
+  t->live_bytes -= sz;
+}
+
+gpointer cc_malloc(cc_mem_subsys_t subsys, gsize sz)
+{
+  mem_hdr_t *hdr = g_malloc(sizeof(mem_hdr_t) + sz);
+
+  hdr->size = sz;
+  hdr->subsys = subsys;
+  hdr->magic = CC_MEM_MAGIC;
+  charge(subsys, sz);
+
+  return hdr + 1;
+}
+
+gpointer cc_malloc0(cc_mem_subsys_t subsys, gsize sz)
+{
+  gpointer p = cc_malloc(subsys, sz);
+  memset(p, 0, sz);
+
+  return p;
+}
+
+gpointer cc_realloc(cc_mem_subsys_t subsys, gpointer p, gsize sz)
+{
+  mem_hdr_t *hdr = NULL;
+
+  if (!p)
+    return cc_malloc(subsys, sz);
+
+  hdr = (mem_hdr_t*)p - 1;
+  g_return_val_if_fail(hdr->magic == CC_MEM_MAGIC, NULL);
+
+  /* a resize counts as a new allocation, that's what the budgets care about */
+  credit(hdr->subsys, hdr->size);
+  hdr = g_realloc(hdr, sizeof(mem_hdr_t) + sz);
+  hdr->size = sz;
+  hdr->subsys = subsys;
+  charge(subsys, sz);
+
+  return hdr + 1;
+}
+
+gchar* cc_strdup(cc_mem_subsys_t subsys, const gchar *str)
+{
+  if (!str)
+    return NULL;
+
+  return cc_strndup(subsys, str, strlen(str));
+}
+
+gchar* cc_strndup(cc_mem_subsys_t subsys, const gchar *str, gsize sz)
+{
+  gchar *out = NULL;
+
+  if (!str)
+    return NULL;
+
+  out = cc_malloc(subsys, sz + 1);
+  strncpy(out, str, sz);
+  out[sz] = '\0';
+
+  return out;
+}
+
+void cc_free(gpointer p)
+{
+  mem_hdr_t *hdr = NULL;
+
+  if (!p)
+    return;
+
+  hdr = (mem_hdr_t*)p - 1;
+  if (hdr->magic != CC_MEM_MAGIC) {
+    cc_warn("WARN: cc_free() on a block not allocated by cc_malloc() (%p)\n", p);
+    return;
+  }
+
+  hdr->magic = 0;
+  credit(hdr->subsys, hdr->size);
+  g_free(hdr);
+}
+
+void cc_mem_get_stats(cc_mem_subsys_t subsys, cc_mem_stats_t *out)
+{
+  cc_mem_stats_t *s = &stats[subsys];
+
+  out->nr_allocs  = (guint)g_atomic_int_get((gint*)&s->nr_allocs);
+  out->nr_frees   = (guint)g_atomic_int_get((gint*)&s->nr_frees);
+  out->bytes      = (guint)g_atomic_int_get((gint*)&s->bytes);
+  out->live       = g_atomic_int_get(&s->live);
+  out->live_bytes = g_atomic_int_get(&s->live_bytes);
+}
+
+void cc_mem_get_thread_stats(cc_mem_subsys_t subsys, cc_mem_stats_t *out)
+{
+  *out = get_thread_stats()[subsys];
+}
+
+gboolean cc_mem_within_budget(cc_mem_subsys_t subsys, const cc_mem_stats_t *snap,
+                              guint max_allocs, gint max_live_growth)
+{
+  cc_mem_stats_t now;
+  cc_mem_get_thread_stats(subsys, &now);
+
+  if (now.nr_allocs - snap->nr_allocs > max_allocs
+  ||  now.live - snap->live > max_live_growth)
+  {
+    cc_warn("WARN: %s over budget: %u allocations (max %u), %d new live blocks (max %d)\n",
+      subsys_names[subsys],
+      now.nr_allocs - snap->nr_allocs, max_allocs,
+      now.live - snap->live, max_live_growth);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+void cc_mem_dump(FILE *out)
+{
+  gint i;
+
+  g_fprintf(out, "# caseconvert memory: %-10s %10s %10s %12s %8s %12s\n",
+    "subsystem", "allocs", "frees", "bytes", "live", "live bytes");
+
+  for (i = 0; i < CC_MEM_COUNT; ++i) {
+    cc_mem_stats_t s;
+    cc_mem_get_stats(i, &s);
+
+    g_fprintf(out, "# caseconvert memory: %-10s %10u %10u %12u %8d %12d\n",
+      subsys_names[i], s.nr_allocs, s.nr_frees, s.bytes, s.live, s.live_bytes);
+  }
+}
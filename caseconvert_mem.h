@@ -0,0 +1,94 @@
+/*
+ *  caseconvert_mem.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_MEM_H
+#define H_GEANY_CASE_CONVERT_MEM_H
+
+#include <glib.h>
+#include <stdio.h>
+
+/*
+ * Accounted allocations.
+ *
+ * Every block allocated by the plugin goes through cc_malloc() and friends
+ * and is charged to the subsystem that owns it, so leaks and allocation
+ * churn can be attributed. Blocks must be released with cc_free(), which
+ * credits the subsystem that allocated them; never mix these with g_free().
+ *
+ * Memory owned by GLib/GTK/Geany (ie, strings returned by the key file API)
+ * is not accounted and is still released with g_free().
+ */
+typedef enum {
+  CC_MEM_CONVERTER = 0, /* conversion buffers and results */
+  CC_MEM_RULES,         /* rule objects, their conditions and actions */
+  CC_MEM_SETTINGS,      /* settings parsing and serialization */
+  CC_MEM_UI,            /* dialogs and their state */
+  CC_MEM_INDEX,         /* the documents' occurrence indexes */
+  CC_MEM_SCAN,          /* project scans and what they found */
+  CC_MEM_COUNT
+} cc_mem_subsys_t;
+
+typedef struct {
+  guint nr_allocs;  /* number of allocations, ever */
+  guint nr_frees;   /* number of releases, ever */
+  guint bytes;      /* number of bytes allocated, ever (wraps) */
+  gint  live;       /* number of blocks currently allocated */
+  gint  live_bytes; /* size of the blocks currently allocated */
+} cc_mem_stats_t;
+
+gpointer  cc_malloc(cc_mem_subsys_t, gsize);
+gpointer  cc_malloc0(cc_mem_subsys_t, gsize);
+gpointer  cc_realloc(cc_mem_subsys_t, gpointer, gsize);
+gchar*    cc_strdup(cc_mem_subsys_t, const gchar*);
+gchar*    cc_strndup(cc_mem_subsys_t, const gchar*, gsize);
+void      cc_free(gpointer);
+
+/* copies the current counters of a subsystem */
+void      cc_mem_get_stats(cc_mem_subsys_t, cc_mem_stats_t*);
+
+/* the same, counting only what the calling thread allocated and freed */
+void      cc_mem_get_thread_stats(cc_mem_subsys_t, cc_mem_stats_t*);
+
+/* formats the counters of every subsystem into the given stream */
+void      cc_mem_dump(FILE *out);
+
+/*
+ * Budgets: take a snapshot of the calling thread before an operation and
+ * verify how much it allocated afterwards, ie:
+ *
+ *  cc_mem_stats_t snap;
+ *  cc_mem_get_thread_stats(CC_MEM_CONVERTER, &snap);
+ *  ...
+ *  CC_MEM_BUDGET(CC_MEM_CONVERTER, &snap, 1, 1);
+ *
+ * asserts the operation made at most 1 allocation and left at most 1 more
+ * block alive than before, whatever other threads did meanwhile. The checks
+ * are only compiled with -DCC_MEM_BUDGETS.
+ */
+gboolean  cc_mem_within_budget(cc_mem_subsys_t, const cc_mem_stats_t *snap,
+                               guint max_allocs, gint max_live_growth);
+
+#ifdef CC_MEM_BUDGETS
+# define CC_MEM_BUDGET(subsys, snap, max_allocs, max_live_growth) \
+  g_warn_if_fail(cc_mem_within_budget((subsys), (snap), (max_allocs), (max_live_growth)))
+#else
+# define CC_MEM_BUDGET(subsys, snap, max_allocs, max_live_growth) do {} while (0)
+#endif
+
+#endif
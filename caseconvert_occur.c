@@ -0,0 +1,289 @@
+/*
+ *  caseconvert_occur.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_occur.h"
+#include "caseconvert_mem.h"
+#include <string.h>
+
+/* a position as a single key, the line's handle in the upper half */
+#define KEY(handle, col) (((gint64)(handle) << 32) | (guint32)(col))
+#define KEY_HANDLE(key) ((gint)((key) >> 32))
+#define KEY_COL(key) ((gint)((key) & 0xFFFFFFFF))
+
+struct cc_occur_t {
+  GHashTable  *names;     /* lower cased identifier => GArray of keys, ascending */
+  GArray      *handles;   /* line => its handle */
+  GArray      *lines;     /* handle => its line, -1 if unused */
+  GArray      *unused;    /* handles to reuse */
+  gint        size;
+  GString     *key;       /* scratch, the identifier being looked up */
+};
+
+#define HANDLE(index, line) g_array_index((index)->handles, gint, (line))
+#define LINE(index, handle) g_array_index((index)->lines, gint, (handle))
+
+static void free_keys(gpointer data)
+{
+  g_array_free(data, TRUE);
+}
+
+cc_occur_t* cc_occur_new(void)
+{
+  cc_occur_t *index = cc_malloc0(CC_MEM_INDEX, sizeof(cc_occur_t));
+
+  index->names = g_hash_table_new_full(g_str_hash, g_str_equal, cc_free, free_keys);
+  index->handles = g_array_new(FALSE, FALSE, sizeof(gint));
+  index->lines = g_array_new(FALSE, FALSE, sizeof(gint));
+  index->unused = g_array_new(FALSE, FALSE, sizeof(gint));
+  index->key = g_string_sized_new(64);
+
+  return index;
+}
+
+void cc_occur_free(cc_occur_t *index)
+{
+  if (!index)
+    return;
+
+  g_hash_table_destroy(index->names);
+  g_array_free(index->handles, TRUE);
+  g_array_free(index->lines, TRUE);
+  g_array_free(index->unused, TRUE);
+  g_string_free(index->key, TRUE);
+  cc_free(index);
+}
+
+static gint new_handle(cc_occur_t *index, gint line)
+{
+  gint handle = index->lines->len;
+
+  if (index->unused->len) {
+    handle = g_array_index(index->unused, gint, index->unused->len - 1);
+    g_array_set_size(index->unused, index->unused->len - 1);
+  }
+  else
+    g_array_set_size(index->lines, handle + 1);
+
+  LINE(index, handle) = line;
+
+  return handle;
+}
+
+/* the handle of a line, the lines up to it get one if they have none yet */
+static gint line_handle(cc_occur_t *index, gint line)
+{
+  gint handle;
+
+  while ((gint)index->handles->len <= line) {
+    handle = new_handle(index, index->handles->len);
+    g_array_append_val(index->handles, handle);
+  }
+
+  return HANDLE(index, line);
+}
+
+/* the lines from "from" on moved, tells their handles */
+static void renumber(cc_occur_t *index, guint from)
+{
+  for (; from < index->handles->len; ++from)
+    LINE(index, HANDLE(index, from)) = from;
+}
+
+void cc_occur_shift(cc_occur_t *index, gint line, gint delta)
+{
+  gint  handle, i;
+  guint from;
+
+  if (delta > 0 && line <= (gint)index->handles->len) {
+    for (i = 0; i < delta; ++i) {
+      handle = new_handle(index, line + i);
+      g_array_insert_val(index->handles, line + i, handle);
+    }
+
+    renumber(index, line + delta);
+  }
+  else if (delta < 0 && line + delta < (gint)index->handles->len) {
+    /* the lines removed were emptied ahead of the edit */
+    from = line + delta;
+    line = MIN(line, (gint)index->handles->len);
+
+    for (i = from; i < line; ++i) {
+      LINE(index, HANDLE(index, i)) = -1;
+      g_array_append_val(index->unused, HANDLE(index, i));
+    }
+
+    g_array_remove_range(index->handles, from, line - from);
+    renumber(index, from);
+  }
+}
+
+/* the first key not before "key" */
+static guint lower_bound(GArray *keys, gint64 key)
+{
+  guint lo = 0, hi = keys->len, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+
+    if (g_array_index(keys, gint64, mid) < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* adds or removes every identifier of the text */
+static void scan(cc_occur_t *index, const gchar *text, gsize textsz, gint line, gboolean add)
+{
+  GArray  *keys = NULL;
+  gsize   begin = 0, end, bol = 0, i;
+  gint64  key;
+  guint   at;
+
+  while (begin < textsz)
+  {
+    /* the next identifier, counting the lines up to it; a lone '\r' ends
+     * a line too */
+    for (; begin < textsz && !CC_OCCUR_IS_WORD_CHAR(text[begin]); ++begin) {
+      if (text[begin] == '\n' || (text[begin] == '\r' && (begin + 1 == textsz || text[begin+1] != '\n'))) {
+        ++line;
+        bol = begin + 1;
+      }
+    }
+
+    for (end = begin; end < textsz && CC_OCCUR_IS_WORD_CHAR(text[end]); ++end);
+
+    if (begin == end)
+      break;
+
+    g_string_truncate(index->key, 0);
+    for (i = begin; i < end; ++i)
+      g_string_append_c(index->key, g_ascii_tolower(text[i]));
+
+    key = KEY(line_handle(index, line), begin - bol);
+    keys = g_hash_table_lookup(index->names, index->key->str);
+    begin = end;
+
+    if (add) {
+      if (!keys) {
+        keys = g_array_new(FALSE, FALSE, sizeof(gint64));
+        g_hash_table_insert(index->names, cc_strndup(CC_MEM_INDEX, index->key->str, index->key->len), keys);
+      }
+
+      at = lower_bound(keys, key);
+      if (at == keys->len || g_array_index(keys, gint64, at) != key) {
+        g_array_insert_val(keys, at, key);
+        ++index->size;
+      }
+    }
+    else if (keys) {
+      at = lower_bound(keys, key);
+      if (at < keys->len && g_array_index(keys, gint64, at) == key) {
+        g_array_remove_index(keys, at);
+        --index->size;
+      }
+
+      if (!keys->len)
+        g_hash_table_remove(index->names, index->key->str);
+    }
+  }
+}
+
+void cc_occur_add_text(cc_occur_t *index, const gchar *text, gsize textsz, gint line)
+{
+  scan(index, text, textsz, line, TRUE);
+}
+
+void cc_occur_remove_text(cc_occur_t *index, const gchar *text, gsize textsz, gint line)
+{
+  scan(index, text, textsz, line, FALSE);
+}
+
+/* appends the positions of an identifier, "by" columns in */
+static void append_keys(cc_occur_t *index, GArray *out, GArray *keys, gint by)
+{
+  cc_occur_pos_t  pos;
+  gint64          key;
+  guint           i;
+
+  for (i = 0; i < keys->len; ++i) {
+    key = g_array_index(keys, gint64, i);
+    pos.line = LINE(index, KEY_HANDLE(key));
+    pos.col = KEY_COL(key) + by;
+    g_array_append_val(out, pos);
+  }
+}
+
+static gint compare_pos(gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data)
+{
+  const cc_occur_pos_t *pa = a, *pb = b;
+
+  if (pa->line != pb->line)
+    return pa->line < pb->line ? -1 : 1;
+
+  return pa->col - pb->col;
+}
+
+gboolean cc_occur_find(cc_occur_t *index, const gchar *txt, gsize txtsz,
+                       gboolean whole, gboolean match_case, GArray *out)
+{
+  GHashTableIter  iter;
+  gpointer        key, keys;
+  gchar           *needle = NULL;
+  const gchar     *hit = NULL;
+  guint           first = out->len;
+  gsize           i;
+
+  if (!txtsz)
+    return FALSE;
+
+  for (i = 0; i < txtsz; ++i)
+    if (!CC_OCCUR_IS_WORD_CHAR(txt[i]) || (!match_case && (guchar)txt[i] >= 0x80))
+      return FALSE;
+
+  needle = g_ascii_strdown(txt, txtsz);
+
+  if (whole) {
+    if ((keys = g_hash_table_lookup(index->names, needle)) != NULL)
+      append_keys(index, out, keys, 0);
+  }
+  else {
+    /* every identifier holding it, as many times as it does */
+    g_hash_table_iter_init(&iter, index->names);
+
+    while (g_hash_table_iter_next(&iter, &key, &keys))
+      for (hit = strstr(key, needle); hit; hit = strstr(hit + txtsz, needle))
+        append_keys(index, out, keys, (gint)(hit - (gchar*)key));
+  }
+
+  g_free(needle);
+
+  /* the lines' handles aren't in the lines' order */
+  g_qsort_with_data(out->data + first * sizeof(cc_occur_pos_t), out->len - first,
+    sizeof(cc_occur_pos_t), compare_pos, NULL);
+
+  return TRUE;
+}
+
+gint cc_occur_size(const cc_occur_t *index)
+{
+  return index->size;
+}
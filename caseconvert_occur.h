@@ -0,0 +1,89 @@
+/*
+ *  caseconvert_occur.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_OCCUR_H
+#define H_GEANY_CASE_CONVERT_OCCUR_H
+
+#include <glib.h>
+
+/*
+ * Where every identifier of a document occurs.
+ *
+ * An identifier is a run of letters, digits, '_' and non-ASCII bytes, it's
+ * indexed case insensitively (ASCII only) by the lines and columns (in
+ * bytes) it starts at. Any text made only of those characters occurs within
+ * identifiers, so its occurrences are found by looking at the identifiers
+ * containing it rather than at the document; what's found are candidates,
+ * which the caller checks against its own notion of case and word
+ * boundaries.
+ *
+ * The index follows edits a line at a time. Ahead of an edit, the lines it
+ * touches are removed as they read then; after it, the lines past them are
+ * renumbered and the same lines added back as they read now. Say lines
+ * [first, first + before] become [first, first + after]:
+ *
+ *  cc_occur_remove_text(index, old_lines, old_linessz, first);
+ *  ... the edit ...
+ *  cc_occur_shift(index, first + before + 1, after - before);
+ *  cc_occur_add_text(index, new_lines, new_linessz, first);
+ *
+ * Identifiers are kept by a handle of their line, which doesn't change as
+ * lines are added or removed before it: an edit within a line, as most
+ * are, moves nothing but that line, and one adding or removing lines only
+ * renumbers the lines past it, never the identifiers.
+ */
+
+typedef struct cc_occur_t cc_occur_t;
+
+typedef struct {
+  gint  line;
+  gint  col;
+} cc_occur_pos_t;
+
+#define CC_OCCUR_IS_WORD_CHAR(c) \
+  (g_ascii_isalnum(c) || (c) == '_' || (guchar)(c) >= 0x80)
+
+cc_occur_t* cc_occur_new(void);
+void        cc_occur_free(cc_occur_t *index);
+
+/* indexes, or removes, the identifiers of "text", whole lines starting at
+ * line "line" */
+void        cc_occur_add_text(cc_occur_t *index, const gchar *text, gsize textsz, gint line);
+void        cc_occur_remove_text(cc_occur_t *index, const gchar *text, gsize textsz, gint line);
+
+/* renumbers the lines from "line" on by "delta" */
+void        cc_occur_shift(cc_occur_t *index, gint line, gint delta);
+
+/**
+ * Finds where "txt" may occur: as a whole identifier if "whole" is set,
+ * anywhere within identifiers otherwise. The positions are appended to
+ * "out" (a GArray of cc_occur_pos_t) in ascending order.
+ *
+ * @return FALSE if "txt" isn't made of identifier characters only, or has
+ * non-ASCII ones and the search ignores case ("match_case" unset): the
+ * index doesn't fold those, so "Über" would miss "über". Either way it
+ * can't be found through the index
+ */
+gboolean    cc_occur_find(cc_occur_t *index, const gchar *txt, gsize txtsz,
+                          gboolean whole, gboolean match_case, GArray *out);
+
+/* the number of identifier occurrences indexed */
+gint        cc_occur_size(const cc_occur_t *index);
+
+#endif
@@ -0,0 +1,534 @@
+/*
+ *  caseconvert_plan.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_plan.h"
+#include "caseconvert_engine.h"
+#include "caseconvert_occur.h"
+#include <string.h>
+
+#define CC_PLAN_BATCH 64 /* distinct names converted per turn */
+
+/* a name found in a chunk, "name" is its id in the chunk */
+typedef struct {
+  gint  pos;
+  gint  len;
+  gint  name;
+} span_t;
+
+typedef struct {
+  gsize       begin;
+  gsize       end;
+  GArray      *spans;     /* span_t, ascending */
+  GHashTable  *names;     /* the chunk's distinct names => their id + 1 */
+  GPtrArray   *distinct;  /* id => name */
+  gint        *ids;       /* id => the name's id in the merged set */
+} chunk_t;
+
+/* what the workers share, they take the chunks or batches in turn */
+typedef struct {
+  const gchar *text;
+  chunk_t     *chunks;
+  gint        nr_chunks;
+  gint        next;
+  GPtrArray   *names;     /* the merged set */
+  gchar       **repls;    /* their conversions, NULL if left alone */
+} job_t;
+
+cc_plan_t* cc_plan_new(void)
+{
+  cc_plan_t *plan = cc_malloc0(CC_MEM_CONVERTER, sizeof(cc_plan_t));
+
+  plan->edits = g_array_new(FALSE, FALSE, sizeof(cc_plan_edit_t));
+  plan->texts = g_ptr_array_new();
+
+  return plan;
+}
+
+void cc_plan_free(cc_plan_t *plan)
+{
+  guint i;
+
+  if (!plan)
+    return;
+
+  for (i = 0; i < plan->texts->len; ++i)
+    cc_free(g_ptr_array_index(plan->texts, i));
+
+  g_ptr_array_free(plan->texts, TRUE);
+  g_array_free(plan->edits, TRUE);
+  cc_free(plan);
+}
+
+gint cc_plan_add_text(cc_plan_t *plan, gchar *text)
+{
+  g_ptr_array_add(plan->texts, text);
+
+  return plan->texts->len - 1;
+}
+
+void cc_plan_add_edit(cc_plan_t *plan, gint pos, gint len, gint text)
+{
+  cc_plan_edit_t edit;
+
+  edit.pos = pos;
+  edit.len = len;
+  edit.text = text;
+  g_array_append_val(plan->edits, edit);
+
+  plan->removed += len;
+  plan->added += strlen(g_ptr_array_index(plan->texts, text));
+}
+
+#define EDIT(plan, i) (&g_array_index((plan)->edits, cc_plan_edit_t, (i)))
+#define TEXT_LEN(plan, edit) strlen(g_ptr_array_index((plan)->texts, (edit)->text))
+
+/* what a replacement of edits [first, last) adds to the undo history */
+static gsize span_undo(const cc_plan_t *plan, guint first, guint last)
+{
+  const cc_plan_edit_t  *a = EDIT(plan, first), *z = EDIT(plan, last - 1);
+  gint64                spansz = z->pos + z->len - a->pos, grown = 0;
+  guint                 i;
+
+  for (i = first; i < last; ++i)
+    grown += (gint64)TEXT_LEN(plan, EDIT(plan, i)) - EDIT(plan, i)->len;
+
+  /* what lies between the edits is removed and put back as it was */
+  return 2 * CC_PLAN_ACTION_COST + 2 * spansz + grown;
+}
+
+/* joining edits further apart than this costs more history than it saves */
+#define JOIN_GAP ((2 * CC_PLAN_ACTION_COST + CC_PLAN_CALL_COST) / 2)
+
+void cc_plan_estimate(const cc_plan_t *plan, const gint *lines,
+                      cc_plan_cost_t *cost, GArray *spans)
+{
+  const cc_plan_edit_t  *edit = NULL, *prev = NULL;
+  GArray                *joined = NULL;
+  cc_plan_span_t        span;
+  gsize                 best = 0, total;
+  guint                 nr = plan->edits->len, first = spans->len, i;
+  gint                  mode;
+
+  memset(cost, 0, sizeof(cc_plan_cost_t));
+
+  if (!nr)
+    return;
+
+  joined = g_array_new(FALSE, FALSE, sizeof(cc_plan_span_t));
+
+  /* each edit on its own */
+  cost->undo[CC_PLAN_EACH] = nr * 2 * CC_PLAN_ACTION_COST + plan->removed + plan->added;
+  cost->calls[CC_PLAN_EACH] = nr;
+
+  /* the edits on the same line, close enough and not too far from the
+   * first of them, together */
+  span.first = 0;
+
+  for (i = 1; i <= nr; ++i) {
+    prev = EDIT(plan, i - 1);
+    edit = i < nr ? EDIT(plan, i) : NULL;
+
+    if (edit && lines[i] == lines[i-1] && edit->pos - (prev->pos + prev->len) <= JOIN_GAP &&
+        edit->pos + edit->len - EDIT(plan, span.first)->pos <= CC_PLAN_SPAN_MAX)
+      continue;
+
+    span.pos = EDIT(plan, span.first)->pos;
+    span.len = prev->pos + prev->len - span.pos;
+    span.last = i;
+    g_array_append_val(joined, span);
+
+    cost->undo[CC_PLAN_CHUNKS] += span_undo(plan, span.first, span.last);
+    span.first = i;
+  }
+
+  cost->calls[CC_PLAN_CHUNKS] = joined->len;
+
+  /* the whole range at once, if it's on a single line and not too long */
+  if (lines[0] == lines[nr-1] &&
+      EDIT(plan, nr - 1)->pos + EDIT(plan, nr - 1)->len - EDIT(plan, 0)->pos <= CC_PLAN_SPAN_MAX) {
+    cost->undo[CC_PLAN_WHOLE] = span_undo(plan, 0, nr);
+    cost->calls[CC_PLAN_WHOLE] = 1;
+  }
+  else
+    cost->undo[CC_PLAN_WHOLE] = cost->calls[CC_PLAN_WHOLE] = CC_PLAN_INELIGIBLE;
+
+  cost->mode = CC_PLAN_EACH;
+
+  for (mode = CC_PLAN_EACH; mode < CC_PLAN_NR_MODES; ++mode) {
+    if (cost->undo[mode] == CC_PLAN_INELIGIBLE)
+      continue;
+
+    total = cost->undo[mode] + cost->calls[mode] * CC_PLAN_CALL_COST;
+
+    if (mode == CC_PLAN_EACH || total < best) {
+      cost->mode = mode;
+      best = total;
+    }
+  }
+
+  if (cost->mode == CC_PLAN_CHUNKS)
+    g_array_append_vals(spans, joined->data, joined->len);
+  else if (cost->mode == CC_PLAN_WHOLE) {
+    span.first = 0;
+    span.last = nr;
+    span.pos = EDIT(plan, 0)->pos;
+    span.len = EDIT(plan, nr - 1)->pos + EDIT(plan, nr - 1)->len - span.pos;
+    g_array_append_val(spans, span);
+  }
+  else {
+    for (i = 0; i < nr; ++i) {
+      span.first = i;
+      span.last = i + 1;
+      span.pos = EDIT(plan, i)->pos;
+      span.len = EDIT(plan, i)->len;
+      g_array_append_val(spans, span);
+    }
+  }
+
+  for (i = first; i < spans->len; ++i)
+    cost->peak = MAX(cost->peak, (gsize)g_array_index(spans, cc_plan_span_t, i).len);
+
+  g_array_free(joined, TRUE);
+}
+
+gchar* cc_plan_compose(const cc_plan_t *plan, const cc_plan_span_t *span, const gchar *old)
+{
+  const cc_plan_edit_t  *edit = NULL;
+  gchar                 *out = NULL, *at = NULL;
+  gsize                 outsz = span->len;
+  gint                  from = 0;
+  guint                 i;
+
+  for (i = span->first; i < span->last; ++i)
+    outsz += (gint64)TEXT_LEN(plan, EDIT(plan, i)) - EDIT(plan, i)->len;
+
+  at = out = cc_malloc(CC_MEM_CONVERTER, outsz + 1);
+
+  for (i = span->first; i < span->last; ++i) {
+    edit = EDIT(plan, i);
+
+    memcpy(at, old + from, edit->pos - span->pos - from);
+    at += edit->pos - span->pos - from;
+
+    strcpy(at, g_ptr_array_index(plan->texts, edit->text));
+    at += strlen(at);
+
+    from = edit->pos + edit->len - span->pos;
+  }
+
+  memcpy(at, old + from, span->len - from);
+  at[span->len - from] = '\0';
+
+  return out;
+}
+
+const gchar* cc_plan_mode_name(cc_plan_mode_t mode)
+{
+  switch (mode) {
+    case CC_PLAN_EACH:    return "each";
+    case CC_PLAN_CHUNKS:  return "chunks";
+    case CC_PLAN_WHOLE:   return "whole";
+    default:              return "?";
+  }
+}
+
+/* the end of the line starting at "bol", where "\r", "\n" or "\r\n" end one */
+static gsize line_end(const gchar *text, gsize textsz, gsize bol)
+{
+  for (; bol < textsz && text[bol] != '\n' && text[bol] != '\r'; ++bol);
+
+  return bol;
+}
+
+static gsize next_line(const gchar *text, gsize textsz, gsize eol)
+{
+  if (eol < textsz && text[eol] == '\r' && eol + 1 < textsz && text[eol+1] == '\n')
+    ++eol;
+
+  return MIN(eol + 1, textsz);
+}
+
+gchar* cc_plan_diff(const cc_plan_t *plan, const gchar *text, gsize textsz,
+                    gint base, const gchar *name, gint max_hunks)
+{
+  GString         *out = g_string_new(NULL);
+  cc_plan_edit_t  *edit = NULL;
+  gsize           bol = 0, eol = line_end(text, textsz, 0), pos, from;
+  gint            line = 1, nr_hunks = 0;
+  guint           i = 0;
+
+  g_string_append_printf(out, "--- a/%s\n+++ b/%s\n", name, name);
+
+  while (i < plan->edits->len) {
+    edit = &g_array_index(plan->edits, cc_plan_edit_t, i);
+    pos = edit->pos - base;
+
+    /* the line of the next edit */
+    while (pos > eol && eol < textsz) {
+      bol = next_line(text, textsz, eol);
+      eol = line_end(text, textsz, bol);
+      ++line;
+    }
+
+    if (nr_hunks++ == max_hunks) {
+      g_string_append_printf(out, "... %u more edits\n", plan->edits->len - i);
+      break;
+    }
+
+    g_string_append_printf(out, "@@ -%d +%d @@\n-", line, line);
+    g_string_append_len(out, text + bol, eol - bol);
+    g_string_append(out, "\n+");
+
+    /* the line with every edit it has made */
+    for (from = bol; i < plan->edits->len; ++i) {
+      edit = &g_array_index(plan->edits, cc_plan_edit_t, i);
+      pos = edit->pos - base;
+
+      if (pos > eol)
+        break;
+
+      g_string_append_len(out, text + from, pos - from);
+      g_string_append(out, g_ptr_array_index(plan->texts, edit->text));
+      from = pos + edit->len;
+    }
+
+    g_string_append_len(out, text + from, MAX(eol, from) - from);
+    g_string_append_c(out, '\n');
+  }
+
+  return g_string_free(out, FALSE);
+}
+
+/* runs "func" on "nr_threads" threads, the calling one included */
+static void run_workers(GThreadFunc func, job_t *job, gint nr_threads)
+{
+  GThread **threads = cc_malloc(CC_MEM_CONVERTER, sizeof(GThread*) * nr_threads);
+  gint    i;
+
+  job->next = 0;
+
+  for (i = 1; i < nr_threads; ++i)
+    threads[i] = g_thread_new("caseconvert-plan", func, job);
+
+  func(job);
+
+  for (i = 1; i < nr_threads; ++i)
+    g_thread_join(threads[i]);
+
+  cc_free(threads);
+}
+
+/* 1. lists the names of a chunk, and the distinct ones */
+static void list_names(const gchar *text, chunk_t *chunk)
+{
+  GString *key = g_string_sized_new(64);
+  gchar   *name = NULL;
+  gsize   begin = chunk->begin, end;
+  span_t  span;
+
+  while (begin < chunk->end) {
+    for (; begin < chunk->end && !CC_OCCUR_IS_WORD_CHAR(text[begin]); ++begin);
+    for (end = begin; end < chunk->end && CC_OCCUR_IS_WORD_CHAR(text[end]); ++end);
+
+    if (begin == end)
+      break;
+
+    /* numbers, and their suffixes, are no names */
+    if (g_ascii_isdigit(text[begin])) {
+      begin = end;
+      continue;
+    }
+
+    g_string_truncate(key, 0);
+    g_string_append_len(key, text + begin, end - begin);
+
+    span.pos = begin;
+    span.len = end - begin;
+    span.name = GPOINTER_TO_INT(g_hash_table_lookup(chunk->names, key->str)) - 1;
+
+    if (span.name < 0) {
+      name = cc_strndup(CC_MEM_CONVERTER, key->str, key->len);
+      span.name = chunk->distinct->len;
+      g_ptr_array_add(chunk->distinct, name);
+      g_hash_table_insert(chunk->names, name, GINT_TO_POINTER(span.name + 1));
+    }
+
+    g_array_append_val(chunk->spans, span);
+    begin = end;
+  }
+
+  g_string_free(key, TRUE);
+}
+
+static gpointer list_worker(gpointer data)
+{
+  job_t *job = data;
+  gint  i;
+
+  while ((i = g_atomic_int_add(&job->next, 1)) < job->nr_chunks)
+    list_names(job->text, &job->chunks[i]);
+
+  return NULL;
+}
+
+/* 3. converts a batch of the distinct names at a time */
+static gpointer convert_worker(gpointer data)
+{
+  job_t       *job = data;
+  const gchar *name = NULL;
+  gchar       *repl = NULL;
+  gint        first, i, last, replsz = 0;
+
+  while ((first = g_atomic_int_add(&job->next, CC_PLAN_BATCH)) < (gint)job->names->len) {
+    last = MIN(first + CC_PLAN_BATCH, (gint)job->names->len);
+
+    for (i = first; i < last; ++i) {
+      name = g_ptr_array_index(job->names, i);
+      repl = cc_convert_text(name, strlen(name), &replsz);
+
+      if (repl && strcmp(repl, name) == 0) {
+        cc_free(repl);
+        repl = NULL;
+      }
+
+      job->repls[i] = repl;
+    }
+  }
+
+  return NULL;
+}
+
+/* cuts the text in chunks of at least CC_PLAN_CHUNK bytes, at line ends */
+static chunk_t* make_chunks(const gchar *text, gsize textsz, gint *nr_chunks)
+{
+  GArray      *chunks = g_array_new(FALSE, TRUE, sizeof(chunk_t));
+  chunk_t     chunk;
+  const gchar *eol = NULL;
+  gsize       begin = 0;
+
+  memset(&chunk, 0, sizeof(chunk));
+
+  while (begin < textsz) {
+    chunk.begin = begin;
+    chunk.end = textsz;
+
+    if (textsz - begin > CC_PLAN_CHUNK
+    && (eol = memchr(text + begin + CC_PLAN_CHUNK, '\n', textsz - begin - CC_PLAN_CHUNK)) != NULL)
+      chunk.end = eol - text + 1;
+
+    chunk.spans = g_array_new(FALSE, FALSE, sizeof(span_t));
+    chunk.names = g_hash_table_new_full(g_str_hash, g_str_equal, cc_free, NULL);
+    chunk.distinct = g_ptr_array_new();
+    g_array_append_val(chunks, chunk);
+
+    begin = chunk.end;
+  }
+
+  *nr_chunks = chunks->len;
+
+  return (chunk_t*)g_array_free(chunks, FALSE);
+}
+
+static void free_chunks(chunk_t *chunks, gint nr_chunks)
+{
+  gint i;
+
+  for (i = 0; i < nr_chunks; ++i) {
+    g_array_free(chunks[i].spans, TRUE);
+    g_ptr_array_free(chunks[i].distinct, TRUE);
+    g_hash_table_destroy(chunks[i].names);
+    cc_free(chunks[i].ids);
+  }
+
+  g_free(chunks);
+}
+
+cc_plan_t* cc_plan_names(const gchar *text, gsize textsz, gint base, gint nr_threads)
+{
+  cc_plan_t       *plan = cc_plan_new();
+  GHashTable      *merged = g_hash_table_new(g_str_hash, g_str_equal);
+  chunk_t         *chunk = NULL;
+  span_t          *span = NULL;
+  gpointer        id;
+  gint            *texts = NULL;
+  gint            c, i, name;
+  job_t           job;
+
+  memset(&job, 0, sizeof(job));
+  job.text = text;
+  job.chunks = make_chunks(text, textsz, &job.nr_chunks);
+  job.names = g_ptr_array_new();
+
+  /* 1. */
+  run_workers(list_worker, &job, CLAMP(job.nr_chunks, 1, nr_threads));
+
+  /* 2. the chunks' names stay theirs, the set only points to them */
+  for (c = 0; c < job.nr_chunks; ++c) {
+    chunk = &job.chunks[c];
+    chunk->ids = cc_malloc(CC_MEM_CONVERTER, sizeof(gint) * (chunk->distinct->len + 1));
+    plan->nr_names += chunk->spans->len;
+
+    for (i = 0; i < (gint)chunk->distinct->len; ++i) {
+      if (!(id = g_hash_table_lookup(merged, g_ptr_array_index(chunk->distinct, i)))) {
+        g_ptr_array_add(job.names, g_ptr_array_index(chunk->distinct, i));
+        id = GINT_TO_POINTER(job.names->len);
+        g_hash_table_insert(merged, g_ptr_array_index(chunk->distinct, i), id);
+      }
+
+      chunk->ids[i] = GPOINTER_TO_INT(id) - 1;
+    }
+  }
+
+  plan->nr_distinct = job.names->len;
+
+  /* 3. */
+  job.repls = cc_malloc0(CC_MEM_CONVERTER, sizeof(gchar*) * (job.names->len + 1));
+  run_workers(convert_worker, &job,
+    CLAMP(((gint)job.names->len + CC_PLAN_BATCH - 1) / CC_PLAN_BATCH, 1, nr_threads));
+
+  /* 4. the conversions go to the plan as they're first used */
+  texts = cc_malloc(CC_MEM_CONVERTER, sizeof(gint) * (job.names->len + 1));
+  for (i = 0; i < (gint)job.names->len; ++i)
+    texts[i] = -1;
+
+  for (c = 0; c < job.nr_chunks; ++c) {
+    chunk = &job.chunks[c];
+
+    for (i = 0; i < (gint)chunk->spans->len; ++i) {
+      span = &g_array_index(chunk->spans, span_t, i);
+      name = chunk->ids[span->name];
+
+      if (!job.repls[name])
+        continue;
+
+      if (texts[name] < 0)
+        texts[name] = cc_plan_add_text(plan, job.repls[name]);
+
+      cc_plan_add_edit(plan, base + span->pos, span->len, texts[name]);
+    }
+  }
+
+  cc_free(texts);
+  cc_free(job.repls);
+  g_ptr_array_free(job.names, TRUE);
+  g_hash_table_destroy(merged);
+  free_chunks(job.chunks, job.nr_chunks);
+
+  return plan;
+}
@@ -0,0 +1,151 @@
+/*
+ *  caseconvert_plan.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_PLAN_H
+#define H_GEANY_CASE_CONVERT_PLAN_H
+
+#include <glib.h>
+
+/*
+ * Replacement plans: what a conversion would replace in a text, worked out
+ * without touching it. An edit replaces "len" bytes at "pos" with one of
+ * the plan's texts, which are only held once however many edits use them;
+ * the edits are in ascending order and never overlap.
+ *
+ * cc_plan_names() plans converting every name of a text, as a bulk job:
+ *
+ *  1. the text is cut in chunks at line ends, and the workers take the
+ *     chunks in turn, listing the names in each and the distinct ones
+ *  2. the distinct names of all chunks are merged into a single set
+ *  3. the workers take batches of that set in turn and convert them, each
+ *     distinct name is converted once however many times it occurs
+ *  4. the names are mapped to their conversions, in order, into edits
+ *
+ * A name is a run of identifier characters (see CC_OCCUR_IS_WORD_CHAR) not
+ * starting with a digit; those the engine leaves alone aren't edited.
+ *
+ * Other conversions build their plans edit by edit, see cc_plan_range().
+ *
+ * Every replacement made in the editor keeps what it removed and inserted
+ * in the undo history, along with the bookkeeping of two undo actions;
+ * cc_plan_estimate() weighs making the edits one by one against making
+ * those close to each other as a single replacement, or the whole range at
+ * once, and picks the cheapest. Replacements never span a line end, so the
+ * markers and folds of the lines stay where they are.
+ *
+ * Nothing in here calls into Geany.
+ */
+
+#define CC_PLAN_THREADS 8
+#define CC_PLAN_CHUNK   (256 * 1024) /* bytes of text per chunk, at least */
+
+/* what the estimates go by, in bytes of undo history: an undo action's
+ * bookkeeping, and the time a replacement takes over copying its text */
+#define CC_PLAN_ACTION_COST   48
+#define CC_PLAN_CALL_COST     256
+#define CC_PLAN_SPAN_MAX      (64 * 1024) /* bytes a single replacement spans, at most */
+
+typedef struct {
+  gint  pos;
+  gint  len;
+  gint  text;   /* into cc_plan_t::texts */
+} cc_plan_edit_t;
+
+typedef struct {
+  GArray    *edits;         /* cc_plan_edit_t, ascending */
+  GPtrArray *texts;         /* the replacements, cc_malloc'd */
+  gint      nr_names;       /* names found */
+  gint      nr_distinct;    /* distinct names found */
+  gint      removed;        /* bytes the edits replace */
+  gint      added;          /* bytes they replace them with */
+} cc_plan_t;
+
+cc_plan_t*  cc_plan_new(void);
+void        cc_plan_free(cc_plan_t *plan);
+
+typedef enum {
+  CC_PLAN_EACH,     /* every edit on its own */
+  CC_PLAN_CHUNKS,   /* the edits close enough to each other together */
+  CC_PLAN_WHOLE,    /* the range from the first edit to the last at once */
+  CC_PLAN_NR_MODES
+} cc_plan_mode_t;
+
+/* a replacement of the document from "pos" on, making edits [first, last) */
+typedef struct {
+  gint  pos;
+  gint  len;
+  guint first;
+  guint last;
+} cc_plan_span_t;
+
+/* the undo and calls of a mode that can't apply the plan */
+#define CC_PLAN_INELIGIBLE G_MAXSIZE
+
+typedef struct {
+  cc_plan_mode_t  mode;                       /* the cheapest */
+  gsize           undo[CC_PLAN_NR_MODES];     /* history added, bytes */
+  gsize           calls[CC_PLAN_NR_MODES];    /* replacements made */
+  gsize           peak;                       /* the longest text replaced, the mode's */
+} cc_plan_cost_t;
+
+/* takes a replacement over, and returns its id */
+gint        cc_plan_add_text(cc_plan_t *plan, gchar *text);
+
+/* appends an edit, which must come after those already planned */
+void        cc_plan_add_edit(cc_plan_t *plan, gint pos, gint len, gint text);
+
+/**
+ * Formats the plan as a unified diff of "text", the document it was
+ * planned over starting at "base", one hunk per line edited and no more
+ * than "max_hunks" of them.
+ *
+ * @return the diff, free it with g_free()
+ */
+gchar*      cc_plan_diff(const cc_plan_t *plan, const gchar *text, gsize textsz,
+                         gint base, const gchar *name, gint max_hunks);
+
+/**
+ * Estimates applying the plan each way and picks the cheapest, appending the
+ * replacements it makes to "spans" (cc_plan_span_t), ascending. "lines" has
+ * the line of every edit; a mode that would replace a line end isn't picked,
+ * nor is one replacing more than CC_PLAN_SPAN_MAX bytes at once: its undo
+ * and calls are CC_PLAN_INELIGIBLE.
+ */
+void        cc_plan_estimate(const cc_plan_t *plan, const gint *lines,
+                             cc_plan_cost_t *cost, GArray *spans);
+
+/**
+ * The text a span is replaced with, given "old", the text it spans.
+ *
+ * @return the text, free it with cc_free()
+ */
+gchar*      cc_plan_compose(const cc_plan_t *plan, const cc_plan_span_t *span,
+                            const gchar *old);
+
+/* names a mode, for reports */
+const gchar* cc_plan_mode_name(cc_plan_mode_t mode);
+
+/**
+ * Plans converting every name of "text", on up to "nr_threads" threads; the
+ * edits' positions are offset by "base", ie where the text starts in the
+ * document.
+ */
+cc_plan_t*  cc_plan_names(const gchar *text, gsize textsz, gint base, gint nr_threads);
+
+#endif
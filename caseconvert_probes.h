@@ -0,0 +1,104 @@
+/*
+ *  caseconvert_probes.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_PROBES_H
+#define H_GEANY_CASE_CONVERT_PROBES_H
+
+#include <glib.h>
+
+/*
+ * USDT (SystemTap/DTrace compatible) static probes, compiled in when built
+ * with -DHAVE_SYS_SDT_H. An unattached probe is a single nop; the probes
+ * that report elapsed time have a semaphore so the clock is only read while
+ * a tracer is attached, ie:
+ *
+ *  bpftrace -p `pidof geany` -e \
+ *    'usdt:caseconvert.so:caseconvert:convert__return { @us = hist(arg3); }'
+ *
+ * provider "caseconvert":
+ *
+ *  convert__entry          (input length)
+ *  convert__return         (input length, output length or -1, rule id or -1, elapsed us)
+ *  rule__match             (rule id, condition type, input length)
+ *  range__entry            (range start, range end, text length)
+ *  range__replace          (position, old length, new length)
+ *  range__return           (number of replaced occurences, elapsed us)
+ *  settings__load__entry   ()
+ *  settings__load__return  (number of rules, elapsed us)
+ *  settings__save__entry   ()
+ *  settings__save__return  (number of rules, bytes written, elapsed us)
+ *  ui__init__entry         ()
+ *  ui__init__return        (elapsed us)
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+# define _SDT_HAS_SEMAPHORES 1
+# include <sys/sdt.h>
+
+# define CC_PROBE_SEMAPHORE(name) caseconvert_##name##_semaphore
+
+/* every probe needs a semaphore once _SDT_HAS_SEMAPHORES is set, they are
+ * defined in caseconvert_trace.c */
+# define CC_PROBE_SEMAPHORES(X) \
+  X(convert__entry)         \
+  X(convert__return)        \
+  X(rule__match)            \
+  X(range__entry)           \
+  X(range__replace)         \
+  X(range__return)          \
+  X(settings__load__entry)  \
+  X(settings__load__return) \
+  X(settings__save__entry)  \
+  X(settings__save__return) \
+  X(ui__init__entry)        \
+  X(ui__init__return)
+
+# define CC_PROBE_DECLARE_SEMAPHORE(name) extern unsigned short CC_PROBE_SEMAPHORE(name);
+CC_PROBE_SEMAPHORES(CC_PROBE_DECLARE_SEMAPHORE)
+
+# define CC_PROBE_ENABLED(name) G_UNLIKELY(CC_PROBE_SEMAPHORE(name))
+
+# define CC_PROBE0(name)                DTRACE_PROBE(caseconvert, name)
+# define CC_PROBE1(name, a)             DTRACE_PROBE1(caseconvert, name, a)
+# define CC_PROBE2(name, a, b)          DTRACE_PROBE2(caseconvert, name, a, b)
+# define CC_PROBE3(name, a, b, c)       DTRACE_PROBE3(caseconvert, name, a, b, c)
+# define CC_PROBE4(name, a, b, c, d)    DTRACE_PROBE4(caseconvert, name, a, b, c, d)
+
+#else
+
+# define CC_PROBE_ENABLED(name) 0
+
+/* sizeof() marks the arguments as used without evaluating them */
+# define CC_PROBE0(name)                do {} while (0)
+# define CC_PROBE1(name, a)             do { (void)sizeof(a); } while (0)
+# define CC_PROBE2(name, a, b)          do { (void)sizeof(a); (void)sizeof(b); } while (0)
+# define CC_PROBE3(name, a, b, c)       do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+# define CC_PROBE4(name, a, b, c, d)    do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); (void)sizeof(d); } while (0)
+
+#endif
+
+/* start time for a probe reporting elapsed time, 0 if nobody is listening */
+#define CC_PROBE_CLOCK(name) \
+  (CC_PROBE_ENABLED(name) ? g_get_monotonic_time() : (gint64)0)
+
+#define CC_PROBE_ELAPSED(t0) \
+  ((t0) ? g_get_monotonic_time() - (t0) : (gint64)0)
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ *  caseconvert_record.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_record.h"
+#include "caseconvert_engine.h"
+#include <stdio.h>
+#include <string.h>
+
+gboolean cc_recording = FALSE;
+
+static FILE     *rec_file = NULL;
+static GString  *rec_buf = NULL;  /* the record being written */
+static guint    rec_generation;   /* rule set generation of the last rules record */
+
+struct cc_rec_reader_t {
+  GMappedFile *file;
+  const guchar *cursor;
+  const guchar *end;
+  GString     *txt;
+  GString     *range;
+  GString     *acronyms;
+  GString     *boundaries;
+};
+
+/* encoding */
+
+static void put_int(gint v)
+{
+  /* zigzag, so small negatives stay small */
+  guint32 u = ((guint32)v << 1) ^ (guint32)(v >> 31);
+
+  while (u >= 0x80) {
+    g_string_append_c(rec_buf, (gchar)((u & 0x7F) | 0x80));
+    u >>= 7;
+  }
+
+  g_string_append_c(rec_buf, (gchar)u);
+}
+
+static void put_text(const gchar *txt, gint txtsz)
+{
+  put_int(txtsz);
+  g_string_append_len(rec_buf, txt, txtsz);
+}
+
+static void flush_record()
+{
+  fwrite(rec_buf->str, 1, rec_buf->len, rec_file);
+  g_string_truncate(rec_buf, 0);
+}
+
+/* writes the rule set, and the acronym list and boundary grammar words are
+ * split along, if they changed since the last record */
+static void put_rules()
+{
+  const gchar *acronyms = cc_get_acronyms();
+  const gchar *boundaries = cc_get_boundaries();
+  gchar       *rules = NULL;
+  gint        nr_rules = 0;
+
+  if (rec_generation == cc_rules_generation())
+    return;
+
+  rules = cc_serialize_rules(&nr_rules);
+
+  g_string_append_c(rec_buf, CC_REC_RULES);
+  put_int(cc_get_config()->capitalize);
+  put_text(rules, strlen(rules));
+  put_text(acronyms ? acronyms : "", acronyms ? strlen(acronyms) : 0);
+  put_text(boundaries ? boundaries : "", boundaries ? strlen(boundaries) : 0);
+  flush_record();
+
+  cc_free(rules);
+  rec_generation = cc_rules_generation();
+}
+
+/* the length of the text, the given size may or may not count the NUL */
+static gint text_length(const gchar *txt, gint size)
+{
+  gint sz = 0;
+
+  while (sz < size && txt[sz] != '\0') ++sz;
+
+  return sz;
+}
+
+gboolean cc_rec_start(const gchar *path)
+{
+  cc_rec_stop();
+
+  rec_file = fopen(path, "ab");
+  if (!rec_file) {
+    cc_warn("WARN: unable to record conversions into '%s'\n", path);
+    return FALSE;
+  }
+
+  /* a fresh trace starts with the magic */
+  if (ftell(rec_file) == 0)
+    fwrite(CC_REC_MAGIC, 1, strlen(CC_REC_MAGIC), rec_file);
+
+  rec_buf = g_string_sized_new(256);
+  rec_generation = cc_rules_generation() - 1; /* always record the initial set */
+  cc_recording = TRUE;
+
+  cc_info("recording conversions into '%s'\n", path);
+
+  return TRUE;
+}
+
+void cc_rec_stop()
+{
+  if (!cc_recording)
+    return;
+
+  fclose(rec_file);
+  g_string_free(rec_buf, TRUE);
+
+  rec_file = NULL;
+  rec_buf = NULL;
+  cc_recording = FALSE;
+}
+
+void cc_rec_selection(const gchar *txt, gint size)
+{
+  if (!cc_recording)
+    return;
+
+  put_rules();
+
+  g_string_append_c(rec_buf, CC_REC_SELECTION);
+  put_int(size);
+  put_text(txt, text_length(txt, size));
+  flush_record();
+}
+
+void cc_rec_range(gint begin, gint end, gint flags,
+                  const gchar *txt, gint size,
+                  const gchar *range, gint rangesz)
+{
+  if (!cc_recording)
+    return;
+
+  put_rules();
+
+  g_string_append_c(rec_buf, CC_REC_RANGE);
+  put_int(flags);
+  put_int(begin);
+  put_int(end);
+  put_int(size);
+  put_text(txt, text_length(txt, size));
+  put_text(range ? range : "", range ? rangesz : 0);
+  flush_record();
+}
+
+/* decoding */
+
+static gboolean get_int(cc_rec_reader_t *r, gint *v)
+{
+  guint32 u = 0;
+  guint   shift = 0;
+
+  while (r->cursor < r->end && shift < 35) {
+    guchar b = *(r->cursor++);
+
+    u |= (guint32)(b & 0x7F) << shift;
+    shift += 7;
+
+    if (!(b & 0x80)) {
+      *v = (gint)((u >> 1) ^ (~(u & 1) + 1));
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static gboolean get_text(cc_rec_reader_t *r, GString *out, gchar **txt, gint *txtsz)
+{
+  gint sz = 0;
+
+  if (!get_int(r, &sz) || sz < 0 || sz > r->end - r->cursor)
+    return FALSE;
+
+  g_string_truncate(out, 0);
+  g_string_append_len(out, (const gchar*)r->cursor, sz);
+  r->cursor += sz;
+
+  *txt = out->str;
+  *txtsz = sz;
+
+  return TRUE;
+}
+
+cc_rec_reader_t* cc_rec_reader_open(const gchar *path)
+{
+  cc_rec_reader_t *r = NULL;
+  GMappedFile     *file = g_mapped_file_new(path, FALSE, NULL);
+  gsize           magicsz = strlen(CC_REC_MAGIC);
+
+  if (!file)
+    return NULL;
+
+  if (g_mapped_file_get_length(file) < magicsz
+  ||  memcmp(g_mapped_file_get_contents(file), CC_REC_MAGIC, magicsz) != 0)
+  {
+    if (g_mapped_file_get_length(file) >= magicsz
+    &&  memcmp(g_mapped_file_get_contents(file), CC_REC_MAGIC, magicsz - 3) == 0)
+      cc_warn("WARN: '%s' is a conversion trace of another version\n", path);
+    else
+      cc_warn("WARN: '%s' is not a conversion trace\n", path);
+
+    g_mapped_file_unref(file);
+    return NULL;
+  }
+
+  r = cc_malloc(CC_MEM_SETTINGS, sizeof(cc_rec_reader_t));
+  r->file = file;
+  r->cursor = (const guchar*)g_mapped_file_get_contents(file) + magicsz;
+  r->end = (const guchar*)g_mapped_file_get_contents(file) + g_mapped_file_get_length(file);
+  r->txt = g_string_new("");
+  r->range = g_string_new("");
+  r->acronyms = g_string_new("");
+  r->boundaries = g_string_new("");
+
+  return r;
+}
+
+void cc_rec_reader_close(cc_rec_reader_t *r)
+{
+  if (!r)
+    return;
+
+  g_mapped_file_unref(r->file);
+  g_string_free(r->txt, TRUE);
+  g_string_free(r->range, TRUE);
+  g_string_free(r->acronyms, TRUE);
+  g_string_free(r->boundaries, TRUE);
+  cc_free(r);
+}
+
+gboolean cc_rec_read(cc_rec_reader_t *r, cc_rec_t *rec)
+{
+  memset(rec, 0, sizeof(cc_rec_t));
+
+  if (r->cursor >= r->end)
+    return FALSE;
+
+  rec->op = *(r->cursor++);
+
+  switch (rec->op)
+  {
+    case CC_REC_RULES:
+      return get_int(r, &rec->flags)
+          && get_text(r, r->txt, &rec->txt, &rec->txtsz)
+          && get_text(r, r->acronyms, &rec->acronyms, &rec->acronymssz)
+          && get_text(r, r->boundaries, &rec->boundaries, &rec->boundariessz);
+
+    case CC_REC_SELECTION:
+      return get_int(r, &rec->size)
+          && get_text(r, r->txt, &rec->txt, &rec->txtsz);
+
+    case CC_REC_RANGE:
+      return get_int(r, &rec->flags)
+          && get_int(r, &rec->begin)
+          && get_int(r, &rec->end)
+          && get_int(r, &rec->size)
+          && get_text(r, r->txt, &rec->txt, &rec->txtsz)
+          && get_text(r, r->range, &rec->range, &rec->rangesz);
+
+    default:
+      cc_warn("WARN: unknown record type (%d), the trace is corrupt\n", rec->op);
+      return FALSE;
+  }
+}
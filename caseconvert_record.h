@@ -0,0 +1,103 @@
+/*
+ *  caseconvert_record.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_RECORD_H
+#define H_GEANY_CASE_CONVERT_RECORD_H
+
+#include <glib.h>
+
+/*
+ * Conversion recorder.
+ *
+ * When enabled (record=<path> in caseconvert.conf, or CC_RECORD=<path> in
+ * the environment) every conversion request is appended to a compact binary
+ * trace which caseconvert-tool can replay headlessly against the engine:
+ *
+ *  caseconvert-tool replay [-v] <trace>
+ *
+ * The trace starts with the 8 byte magic "CCREC002" followed by records:
+ *
+ *  u8 op, then depending on op:
+ *
+ *  CC_REC_RULES      flags (capitalize), text (serialized rules), acronyms
+ *                    (the acronym list, empty if none), boundaries (the
+ *                    boundary grammar, empty for the default one)
+ *  CC_REC_SELECTION  size (as passed), text
+ *  CC_REC_RANGE      flags (search flags), begin, end, size (as passed),
+ *                    text, range (contents of the searched range)
+ *
+ * Integers are zigzag-encoded LEB128 varints, texts are a varint length
+ * followed by that many bytes. A rules record is written before any
+ * operation whenever the rule set, or anything else conversions depend on,
+ * changed since the last one.
+ */
+
+#define CC_REC_MAGIC "CCREC002"
+
+typedef enum {
+  CC_REC_NULL = 0,
+  CC_REC_RULES,     /* the active rule set */
+  CC_REC_SELECTION, /* cc_convert_selection() */
+  CC_REC_RANGE,     /* cc_convert_range(), from Convert All or Convert More */
+  CC_REC_COUNT
+} cc_rec_op_t;
+
+typedef struct {
+  cc_rec_op_t op;
+  gint        flags;
+  gint        begin;
+  gint        end;
+  gint        size;     /* the text size as given to the entry point */
+  gchar       *txt;     /* NUL-terminated */
+  gint        txtsz;
+  gchar       *range;   /* NUL-terminated */
+  gint        rangesz;
+  gchar       *acronyms; /* NUL-terminated */
+  gint        acronymssz;
+  gchar       *boundaries; /* NUL-terminated */
+  gint        boundariessz;
+} cc_rec_t;
+
+extern gboolean cc_recording;
+
+/* starts appending to the trace at "path", returns FALSE if it can't be opened */
+gboolean cc_rec_start(const gchar *path);
+void     cc_rec_stop();
+
+void     cc_rec_selection(const gchar *txt, gint size);
+void     cc_rec_range(gint begin, gint end, gint flags,
+                      const gchar *txt, gint size,
+                      const gchar *range, gint rangesz);
+
+/* reading traces */
+typedef struct cc_rec_reader_t cc_rec_reader_t;
+
+cc_rec_reader_t*  cc_rec_reader_open(const gchar *path);
+void              cc_rec_reader_close(cc_rec_reader_t*);
+
+/**
+ * Reads the next record.
+ *
+ * @return
+ * FALSE at the end of the trace or if it's corrupt. The strings in "rec"
+ * are owned by the reader and are valid until the next call.
+ */
+gboolean          cc_rec_read(cc_rec_reader_t*, cc_rec_t *rec);
+
+#endif
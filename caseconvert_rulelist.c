@@ -0,0 +1,544 @@
+/*
+ *  caseconvert_rulelist.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_rulelist.h"
+#include "caseconvert_engine.h"
+#include "caseconvert_search.h"
+#include <string.h>
+
+typedef struct {
+  rule_t    *rule;
+  gint      id;       /* the rule's, to find it again across reloads */
+  gboolean  edited;   /* the fields below are pending */
+  gboolean  enabled;
+  gchar     *label;   /* NULL unless it was edited */
+} row_t;
+
+struct _CcRuleList {
+  GObject   parent;
+
+  gint      stamp;    /* iterators are only good for the rows they were made for */
+  row_t     *rows;
+  gint      nr_rows;
+  GString   *cell;    /* the text cell being formatted */
+
+  /* the rows shown, by their position, unless every row is; the index is
+   * only built once the list is first filtered */
+  cc_search_t *index;
+  gboolean  indexed;
+  gchar     *filter;
+  gint      *shown;
+  gint      nr_shown;
+};
+
+struct _CcRuleListClass {
+  GObjectClass parent_class;
+};
+
+static void cc_rule_list_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(CcRuleList, cc_rule_list, G_TYPE_OBJECT,
+  G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, cc_rule_list_tree_model_init))
+
+static void clear_rows(CcRuleList *list)
+{
+  gint i;
+
+  for (i = 0; i < list->nr_rows; ++i)
+    cc_free(list->rows[i].label);
+
+  cc_free(list->rows);
+  list->rows = NULL;
+  list->nr_rows = 0;
+}
+
+static void cc_rule_list_init(CcRuleList *list)
+{
+  list->stamp = g_random_int();
+  list->rows = NULL;
+  list->nr_rows = 0;
+  list->cell = g_string_sized_new(128);
+  list->index = cc_search_new();
+  list->indexed = FALSE;
+  list->filter = NULL;
+  list->shown = NULL;
+  list->nr_shown = 0;
+}
+
+static void cc_rule_list_finalize(GObject *obj)
+{
+  CcRuleList *list = CC_RULE_LIST(obj);
+
+  clear_rows(list);
+  g_string_free(list->cell, TRUE);
+  cc_search_free(list->index);
+  cc_free(list->shown);
+  g_free(list->filter);
+
+  G_OBJECT_CLASS(cc_rule_list_parent_class)->finalize(obj);
+}
+
+static void cc_rule_list_class_init(CcRuleListClass *klass)
+{
+  G_OBJECT_CLASS(klass)->finalize = cc_rule_list_finalize;
+}
+
+CcRuleList* cc_rule_list_new(void)
+{
+  return g_object_new(CC_TYPE_RULE_LIST, NULL);
+}
+
+/* the number of rows shown */
+static gint nr_shown(CcRuleList *list)
+{
+  return list->shown ? list->nr_shown : list->nr_rows;
+}
+
+/* the row an iterator points at, NULL if it's stale */
+static row_t* iter_row(CcRuleList *list, GtkTreeIter *iter)
+{
+  gint i = GPOINTER_TO_INT(iter->user_data);
+
+  if (iter->stamp != list->stamp || i < 0 || i >= nr_shown(list))
+    return NULL;
+
+  return &list->rows[list->shown ? list->shown[i] : i];
+}
+
+static gboolean make_iter(CcRuleList *list, GtkTreeIter *iter, gint i)
+{
+  if (i < 0 || i >= nr_shown(list)) {
+    iter->stamp = 0;
+    return FALSE;
+  }
+
+  iter->stamp = list->stamp;
+  iter->user_data = GINT_TO_POINTER(i);
+  iter->user_data2 = iter->user_data3 = NULL;
+
+  return TRUE;
+}
+
+/* formatting */
+
+static void format_condition(GString *out, const rule_t *rule)
+{
+  switch (rule->condition->type)
+  {
+    case CC_CND_HAS_PREFIX:
+      g_string_append_printf(out, "Begins with %s", rule->condition->value); break;
+    case CC_CND_HAS_SUFFIX:
+      g_string_append_printf(out, "Ends with %s", rule->condition->value); break;
+    case CC_CND_MATCHES:
+      g_string_append_printf(out, "Matches %s", rule->condition->value); break;
+    case CC_CND_ALWAYS_TRUE:
+      g_string_append(out, "Always true"); break;
+    default:
+      g_string_append(out, "Invalid!");
+  }
+
+  /* rules scoped to some filetypes say so */
+  if (rule->filetypes)
+    g_string_append_printf(out, " (in %s)", rule->filetypes);
+
+  /* flag enabled rules that are left out of conversions */
+  if (rule->enabled && rule->prog.status != CC_RULE_LIVE)
+  {
+    switch (rule->prog.status)
+    {
+      case CC_RULE_SHADOWED:
+        g_string_append_printf(out, " [!! %s %d]", _("shadowed by rule"), rule->prog.shadowed_by); break;
+      case CC_RULE_DUPLICATE:
+        g_string_append_printf(out, " [!! %s %d]", _("duplicate of rule"), rule->prog.shadowed_by); break;
+      default:
+        g_string_append_printf(out, " [!! %s]", _("never applies"));
+    }
+  }
+}
+
+static void format_actions(GString *out, const rule_t *rule)
+{
+  action_t *a = NULL;
+
+  for (a = rule->actions; a != NULL; a = a->next) {
+    const gchar *msg = NULL;
+
+    switch (a->type)
+    {
+      case CC_ACT_ADD_PREFIX: msg = "Add Prefix"; break;
+      case CC_ACT_ADD_SUFFIX: msg = "Add Suffix"; break;
+      case CC_ACT_REM_PREFIX: msg = "Rem Prefix"; break;
+      case CC_ACT_REM_SUFFIX: msg = "Rem Suffix"; break;
+      default:
+      msg = "Invalid";
+    }
+
+    if (a != rule->actions)
+      g_string_append(out, ", ");
+
+    g_string_append_printf(out, "%s %s", msg, a->value ? a->value : "");
+  }
+}
+
+/* GtkTreeModel */
+
+static GtkTreeModelFlags get_flags(G_GNUC_UNUSED GtkTreeModel *model)
+{
+  return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint get_n_columns(G_GNUC_UNUSED GtkTreeModel *model)
+{
+  return CC_RULE_LIST_COLUMNS;
+}
+
+static GType get_column_type(G_GNUC_UNUSED GtkTreeModel *model, gint column)
+{
+  switch (column)
+  {
+    case CC_RULE_LIST_ID:       return G_TYPE_INT;
+    case CC_RULE_LIST_ENABLED:  return G_TYPE_BOOLEAN;
+    case CC_RULE_LIST_LABEL:
+    case CC_RULE_LIST_CND:
+    case CC_RULE_LIST_ACT:      return G_TYPE_STRING;
+    default:                    return G_TYPE_INVALID;
+  }
+}
+
+static gboolean get_iter(GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path)
+{
+  if (gtk_tree_path_get_depth(path) != 1)
+    return FALSE;
+
+  return make_iter(CC_RULE_LIST(model), iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath* get_path(GtkTreeModel *model, GtkTreeIter *iter)
+{
+  if (!iter_row(CC_RULE_LIST(model), iter))
+    return NULL;
+
+  return gtk_tree_path_new_from_indices(GPOINTER_TO_INT(iter->user_data), -1);
+}
+
+static void get_value(GtkTreeModel *model, GtkTreeIter *iter, gint column, GValue *value)
+{
+  CcRuleList  *list = CC_RULE_LIST(model);
+  row_t       *row = iter_row(list, iter);
+
+  g_value_init(value, get_column_type(model, column));
+
+  if (!row)
+    return;
+
+  switch (column)
+  {
+    case CC_RULE_LIST_ID:
+      g_value_set_int(value, row->id);
+    break;
+
+    case CC_RULE_LIST_ENABLED:
+      g_value_set_boolean(value, row->edited ? row->enabled : row->rule->enabled);
+    break;
+
+    case CC_RULE_LIST_LABEL:
+      if (row->label)
+        g_value_set_string(value, row->label);
+      else
+        g_value_set_string(value, row->rule->label ? row->rule->label : "Unlabelled");
+    break;
+
+    case CC_RULE_LIST_CND:
+    case CC_RULE_LIST_ACT:
+      g_string_truncate(list->cell, 0);
+
+      if (column == CC_RULE_LIST_CND)
+        format_condition(list->cell, row->rule);
+      else
+        format_actions(list->cell, row->rule);
+
+      g_value_set_string(value, list->cell->str);
+    break;
+
+    default: ;
+  }
+}
+
+static gboolean iter_next(GtkTreeModel *model, GtkTreeIter *iter)
+{
+  CcRuleList *list = CC_RULE_LIST(model);
+
+  if (!iter_row(list, iter))
+    return FALSE;
+
+  return make_iter(list, iter, GPOINTER_TO_INT(iter->user_data) + 1);
+}
+
+static gboolean iter_nth_child(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+  /* rows have no children */
+  if (parent)
+    return make_iter(CC_RULE_LIST(model), iter, -1);
+
+  return make_iter(CC_RULE_LIST(model), iter, n);
+}
+
+static gboolean iter_children(GtkTreeModel *model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+  return iter_nth_child(model, iter, parent, 0);
+}
+
+static gboolean iter_has_child(G_GNUC_UNUSED GtkTreeModel *model, G_GNUC_UNUSED GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+static gint iter_n_children(GtkTreeModel *model, GtkTreeIter *iter)
+{
+  return iter ? 0 : nr_shown(CC_RULE_LIST(model));
+}
+
+static gboolean iter_parent(G_GNUC_UNUSED GtkTreeModel *model, GtkTreeIter *iter,
+                            G_GNUC_UNUSED GtkTreeIter *child)
+{
+  iter->stamp = 0;
+  return FALSE;
+}
+
+static void cc_rule_list_tree_model_init(GtkTreeModelIface *iface)
+{
+  iface->get_flags = get_flags;
+  iface->get_n_columns = get_n_columns;
+  iface->get_column_type = get_column_type;
+  iface->get_iter = get_iter;
+  iface->get_path = get_path;
+  iface->get_value = get_value;
+  iface->iter_next = iter_next;
+  iface->iter_children = iter_children;
+  iface->iter_has_child = iter_has_child;
+  iface->iter_n_children = iter_n_children;
+  iface->iter_nth_child = iter_nth_child;
+  iface->iter_parent = iter_parent;
+}
+
+/* rows */
+
+/* brings the index up to date, only the rules that changed since are
+ * indexed again */
+static void sync_index(CcRuleList *list)
+{
+  gint i;
+
+  for (i = 0; i < list->nr_rows; ++i)
+    cc_search_set_rule(list->index, list->rows[i].rule, list->rows[i].label);
+
+  cc_search_sweep(list->index);
+  list->indexed = TRUE;
+}
+
+/* picks the rows matching the filter */
+static void apply_filter(CcRuleList *list)
+{
+  GHashTable  *hits = NULL;
+  gint        i;
+
+  if (list->filter && *list->filter && !list->indexed)
+    sync_index(list);
+
+  hits = cc_search_query(list->index, list->filter ? list->filter : "");
+
+  cc_free(list->shown);
+  list->shown = NULL;
+  list->nr_shown = 0;
+
+  if (hits) {
+    list->shown = cc_malloc(CC_MEM_UI, sizeof(gint) * MAX(g_hash_table_size(hits), 1));
+
+    for (i = 0; i < list->nr_rows; ++i)
+      if (g_hash_table_contains(hits, GINT_TO_POINTER(list->rows[i].id)))
+        list->shown[list->nr_shown++] = i;
+
+    g_hash_table_destroy(hits);
+  }
+
+  /* previous iterators are no good anymore */
+  ++list->stamp;
+}
+
+void cc_rule_list_filter(CcRuleList *list, const gchar *query)
+{
+  g_free(list->filter);
+  list->filter = g_strdup(query);
+
+  apply_filter(list);
+}
+
+void cc_rule_list_reload(CcRuleList *list, gboolean keep_edits)
+{
+  GHashTable  *edits = NULL;
+  row_t       *old = list->rows, *row = NULL;
+  gint        nr_old = list->nr_rows;
+  rule_t      *rule = NULL;
+  gint        i = 0;
+
+  /* the pending edits, by rule id */
+  if (keep_edits) {
+    edits = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    for (i = 0; i < nr_old; ++i)
+      if (old[i].edited)
+        g_hash_table_insert(edits, GINT_TO_POINTER(old[i].id), &old[i]);
+  }
+
+  /* find out which rules can never apply so they can be flagged */
+  cc_analyze_rules();
+
+  list->nr_rows = 0;
+  for (rule = cc_get_rules(); rule != NULL; rule = rule->next)
+    ++list->nr_rows;
+
+  list->rows = cc_malloc0(CC_MEM_UI, sizeof(row_t) * MAX(list->nr_rows, 1));
+
+  for (i = 0, rule = cc_get_rules(); rule != NULL; rule = rule->next, ++i) {
+    list->rows[i].rule = rule;
+    list->rows[i].id = rule->id;
+
+    if (edits && (row = g_hash_table_lookup(edits, GINT_TO_POINTER(rule->id)))) {
+      list->rows[i].edited = TRUE;
+      list->rows[i].enabled = row->enabled;
+      list->rows[i].label = row->label;
+      row->label = NULL;
+    }
+  }
+
+  /* what's left of the previous rows */
+  for (i = 0; i < nr_old; ++i)
+    cc_free(old[i].label);
+  cc_free(old);
+
+  if (edits)
+    g_hash_table_destroy(edits);
+
+  if (list->indexed)
+    sync_index(list);
+
+  apply_filter(list);
+}
+
+static void row_changed(CcRuleList *list, GtkTreeIter *iter)
+{
+  GtkTreePath *path = get_path(GTK_TREE_MODEL(list), iter);
+
+  gtk_tree_model_row_changed(GTK_TREE_MODEL(list), path, iter);
+  gtk_tree_path_free(path);
+}
+
+/* starts editing a row, from the rule as it is */
+static row_t* edit_row(CcRuleList *list, GtkTreeIter *iter)
+{
+  row_t *row = iter_row(list, iter);
+
+  if (row && !row->edited) {
+    row->edited = TRUE;
+    row->enabled = row->rule->enabled;
+  }
+
+  return row;
+}
+
+void cc_rule_list_set_enabled(CcRuleList *list, GtkTreeIter *iter, gboolean enabled)
+{
+  row_t *row = edit_row(list, iter);
+
+  if (!row)
+    return;
+
+  row->enabled = enabled;
+  row_changed(list, iter);
+}
+
+gboolean cc_rule_list_get_enabled(CcRuleList *list, GtkTreeIter *iter)
+{
+  row_t *row = iter_row(list, iter);
+
+  if (!row)
+    return FALSE;
+
+  return row->edited ? row->enabled : row->rule->enabled;
+}
+
+void cc_rule_list_set_label(CcRuleList *list, GtkTreeIter *iter, const gchar *label)
+{
+  row_t *row = edit_row(list, iter);
+
+  if (!row)
+    return;
+
+  cc_free(row->label);
+  row->label = cc_strdup(CC_MEM_UI, label);
+  if (list->indexed)
+    cc_search_set_rule(list->index, row->rule, row->label);
+
+  row_changed(list, iter);
+}
+
+gint cc_rule_list_commit(CcRuleList *list)
+{
+  rule_t  **changed = cc_malloc(CC_MEM_UI, sizeof(rule_t*) * MAX(list->nr_rows, 1));
+  row_t   *row = NULL;
+  gint    nr_changed = 0;
+  gint    i;
+
+  for (i = 0; i < list->nr_rows; ++i)
+  {
+    row = &list->rows[i];
+
+    if (!row->edited)
+      continue;
+
+    /* only the rules actually edited are marked as such */
+    if (row->rule->enabled != row->enabled
+    || (row->label && g_strcmp0(row->rule->label, row->label) != 0))
+    {
+      cc_debug("Rule (%d) '%s' => %s\n", row->id, row->label ? row->label : row->rule->label,
+        row->enabled ? "enabled" : "disabled");
+
+      row->rule->enabled = row->enabled;
+
+      if (row->label) {
+        /* the previous label is ours to release */
+        cc_free(row->rule->label);
+        row->rule->label = cc_strdup(CC_MEM_RULES, row->label);
+      }
+
+      changed[nr_changed++] = row->rule;
+    }
+
+    cc_free(row->label);
+    row->label = NULL;
+    row->edited = FALSE;
+  }
+
+  if (nr_changed)
+    cc_rules_edited(changed, nr_changed);
+
+  cc_free(changed);
+
+  return nr_changed;
+}
@@ -0,0 +1,81 @@
+/*
+ *  caseconvert_rulelist.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_RULELIST_H
+#define H_GEANY_CASE_CONVERT_RULELIST_H
+
+#include "caseconvert_ui.h"
+#include "caseconvert_types.h"
+
+/*
+ * The Edit Rules list: a GtkTreeModel laid directly over the registered
+ * rules. A row is a pointer to its rule, nothing is copied or formatted up
+ * front; the condition and actions are spelled out as the view asks for
+ * them, which in fixed height mode is only for the rows on screen.
+ *
+ * Edits (the enabled flag and the label) are kept aside in the rows until
+ * cc_rule_list_commit() applies them, so cancelling the dialog leaves the
+ * rules alone.
+ *
+ * The rows point into the rule store, the list must be reloaded whenever
+ * rules are added or removed, detached from its views meanwhile; likewise
+ * when it's filtered.
+ */
+
+enum {
+  CC_RULE_LIST_ID,        /* gint */
+  CC_RULE_LIST_ENABLED,   /* gboolean */
+  CC_RULE_LIST_LABEL,     /* gchararray */
+  CC_RULE_LIST_CND,       /* gchararray, the condition as the user reads it */
+  CC_RULE_LIST_ACT,       /* gchararray, likewise the actions */
+  CC_RULE_LIST_COLUMNS
+};
+
+#define CC_TYPE_RULE_LIST (cc_rule_list_get_type())
+#define CC_RULE_LIST(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), CC_TYPE_RULE_LIST, CcRuleList))
+
+typedef struct _CcRuleList CcRuleList;
+typedef struct _CcRuleListClass CcRuleListClass;
+
+GType       cc_rule_list_get_type(void);
+
+/* an empty list, see cc_rule_list_reload() */
+CcRuleList* cc_rule_list_new(void);
+
+/* re-reads the registered rules, keeping the pending edits of the rules
+ * still around if "keep_edits" is set */
+void        cc_rule_list_reload(CcRuleList *list, gboolean keep_edits);
+
+/* shows only the rules matching every term of "query" (see
+ * caseconvert_search.h), or every rule if it's empty or NULL */
+void        cc_rule_list_filter(CcRuleList *list, const gchar *query);
+
+void        cc_rule_list_set_enabled(CcRuleList *list, GtkTreeIter *iter, gboolean enabled);
+gboolean    cc_rule_list_get_enabled(CcRuleList *list, GtkTreeIter *iter);
+void        cc_rule_list_set_label(CcRuleList *list, GtkTreeIter *iter, const gchar *label);
+
+/**
+ * Applies the pending edits to the rules that actually changed, and
+ * publishes them as a single change to the rule set.
+ *
+ * @return the number of rules changed
+ */
+gint        cc_rule_list_commit(CcRuleList *list);
+
+#endif
@@ -0,0 +1,359 @@
+/*
+ *  caseconvert_ruleset.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_ruleset.h"
+#include "caseconvert_trace.h"
+#include "caseconvert_mem.h"
+#include <ctype.h>
+#include <string.h>
+
+/* every array of the slab starts on a pointer-friendly boundary */
+#define SLAB_ALIGN(sz) (((sz) + 7) & ~(gsize)7)
+
+/* hands out the next "sz" bytes of the slab */
+static gpointer carve(gchar **cursor, gsize sz)
+{
+  gpointer p = *cursor;
+
+  *cursor += SLAB_ALIGN(sz);
+
+  return p;
+}
+
+/* adds "value" to the pool unless it's there already, returns its offset */
+static guint32 pool_add(GString *pool, GHashTable *offsets, const gchar *value)
+{
+  gpointer off = NULL;
+
+  if (!value || !*value)
+    return 0; /* the pool starts with an empty string */
+
+  if (g_hash_table_lookup_extended(offsets, value, NULL, &off))
+    return GPOINTER_TO_UINT(off);
+
+  off = GUINT_TO_POINTER(pool->len);
+  g_string_append_len(pool, value, strlen(value) + 1);
+  g_hash_table_insert(offsets, (gpointer)value, off);
+
+  return GPOINTER_TO_UINT(off);
+}
+
+/* whether an expression means the same within an alternation, which isn't
+ * the case for back references or anything else that counts groups */
+static gboolean can_combine(const gchar *pattern)
+{
+  const gchar *c;
+
+  for (c = pattern; *c; ++c) {
+    if (c[0] == '\\' && c[1] && (isdigit((guchar)c[1]) || strchr("gkQ", c[1])))
+      return FALSE;
+
+    if (c[0] == '(' && c[1] == '?' && c[2] && (isdigit((guchar)c[2]) || strchr("PR&+-", c[2])))
+      return FALSE;
+
+    if (c[0] == '\\' && c[1])
+      ++c;
+  }
+
+  return TRUE;
+}
+
+/* combines the expressions of the domain's live regex rules into one, the
+ * domain is left without a prefilter if any of them can't be combined */
+static GRegex* build_prefilter(const cc_ruleset_t *rs, gint domain)
+{
+  GString   *alt = g_string_new("");
+  GRegex    *prefilter = NULL;
+  gboolean  combinable = TRUE;
+  gint      i;
+
+  for (i = 0; i < rs->nr_rules && combinable; ++i) {
+    if (!rs->regexes[i] || !CC_RULESET_TEST(rs->domains[domain], i)
+    ||  !CC_RULESET_TEST(rs->enabled, i) || CC_RULESET_TEST(rs->dead, i))
+      continue;
+
+    combinable = can_combine(rs->pool + rs->cnd_values[i]);
+    g_string_append_printf(alt, "%s(?:%s)", alt->len ? "|" : "", rs->pool + rs->cnd_values[i]);
+  }
+
+  if (combinable && alt->len)
+    prefilter = g_regex_new(alt->str, G_REGEX_OPTIMIZE, 0, NULL);
+
+  cc_debug("prefilter of domain %d: %s\n", domain, prefilter ? alt->str : "none");
+  g_string_free(alt, TRUE);
+
+  return prefilter;
+}
+
+/* sets the bit of rule "i" in the live bitsets of its domain, for every
+ * scope it applies to */
+static void set_live(cc_ruleset_t *rs, const rule_t *rule, gint i, GHashTable *scopes)
+{
+  guint32 bit = (guint32)1 << (i % CC_RULESET_BITS);
+  gint    word = i / CC_RULESET_BITS;
+  gchar   **names = NULL;
+  gint    scope, n;
+
+  if (!rule->filetypes) {
+    for (scope = 0; scope < rs->nr_scopes; ++scope)
+      CC_RULESET_LIVE(rs, rule->domain, scope)[word] |= bit;
+
+    return;
+  }
+
+  names = g_strsplit(rule->filetypes, ";", -1);
+
+  for (n = 0; names[n]; ++n) {
+    gchar *name = g_ascii_strdown(g_strstrip(names[n]), -1);
+
+    scope = GPOINTER_TO_INT(g_hash_table_lookup(scopes, name));
+    if (scope > 0 && scope < rs->nr_scopes)
+      CC_RULESET_LIVE(rs, rule->domain, scope)[word] |= bit;
+
+    g_free(name);
+  }
+
+  g_strfreev(names);
+}
+
+cc_ruleset_t* cc_ruleset_new(const rule_t *rules, GHashTable *scopes, gint nr_scopes,
+                             cc_grammar_t *grammar, cc_acronyms_t *acronyms)
+{
+  cc_ruleset_t    *rs = NULL;
+  const rule_t    *rule = NULL;
+  const cc_prog_t *prog = NULL;
+  cc_xform_t      *xform = NULL;
+  GString         *pool = g_string_sized_new(256);
+  GHashTable      *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+  gint            nr_rules = 0, nr_words = 0, i;
+  gsize           slabsz = 0;
+  gchar           *cursor = NULL;
+
+  for (rule = rules; rule != NULL; rule = rule->next)
+    ++nr_rules;
+
+  nr_words = (nr_rules + CC_RULESET_BITS - 1) / CC_RULESET_BITS;
+
+  /* the values go to the pool first, it's laid out along with the rest */
+  g_string_append_c(pool, '\0');
+
+  for (rule = rules; rule != NULL; rule = rule->next) {
+    pool_add(pool, offsets, rule->prog.cnd_value);
+    pool_add(pool, offsets, rule->prog.add_prefix);
+    pool_add(pool, offsets, rule->prog.add_suffix);
+  }
+
+  slabsz = SLAB_ALIGN(sizeof(cc_ruleset_t))
+         + SLAB_ALIGN(sizeof(GRegex*) * nr_rules)
+         + SLAB_ALIGN(sizeof(cc_xform_t) * nr_rules)
+         + SLAB_ALIGN(sizeof(guint32) * nr_words) * 4
+         + SLAB_ALIGN(sizeof(guint32) * nr_words * nr_scopes * 2)
+         + SLAB_ALIGN(sizeof(gint) * nr_rules) * 3
+         + SLAB_ALIGN(sizeof(guint8) * nr_rules)
+         + SLAB_ALIGN(pool->len);
+
+  cursor = cc_malloc0(CC_MEM_RULES, slabsz);
+
+  rs = carve(&cursor, sizeof(cc_ruleset_t));
+  rs->refcount = 1;
+  rs->nr_rules = nr_rules;
+  rs->nr_words = nr_words;
+  rs->regexes = carve(&cursor, sizeof(GRegex*) * nr_rules);
+  rs->xforms = carve(&cursor, sizeof(cc_xform_t) * nr_rules);
+  rs->domains[CC_RULE_S2C] = carve(&cursor, sizeof(guint32) * nr_words);
+  rs->domains[CC_RULE_C2S] = carve(&cursor, sizeof(guint32) * nr_words);
+  rs->enabled = carve(&cursor, sizeof(guint32) * nr_words);
+  rs->dead = carve(&cursor, sizeof(guint32) * nr_words);
+  rs->nr_scopes = nr_scopes;
+  rs->live = carve(&cursor, sizeof(guint32) * nr_words * nr_scopes * 2);
+  rs->ids = carve(&cursor, sizeof(gint) * nr_rules);
+  rs->cnd_lens = carve(&cursor, sizeof(gint) * nr_rules);
+  rs->cnd_values = carve(&cursor, sizeof(guint32) * nr_rules);
+  rs->cnd_types = carve(&cursor, sizeof(guint8) * nr_rules);
+  rs->pool = carve(&cursor, pool->len);
+  rs->poolsz = pool->len;
+  rs->grammar = grammar ? cc_grammar_ref(grammar) : NULL;
+  rs->acronyms = acronyms ? cc_acronyms_ref(acronyms) : NULL;
+
+  memcpy(rs->pool, pool->str, pool->len);
+
+  for (rule = rules, i = 0; rule != NULL; rule = rule->next, ++i)
+  {
+    guint32 bit = (guint32)1 << (i % CC_RULESET_BITS);
+    gint    word = i / CC_RULESET_BITS;
+
+    prog = &rule->prog;
+
+    if (rule->domain == CC_RULE_S2C || rule->domain == CC_RULE_C2S)
+      rs->domains[rule->domain][word] |= bit;
+    if (rule->enabled)
+      rs->enabled[word] |= bit;
+    if (prog->status != CC_RULE_LIVE)
+      rs->dead[word] |= bit;
+    else if (rule->enabled && (rule->domain == CC_RULE_S2C || rule->domain == CC_RULE_C2S))
+      set_live(rs, rule, i, scopes);
+
+    rs->ids[i] = rule->id;
+    rs->cnd_types[i] = prog->cnd_type;
+    rs->cnd_lens[i] = prog->cnd_len;
+    rs->cnd_values[i] = pool_add(pool, offsets, prog->cnd_value);
+    rs->regexes[i] = prog->regex ? g_regex_ref(prog->regex) : NULL;
+
+    xform = &rs->xforms[i];
+    xform->rem_prefix = prog->rem_prefix;
+    xform->rem_suffix = prog->rem_suffix;
+    xform->add_prefix = pool_add(pool, offsets, prog->add_prefix);
+    xform->add_prefix_len = prog->add_prefix_len;
+    xform->add_suffix = pool_add(pool, offsets, prog->add_suffix);
+    xform->add_suffix_len = prog->add_suffix_len;
+    xform->rem_prefix_match = prog->rem_prefix_match;
+    xform->rem_suffix_match = prog->rem_suffix_match;
+  }
+
+  g_hash_table_destroy(offsets);
+  g_string_free(pool, TRUE);
+
+  rs->prefilters[CC_RULE_S2C] = build_prefilter(rs, CC_RULE_S2C);
+  rs->prefilters[CC_RULE_C2S] = build_prefilter(rs, CC_RULE_C2S);
+
+  cc_debug("laid out %d rules in %d bytes (%d of strings)\n", nr_rules, (gint)slabsz, (gint)rs->poolsz);
+
+  return rs;
+}
+
+cc_ruleset_t* cc_ruleset_ref(cc_ruleset_t *rs)
+{
+  g_atomic_int_inc(&rs->refcount);
+
+  return rs;
+}
+
+void cc_ruleset_unref(cc_ruleset_t *rs)
+{
+  gint i;
+
+  if (!rs || !g_atomic_int_dec_and_test(&rs->refcount))
+    return;
+
+  for (i = 0; i < rs->nr_rules; ++i)
+    if (rs->regexes[i])
+      g_regex_unref(rs->regexes[i]);
+
+  for (i = CC_RULE_S2C; i <= CC_RULE_C2S; ++i)
+    if (rs->prefilters[i])
+      g_regex_unref(rs->prefilters[i]);
+
+  cc_grammar_unref(rs->grammar);
+  cc_acronyms_unref(rs->acronyms);
+
+  /* the arrays are carved out of the same block */
+  cc_free(rs);
+}
+
+/* whether "in" meets the condition of rule "i", "mbegin" and "mend" receive
+ * the match of a regex condition, "prefiltered" caches the domain prefilter */
+static gboolean test_rule(const cc_ruleset_t *rs, gint domain, gint i,
+                          const gchar *in, gint n,
+                          gint *prefiltered, gint *mbegin, gint *mend)
+{
+  const gchar *value = rs->pool + rs->cnd_values[i];
+  gint        len = rs->cnd_lens[i];
+  GMatchInfo  *info = NULL;
+  gboolean    met = FALSE;
+
+  switch (rs->cnd_types[i])
+  {
+    case CC_CND_HAS_PREFIX:
+      return n >= len && memcmp(in, value, len) == 0;
+    case CC_CND_HAS_SUFFIX:
+      return n >= len && memcmp(in + n - len, value, len) == 0;
+    case CC_CND_ALWAYS_TRUE:
+      return TRUE;
+    case CC_CND_MATCHES:
+      /* none of the domain's expressions match? */
+      if (*prefiltered < 0)
+        *prefiltered = !rs->prefilters[domain]
+                    || g_regex_match_full(rs->prefilters[domain], in, n, 0, 0, NULL, NULL);
+
+      met = *prefiltered && g_regex_match_full(rs->regexes[i], in, n, 0, 0, &info, NULL);
+
+      if (met && (g_match_info_get_match_count(info) < 2
+      || !g_match_info_fetch_pos(info, 1, mbegin, mend) || *mbegin < 0))
+        g_match_info_fetch_pos(info, 0, mbegin, mend);
+
+      g_match_info_free(info);
+      return met;
+    default:
+      return FALSE;
+  }
+}
+
+gboolean cc_ruleset_match(const cc_ruleset_t *rs, gint domain, gint scope,
+                          const gchar *in, gint n, cc_match_t *match)
+{
+  const guint32     *live = NULL;
+  const cc_xform_t  *xform = NULL;
+  gint              prefiltered = -1; /* whether the prefilter matched, -1 until it's run */
+  gint              mbegin = 0, mend = 0; /* the match, or its first group */
+  gint              w, i;
+  guint32           candidates;
+
+  if (domain != CC_RULE_S2C && domain != CC_RULE_C2S)
+    return FALSE;
+
+  if (scope < 0 || scope >= rs->nr_scopes)
+    scope = 0;
+
+  live = CC_RULESET_LIVE(rs, domain, scope);
+
+  for (w = 0; w < rs->nr_words; ++w)
+  {
+    candidates = live[w];
+
+    for (; candidates; candidates &= candidates - 1)
+    {
+      i = w * CC_RULESET_BITS + g_bit_nth_lsf(candidates, -1);
+
+      if (!test_rule(rs, domain, i, in, n, &prefiltered, &mbegin, &mend))
+        continue;
+
+      /* removals are slices of the input, additions are segments around it */
+      xform = &rs->xforms[i];
+
+      match->rule = i;
+      match->begin = MIN(xform->rem_prefix, n);
+      match->end = MAX(n - xform->rem_suffix, match->begin);
+
+      if (xform->rem_prefix_match)
+        match->begin = MAX(match->begin, mend);
+      if (xform->rem_suffix_match)
+        match->end = MIN(match->end, mbegin);
+      match->end = MAX(match->end, match->begin);
+
+      match->add_prefix = rs->pool + xform->add_prefix;
+      match->add_prefix_len = xform->add_prefix_len;
+      match->add_suffix = rs->pool + xform->add_suffix;
+      match->add_suffix_len = xform->add_suffix_len;
+
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
@@ -0,0 +1,148 @@
+/*
+ *  caseconvert_ruleset.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_RULESET_H
+#define H_GEANY_CASE_CONVERT_RULESET_H
+
+#include <glib.h>
+
+#include "caseconvert_types.h"
+#include "caseconvert_grammar.h"
+#include "caseconvert_acronyms.h"
+
+/*
+ * The rule set as the converter sees it.
+ *
+ * rule_t and friends are the editing model: the parser, the dialogs and the
+ * settings work on them. Conversions work on a cc_ruleset_t built from the
+ * compiled and analyzed rules instead, which keeps everything matching looks
+ * at in a single block laid out as arrays indexed by the rule's position:
+ *
+ *  - bitsets of the rules in every domain, the enabled ones and the ones
+ *    the analysis found dead (see cc_analyze_rules())
+ *  - per domain and filetype scope, a bitset of the rules to try, which is
+ *    all the matching loop reads to pick candidates
+ *  - the condition types, lengths and values (as offsets into the pool)
+ *  - what the actions amount to, see cc_prog_t
+ *  - a string pool holding every value once
+ *
+ * So trying a candidate reads a bit, a type, a length and the value itself
+ * rather than chasing a rule, its condition and its strings around the heap.
+ *
+ * A rule set never changes once built and owns everything it refers to,
+ * editing the rules builds a new one (see cc_acquire_ruleset()). Any number
+ * of threads may match against it while they hold a reference.
+ */
+
+#define CC_RULESET_BITS 32 /* rules per bitset word */
+
+/* the folded actions of a rule, values are offsets into the pool */
+typedef struct {
+  gint      rem_prefix;
+  gint      rem_suffix;
+  guint32   add_prefix;
+  gint      add_prefix_len;
+  guint32   add_suffix;
+  gint      add_suffix_len;
+  gboolean  rem_prefix_match;
+  gboolean  rem_suffix_match;
+} cc_xform_t;
+
+typedef struct {
+  volatile gint refcount;
+
+  gint      nr_rules;
+  gint      nr_words;                   /* of every bitset */
+
+  guint32   *domains[CC_RULE_C2S + 1];  /* none for CC_RULE_NULL */
+  guint32   *enabled;
+  guint32   *dead;
+
+  /* the live rules of every domain that apply to every scope, the rules of
+   * no filetype in particular apply to all of them, see CC_RULESET_LIVE() */
+  gint      nr_scopes;
+  guint32   *live;
+
+  gint      *ids;
+  guint8    *cnd_types;
+  gint      *cnd_lens;
+  guint32   *cnd_values;
+  GRegex    **regexes;                  /* CC_CND_MATCHES only */
+  cc_xform_t *xforms;
+
+  gchar     *pool;
+  guint32   poolsz;
+
+  /* per domain, the expressions of its live regex rules combined into a
+   * single alternation which rules them all out in one scan, whatever scope
+   * they apply to */
+  GRegex    *prefilters[CC_RULE_C2S + 1];
+
+  /* what the words are split with, NULL for the default grammar and for no
+   * acronyms */
+  cc_grammar_t  *grammar;
+  cc_acronyms_t *acronyms;
+} cc_ruleset_t;
+
+/* the outcome of matching an input of "n" bytes */
+typedef struct {
+  gint        rule;       /* index of the rule */
+  gint        begin;      /* what's left of the input after the removals */
+  gint        end;
+  const gchar *add_prefix;
+  gint        add_prefix_len;
+  const gchar *add_suffix;
+  gint        add_suffix_len;
+} cc_match_t;
+
+#define CC_RULESET_TEST(bits, i) \
+  (((bits)[(i) / CC_RULESET_BITS] >> ((i) % CC_RULESET_BITS)) & 1)
+
+#define CC_RULESET_LIVE(rs, domain, scope) \
+  ((rs)->live + (((domain) - CC_RULE_S2C) * (rs)->nr_scopes + (scope)) * (rs)->nr_words)
+
+/**
+ * Lays out the given rules, which must be compiled and analyzed. The rule
+ * set doesn't refer to them afterwards.
+ *
+ * Scopes are numbered by "scopes", which maps lower case filetype names to
+ * their number and must know every filetype the rules are scoped to. Scope
+ * 0 is no filetype in particular.
+ *
+ * The rule set takes a reference to "grammar" and "acronyms", if any.
+ *
+ * @return a rule set holding one reference, see cc_ruleset_unref()
+ */
+cc_ruleset_t* cc_ruleset_new(const rule_t *rules, GHashTable *scopes, gint nr_scopes,
+                             cc_grammar_t *grammar, cc_acronyms_t *acronyms);
+
+/* references are counted atomically, the last one frees the rule set */
+cc_ruleset_t* cc_ruleset_ref(cc_ruleset_t*);
+void          cc_ruleset_unref(cc_ruleset_t*);
+
+/**
+ * Finds the first live rule of "domain" applying to "scope" whose condition
+ * "in" meets. Scopes the rule set doesn't know of get the unscoped rules.
+ *
+ * @return FALSE if there's none, "match" is left alone then
+ */
+gboolean      cc_ruleset_match(const cc_ruleset_t*, gint domain, gint scope,
+                               const gchar *in, gint n, cc_match_t *match);
+
+#endif
@@ -0,0 +1,399 @@
+/*
+ *  caseconvert_scan.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_scan.h"
+#include "caseconvert_occur.h"
+#include "caseconvert_mem.h"
+#include "caseconvert_trace.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define CC_SCAN_LINE_MAX 200 /* bytes of a hit's line kept for showing */
+
+struct cc_scan_t {
+  gchar       *symbol;
+  gsize       symsz;
+  gchar       *to;
+  gsize       tosz;
+  gchar       *root;
+  GHashTable  *skip;      /* paths => NULL */
+  GSList      *patterns;  /* GPatternSpec, the names looked at */
+  GThread     *walker;
+  GThreadPool *pool;
+  GAsyncQueue *results;   /* cc_scan_file_t */
+  gint        pending;    /* files queued or being worked on, and the walker */
+  gint        cancelled;
+  gint        nr_files;
+};
+
+/* a file for the workers */
+typedef struct {
+  gchar     *path;
+  gboolean  rewrite;
+} job_t;
+
+/* the offset of the next occurrence from "from" on, "textsz" if none */
+static gsize next_hit(const gchar *text, gsize textsz, gsize from,
+                      const gchar *symbol, gsize symsz)
+{
+  const gchar *p = NULL;
+
+  while (from + symsz <= textsz) {
+    if (!(p = memchr(text + from, symbol[0], textsz - from - symsz + 1)))
+      break;
+
+    from = p - text;
+
+    if (memcmp(p, symbol, symsz) == 0
+    && (from == 0 || !CC_OCCUR_IS_WORD_CHAR(text[from-1]))
+    && (from + symsz == textsz || !CC_OCCUR_IS_WORD_CHAR(text[from+symsz])))
+      return from;
+
+    ++from;
+  }
+
+  return textsz;
+}
+
+static gboolean is_eol(gchar c)
+{
+  return c == '\n' || c == '\r';
+}
+
+gint cc_scan_find(const gchar *text, gsize textsz, const gchar *symbol,
+                  gsize symsz, GArray *hits)
+{
+  cc_scan_hit_t hit;
+  gsize         pos, bol = 0, eol, counted = 0;
+  gint          nr_hits = 0, line = 0;
+
+  if (!symsz)
+    return 0;
+
+  for (pos = next_hit(text, textsz, 0, symbol, symsz); pos < textsz;
+       pos = next_hit(text, textsz, pos + symsz, symbol, symsz))
+  {
+    ++nr_hits;
+
+    if (!hits)
+      continue;
+
+    /* the lines up to it, counted from the previous one; "\r\n" is one */
+    for (; counted < pos; ++counted) {
+      if (text[counted] == '\n' || (text[counted] == '\r' && text[counted+1] != '\n')) {
+        ++line;
+        bol = counted + 1;
+      }
+    }
+
+    for (eol = pos; eol < textsz && !is_eol(text[eol]); ++eol);
+
+    hit.line = line;
+    hit.col = pos - bol;
+    hit.text = cc_strndup(CC_MEM_SCAN, text + bol, MIN(eol - bol, CC_SCAN_LINE_MAX));
+    g_array_append_val(hits, hit);
+  }
+
+  return nr_hits;
+}
+
+static cc_scan_file_t* new_file(const gchar *path)
+{
+  cc_scan_file_t *file = cc_malloc0(CC_MEM_SCAN, sizeof(cc_scan_file_t));
+
+  file->path = cc_strdup(CC_MEM_SCAN, path);
+
+  return file;
+}
+
+void cc_scan_free_hits(GArray *hits)
+{
+  guint i;
+
+  for (i = 0; i < hits->len; ++i)
+    cc_free(g_array_index(hits, cc_scan_hit_t, i).text);
+
+  g_array_free(hits, TRUE);
+}
+
+void cc_scan_file_free(cc_scan_file_t *file)
+{
+  if (!file)
+    return;
+
+  if (file->hits)
+    cc_scan_free_hits(file->hits);
+
+  cc_free(file->error);
+  cc_free(file->path);
+  cc_free(file);
+}
+
+/* the symbol's occurrences in a file, NULL if it has none or can't be read */
+static cc_scan_file_t* scan_file(cc_scan_t *scan, const gchar *path)
+{
+  GMappedFile     *map = g_mapped_file_new(path, FALSE, NULL);
+  cc_scan_file_t  *file = NULL;
+  const gchar     *text = NULL;
+  gsize           textsz = 0;
+
+  if (!map)
+    return NULL;
+
+  text = g_mapped_file_get_contents(map);
+  textsz = g_mapped_file_get_length(map);
+
+  /* only files holding it are checked for being binary */
+  if (next_hit(text, textsz, 0, scan->symbol, scan->symsz) < textsz
+  && !memchr(text, '\0', textsz)) {
+    file = new_file(path);
+    file->hits = g_array_new(FALSE, FALSE, sizeof(cc_scan_hit_t));
+    cc_scan_find(text, textsz, scan->symbol, scan->symsz, file->hits);
+  }
+
+  g_mapped_file_unref(map);
+
+  return file;
+}
+
+/* replaces the symbol in a file, which keeps its permissions */
+static cc_scan_file_t* rewrite_file(cc_scan_t *scan, const gchar *path)
+{
+  GMappedFile     *map = NULL;
+  GError          *err = NULL;
+  GString         *out = NULL;
+  cc_scan_file_t  *file = new_file(path);
+  const gchar     *text = NULL;
+  gsize           textsz = 0, pos, from = 0;
+  struct stat     st;
+
+  file->rewritten = TRUE;
+
+  if (g_stat(path, &st) != 0 || !(map = g_mapped_file_new(path, FALSE, &err))) {
+    file->error = cc_strdup(CC_MEM_SCAN, err ? err->message : "unable to stat");
+    if (err)
+      g_error_free(err);
+    return file;
+  }
+
+  text = g_mapped_file_get_contents(map);
+  textsz = g_mapped_file_get_length(map);
+
+  /* it may have changed since it was scanned, whatever it holds now goes */
+  if (textsz && !memchr(text, '\0', textsz)) {
+    for (pos = next_hit(text, textsz, 0, scan->symbol, scan->symsz); pos < textsz;
+         pos = next_hit(text, textsz, from, scan->symbol, scan->symsz))
+    {
+      if (!out)
+        out = g_string_sized_new(textsz + 64);
+
+      g_string_append_len(out, text + from, pos - from);
+      g_string_append_len(out, scan->to, scan->tosz);
+      from = pos + scan->symsz;
+      ++file->nr_replaced;
+    }
+
+    if (out)
+      g_string_append_len(out, text + from, textsz - from);
+  }
+
+  g_mapped_file_unref(map);
+
+  if (out) {
+    if (!g_file_set_contents(path, out->str, out->len, &err)) {
+      file->error = cc_strdup(CC_MEM_SCAN, err->message);
+      file->nr_replaced = 0;
+      g_error_free(err);
+    }
+    else if (g_chmod(path, st.st_mode & 07777) != 0)
+      cc_warn("WARN: unable to restore the permissions of '%s'\n", path);
+
+    g_string_free(out, TRUE);
+  }
+
+  return file;
+}
+
+static void work(gpointer data, gpointer user_data)
+{
+  cc_scan_t       *scan = user_data;
+  job_t           *job = data;
+  cc_scan_file_t  *file = NULL;
+
+  if (!g_atomic_int_get(&scan->cancelled)) {
+    file = job->rewrite ? rewrite_file(scan, job->path) : scan_file(scan, job->path);
+    g_atomic_int_inc(&scan->nr_files);
+  }
+
+  /* handed back before it stops counting, see cc_scan_busy() */
+  if (file)
+    g_async_queue_push(scan->results, file);
+
+  g_atomic_int_add(&scan->pending, -1);
+
+  cc_free(job->path);
+  cc_free(job);
+}
+
+static void push_job(cc_scan_t *scan, const gchar *path, gboolean rewrite)
+{
+  job_t *job = cc_malloc(CC_MEM_SCAN, sizeof(job_t));
+
+  job->path = cc_strdup(CC_MEM_SCAN, path);
+  job->rewrite = rewrite;
+
+  g_atomic_int_inc(&scan->pending);
+  g_thread_pool_push(scan->pool, job, NULL);
+}
+
+static gboolean wanted(cc_scan_t *scan, const gchar *name, const gchar *path)
+{
+  GSList *p = NULL;
+
+  if (g_hash_table_lookup_extended(scan->skip, path, NULL, NULL))
+    return FALSE;
+
+  for (p = scan->patterns; p; p = p->next)
+    if (g_pattern_match_string(p->data, name))
+      return TRUE;
+
+  return scan->patterns == NULL;
+}
+
+/* hands every file under "dir" to the workers */
+static void walk(cc_scan_t *scan, const gchar *dir)
+{
+  GDir        *d = g_dir_open(dir, 0, NULL);
+  const gchar *name = NULL;
+  gchar       *path = NULL;
+  struct stat st;
+
+  if (!d)
+    return;
+
+  while (!g_atomic_int_get(&scan->cancelled) && (name = g_dir_read_name(d)) != NULL) {
+    if (name[0] == '.')
+      continue;
+
+    path = g_build_filename(dir, name, NULL);
+
+    /* links are neither, so they're never followed into loops */
+    if (g_lstat(path, &st) == 0) {
+      if (S_ISDIR(st.st_mode))
+        walk(scan, path);
+      else if (S_ISREG(st.st_mode) && wanted(scan, name, path))
+        push_job(scan, path, FALSE);
+    }
+
+    g_free(path);
+  }
+
+  g_dir_close(d);
+}
+
+static gpointer walker(gpointer data)
+{
+  cc_scan_t *scan = data;
+
+  walk(scan, scan->root);
+  g_atomic_int_add(&scan->pending, -1);
+
+  return NULL;
+}
+
+cc_scan_t* cc_scan_new(const gchar *symbol, const gchar *to, gint nr_threads)
+{
+  cc_scan_t *scan = cc_malloc0(CC_MEM_SCAN, sizeof(cc_scan_t));
+
+  scan->symbol = cc_strdup(CC_MEM_SCAN, symbol);
+  scan->symsz = strlen(symbol);
+  scan->to = cc_strdup(CC_MEM_SCAN, to);
+  scan->tosz = strlen(to);
+  scan->skip = g_hash_table_new_full(g_str_hash, g_str_equal, cc_free, NULL);
+  scan->results = g_async_queue_new();
+  scan->pool = g_thread_pool_new(work, scan, MAX(nr_threads, 1), FALSE, NULL);
+
+  return scan;
+}
+
+void cc_scan_free(cc_scan_t *scan)
+{
+  cc_scan_file_t *file = NULL;
+
+  if (!scan)
+    return;
+
+  g_atomic_int_set(&scan->cancelled, 1);
+
+  if (scan->walker)
+    g_thread_join(scan->walker);
+
+  /* the jobs left see it's cancelled and just go */
+  g_thread_pool_free(scan->pool, FALSE, TRUE);
+
+  while ((file = g_async_queue_try_pop(scan->results)) != NULL)
+    cc_scan_file_free(file);
+
+  g_async_queue_unref(scan->results);
+  g_hash_table_destroy(scan->skip);
+  for (; scan->patterns; scan->patterns = g_slist_delete_link(scan->patterns, scan->patterns))
+    g_pattern_spec_free(scan->patterns->data);
+  cc_free(scan->root);
+  cc_free(scan->symbol);
+  cc_free(scan->to);
+  cc_free(scan);
+}
+
+void cc_scan_skip(cc_scan_t *scan, const gchar *path)
+{
+  g_hash_table_insert(scan->skip, cc_strdup(CC_MEM_SCAN, path), NULL);
+}
+
+void cc_scan_start(cc_scan_t *scan, const gchar *root, gchar **patterns)
+{
+  g_return_if_fail(scan->walker == NULL);
+
+  for (; patterns && *patterns; ++patterns)
+    if (**patterns)
+      scan->patterns = g_slist_prepend(scan->patterns, g_pattern_spec_new(*patterns));
+
+  scan->root = cc_strdup(CC_MEM_SCAN, root);
+  g_atomic_int_inc(&scan->pending);
+  scan->walker = g_thread_new("caseconvert-scan", walker, scan);
+}
+
+void cc_scan_rewrite(cc_scan_t *scan, const gchar *path)
+{
+  push_job(scan, path, TRUE);
+}
+
+cc_scan_file_t* cc_scan_pop(cc_scan_t *scan)
+{
+  return g_async_queue_try_pop(scan->results);
+}
+
+gboolean cc_scan_busy(cc_scan_t *scan)
+{
+  return g_atomic_int_get(&scan->pending) > 0;
+}
+
+gint cc_scan_nr_files(cc_scan_t *scan)
+{
+  return g_atomic_int_get(&scan->nr_files);
+}
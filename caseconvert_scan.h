@@ -0,0 +1,104 @@
+/*
+ *  caseconvert_scan.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_SCAN_H
+#define H_GEANY_CASE_CONVERT_SCAN_H
+
+#include <glib.h>
+
+/*
+ * Renames a symbol across a tree of files, off the main thread.
+ *
+ * A walker thread lists the files under the root and hands them to a pool
+ * of workers, which map each one and look for the symbol as a whole word
+ * (see CC_OCCUR_IS_WORD_CHAR), case sensitively. The files it occurs in are
+ * handed back as they're found, for the caller to pick up from its own
+ * thread; so are the files it's asked to rewrite afterwards:
+ *
+ *  scan = cc_scan_new("fooBar", "foo_bar", CC_SCAN_THREADS);
+ *  cc_scan_skip(scan, "/project/open.c");
+ *  cc_scan_start(scan, "/project", NULL);
+ *  ... then, polling:
+ *  while ((file = cc_scan_pop(scan)) != NULL)
+ *    ... file->hits ...
+ *  if (!cc_scan_busy(scan))
+ *    ... done, cc_scan_rewrite() the files wanted and poll again ...
+ *
+ * Hidden entries, symbolic links and files holding NULs aren't looked at.
+ * Neither are the skipped ones, which the caller edits itself (ie, those
+ * open in the editor). Doesn't call into Geany.
+ */
+
+#define CC_SCAN_THREADS 8
+
+typedef struct cc_scan_t cc_scan_t;
+
+typedef struct {
+  gint  line;   /* 0 based */
+  gint  col;    /* in bytes */
+  gchar *text;  /* the line it's on, as read */
+} cc_scan_hit_t;
+
+typedef struct {
+  gchar     *path;
+  GArray    *hits;          /* cc_scan_hit_t, for the files scanned */
+  gboolean  rewritten;      /* whether this is the result of cc_scan_rewrite() */
+  gint      nr_replaced;    /* for those, the occurrences replaced */
+  gchar     *error;         /* why it couldn't be rewritten, if it couldn't */
+} cc_scan_file_t;
+
+cc_scan_t*      cc_scan_new(const gchar *symbol, const gchar *to, gint nr_threads);
+
+/* cancels whatever is still running and waits for it */
+void            cc_scan_free(cc_scan_t *scan);
+
+/* leaves a file out, must be called before cc_scan_start() */
+void            cc_scan_skip(cc_scan_t *scan, const gchar *path);
+
+/* starts looking for the symbol in the files under "root", those whose
+ * name matches one of the glob "patterns" if any are given */
+void            cc_scan_start(cc_scan_t *scan, const gchar *root, gchar **patterns);
+
+/* replaces the symbol in a file, through a temporary file */
+void            cc_scan_rewrite(cc_scan_t *scan, const gchar *path);
+
+/* the next file handed back, NULL if none is ready */
+cc_scan_file_t* cc_scan_pop(cc_scan_t *scan);
+void            cc_scan_file_free(cc_scan_file_t *file);
+
+/* whether files are still being walked, scanned or rewritten; once it
+ * isn't, whatever was handed back can be popped */
+gboolean        cc_scan_busy(cc_scan_t *scan);
+
+/* the number of files looked at so far */
+gint            cc_scan_nr_files(cc_scan_t *scan);
+
+/**
+ * Finds the symbol in a text, as the workers do.
+ *
+ * @return the number of occurrences, appended to "hits" (cc_scan_hit_t) if
+ * given
+ */
+gint            cc_scan_find(const gchar *text, gsize textsz, const gchar *symbol,
+                             gsize symsz, GArray *hits);
+
+/* frees the hits cc_scan_find() appended, and the array */
+void            cc_scan_free_hits(GArray *hits);
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ *  caseconvert_search.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_search.h"
+#include "caseconvert_mem.h"
+#include <string.h>
+
+typedef struct {
+  gchar     *text;  /* lower cased, fields separated by '\n' */
+  gboolean  seen;   /* set since the last sweep */
+} entry_t;
+
+struct cc_search_t {
+  GHashTable  *entries;   /* rule id => entry_t */
+  GHashTable  *postings;  /* trigram => set of rule ids */
+};
+
+/* trigrams are packed into an int, the text never has a NUL so a trigram
+ * is never 0 */
+#define TRIGRAM(p) \
+  GUINT_TO_POINTER(((guint)(guchar)(p)[0] << 16) | ((guint)(guchar)(p)[1] << 8) | (guint)(guchar)(p)[2])
+
+static void free_entry(gpointer data)
+{
+  entry_t *entry = data;
+
+  cc_free(entry->text);
+  cc_free(entry);
+}
+
+cc_search_t* cc_search_new(void)
+{
+  cc_search_t *index = cc_malloc(CC_MEM_UI, sizeof(cc_search_t));
+
+  index->entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_entry);
+  index->postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+    (GDestroyNotify)g_hash_table_destroy);
+
+  return index;
+}
+
+void cc_search_free(cc_search_t *index)
+{
+  if (!index)
+    return;
+
+  g_hash_table_destroy(index->entries);
+  g_hash_table_destroy(index->postings);
+  cc_free(index);
+}
+
+/* adds or removes the rule from the postings of every trigram of "text" */
+static void post(cc_search_t *index, gint id, const gchar *text, gboolean add)
+{
+  GHashTable  *ids = NULL;
+  gsize       len = strlen(text), i;
+
+  for (i = 0; i + 3 <= len; ++i)
+  {
+    /* trigrams don't cross fields */
+    if (text[i] == '\n' || text[i+1] == '\n' || text[i+2] == '\n')
+      continue;
+
+    ids = g_hash_table_lookup(index->postings, TRIGRAM(text + i));
+
+    if (add) {
+      if (!ids) {
+        ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_insert(index->postings, TRIGRAM(text + i), ids);
+      }
+
+      g_hash_table_insert(ids, GINT_TO_POINTER(id), GINT_TO_POINTER(id));
+    }
+    else if (ids) {
+      g_hash_table_remove(ids, GINT_TO_POINTER(id));
+
+      if (!g_hash_table_size(ids))
+        g_hash_table_remove(index->postings, TRIGRAM(text + i));
+    }
+  }
+}
+
+/* what a rule is found by */
+static gchar* rule_text(const rule_t *rule, const gchar *label)
+{
+  GString   *text = g_string_sized_new(64);
+  action_t  *act = NULL;
+  gchar     *out = NULL, *c = NULL;
+
+  g_string_append(text, label ? label : rule->label ? rule->label : "Unlabelled");
+  g_string_append_c(text, '\n');
+
+  if (rule->condition && rule->condition->value) {
+    g_string_append(text, rule->condition->value);
+    g_string_append_c(text, '\n');
+  }
+
+  for (act = rule->actions; act != NULL; act = act->next) {
+    if (act->value && *act->value) {
+      g_string_append(text, act->value);
+      g_string_append_c(text, '\n');
+    }
+  }
+
+  if (rule->filetypes) {
+    g_string_append(text, rule->filetypes);
+    g_string_append_c(text, '\n');
+  }
+
+  g_string_append(text, rule->domain == CC_RULE_C2S ? "camelToSnake c2s" : "snake_to_camel s2c");
+
+  out = cc_strndup(CC_MEM_UI, text->str, text->len);
+  g_string_free(text, TRUE);
+
+  for (c = out; *c; ++c)
+    *c = g_ascii_tolower(*c);
+
+  return out;
+}
+
+void cc_search_set_rule(cc_search_t *index, const rule_t *rule, const gchar *label)
+{
+  entry_t *entry = g_hash_table_lookup(index->entries, GINT_TO_POINTER(rule->id));
+  gchar   *text = rule_text(rule, label);
+
+  if (entry) {
+    entry->seen = TRUE;
+
+    /* as it was */
+    if (strcmp(entry->text, text) == 0) {
+      cc_free(text);
+      return;
+    }
+
+    post(index, rule->id, entry->text, FALSE);
+    cc_free(entry->text);
+  }
+  else {
+    entry = cc_malloc(CC_MEM_UI, sizeof(entry_t));
+    entry->seen = TRUE;
+    g_hash_table_insert(index->entries, GINT_TO_POINTER(rule->id), entry);
+  }
+
+  entry->text = text;
+  post(index, rule->id, text, TRUE);
+}
+
+void cc_search_remove(cc_search_t *index, gint id)
+{
+  entry_t *entry = g_hash_table_lookup(index->entries, GINT_TO_POINTER(id));
+
+  if (!entry)
+    return;
+
+  post(index, id, entry->text, FALSE);
+  g_hash_table_remove(index->entries, GINT_TO_POINTER(id));
+}
+
+void cc_search_sweep(cc_search_t *index)
+{
+  GHashTableIter  iter;
+  gpointer        id, data;
+  entry_t         *entry = NULL;
+
+  g_hash_table_iter_init(&iter, index->entries);
+
+  while (g_hash_table_iter_next(&iter, &id, &data)) {
+    entry = data;
+
+    if (entry->seen) {
+      entry->seen = FALSE;
+      continue;
+    }
+
+    post(index, GPOINTER_TO_INT(id), entry->text, FALSE);
+    g_hash_table_iter_remove(&iter);
+  }
+}
+
+/* whether the entry has every term */
+static gboolean has_terms(const entry_t *entry, gchar **terms)
+{
+  for (; *terms; ++terms)
+    if (**terms && !strstr(entry->text, *terms))
+      return FALSE;
+
+  return TRUE;
+}
+
+GHashTable* cc_search_query(cc_search_t *index, const gchar *query)
+{
+  GHashTable      *hits = NULL;
+  GHashTable      *rarest = NULL, *ids = NULL;
+  GPtrArray       *postings = g_ptr_array_new();
+  gchar           *q = g_ascii_strdown(query, -1);
+  gchar           **terms = g_strsplit_set(g_strstrip(q), " \t", -1);
+  GHashTableIter  iter;
+  gpointer        id, data;
+  gchar           **t = NULL;
+  gsize           i, len;
+  guint           j;
+  gboolean        missing = FALSE;
+
+  g_free(q);
+
+  if (!terms[0]) {
+    g_strfreev(terms);
+    g_ptr_array_free(postings, TRUE);
+    return NULL;
+  }
+
+  hits = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  /* the postings of every trigram of the terms, and the rarest one */
+  for (t = terms; *t && !missing; ++t)
+  {
+    for (i = 0, len = strlen(*t); i + 3 <= len && !missing; ++i)
+    {
+      ids = g_hash_table_lookup(index->postings, TRIGRAM(*t + i));
+
+      /* no rule has it */
+      if (!(missing = !ids))
+        g_ptr_array_add(postings, ids);
+
+      if (ids && (!rarest || g_hash_table_size(ids) < g_hash_table_size(rarest)))
+        rarest = ids;
+    }
+  }
+
+  /* terms too short for a trigram have to be looked for everywhere */
+  g_hash_table_iter_init(&iter, rarest ? rarest : index->entries);
+
+  while (!missing && g_hash_table_iter_next(&iter, &id, &data))
+  {
+    for (j = 0; j < postings->len; ++j)
+      if (postings->pdata[j] != rarest && !g_hash_table_contains(postings->pdata[j], id))
+        break;
+
+    if (j < postings->len)
+      continue;
+
+    if (has_terms(g_hash_table_lookup(index->entries, id), terms))
+      g_hash_table_insert(hits, id, id);
+  }
+
+  g_ptr_array_free(postings, TRUE);
+  g_strfreev(terms);
+
+  return hits;
+}
@@ -0,0 +1,65 @@
+/*
+ *  caseconvert_search.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_SEARCH_H
+#define H_GEANY_CASE_CONVERT_SEARCH_H
+
+#include <glib.h>
+#include "caseconvert_types.h"
+
+/*
+ * A trigram index over the rules, for filtering them as the user types.
+ *
+ * Every rule is indexed by its label, condition value, action values,
+ * filetypes and domain ("snake_to_camel s2c" or "camelToSnake c2s"), case
+ * insensitively. Each trigram of that text maps to the set of rules that
+ * have it, so a query only looks at the rules having its least common
+ * trigram, keeps those having the others too and checks them for the
+ * actual text. Terms shorter than a trigram are looked for in every rule.
+ *
+ * The index is kept up to date rule by rule: cc_search_set_rule() only
+ * reindexes a rule whose text changed, and cc_search_sweep() drops the
+ * rules that weren't set since the previous sweep, ie those removed:
+ *
+ *  for (rule = cc_get_rules(); rule; rule = rule->next)
+ *    cc_search_set_rule(index, rule, NULL);
+ *  cc_search_sweep(index);
+ */
+
+typedef struct cc_search_t cc_search_t;
+
+cc_search_t*  cc_search_new(void);
+void          cc_search_free(cc_search_t *index);
+
+/* (re)indexes a rule, under "label" instead of its own if given */
+void          cc_search_set_rule(cc_search_t *index, const rule_t *rule, const gchar *label);
+void          cc_search_remove(cc_search_t *index, gint id);
+
+/* removes the rules not set since the last sweep */
+void          cc_search_sweep(cc_search_t *index);
+
+/**
+ * Finds the rules matching every whitespace separated term of "query".
+ *
+ * @return the set of matching rule ids, or NULL if the query is empty and
+ * so matches every rule; destroy it with g_hash_table_destroy()
+ */
+GHashTable*   cc_search_query(cc_search_t *index, const gchar *query);
+
+#endif
@@ -0,0 +1,1565 @@
+/*
+ *  caseconvert_tool.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * caseconvert-tool: drives the conversion engine outside of Geany.
+ *
+ *  caseconvert-tool replay [-v] <trace>
+ *    replays a trace recorded by the plugin (see caseconvert_record.h) and
+ *    reports how long every operation took
+ *
+ *  caseconvert-tool stress [threads] [edits]
+ *    converts from worker threads while the main thread keeps editing the
+ *    rules the way the dialogs do, and checks that no conversion ever sees
+ *    a rule set that wasn't published as a whole
+ *
+ *  caseconvert-tool import <pack> [out]
+ *    imports a rule pack (see cc_import_rules()) and reports how long it
+ *    took, then exports the rules into "out" if given
+ *
+ *  caseconvert-tool search <pack> <query>
+ *    indexes the rules of a pack the way the Edit Rules filter does, then
+ *    types the query in one keystroke at a time and reports how long every
+ *    keystroke took to filter the rules, and how many it matched
+ *
+ *  caseconvert-tool occur <file> [edits]
+ *    indexes the identifiers of a file the way the plugin indexes documents
+ *    (see caseconvert_occur.h), makes random edits to it updating the index
+ *    as they go, then checks it against one built from scratch and compares
+ *    looking identifiers up to scanning the text for them
+ *
+ *  caseconvert-tool bulk <file> [pack]
+ *    converts every name of a file, with the rules of "pack" if given, once
+ *    per occurrence and then through a plan (see caseconvert_plan.h) on a
+ *    single thread and on several, checks they agree and reports how long
+ *    each took; then checks the plan's diff against the text before and
+ *    after, and applies it the way the editor would, reporting the undo
+ *    history each way of applying it is estimated to take
+ *
+ *  caseconvert-tool scan <dir> <symbol> [to]
+ *    looks for a symbol in every file under a directory the way the project
+ *    wide conversion does (see caseconvert_scan.h), on a single thread then
+ *    on the pool, and reports how long each took; with "to" the files it's
+ *    found in are then rewritten with it instead
+ *
+ *  caseconvert-tool map [-w] [-f] [-i] <map> <file>...
+ *    replaces the names of a map file (see caseconvert_map.h) in the files,
+ *    in a single pass each, printing the changes as a diff or, with -i,
+ *    rewriting the files; -w only matches whole words, -f converts the names
+ *    not in the map by the rules
+ *
+ *  caseconvert-tool check
+ *    checks the engine against known conversions, without any rules, that
+ *    rules which can't apply are found out, that the document index leaves
+ *    what it can't find to a search of the text, that maps pick the names
+ *    they replace as documented and their edits are made the way they're
+ *    estimated, that merged rules are saved with the ids they were given,
+ *    and that conversions keep to their allocation budgets
+ */
+
+#include "caseconvert_engine.h"
+#include "caseconvert_record.h"
+#include "caseconvert_search.h"
+#include "caseconvert_occur.h"
+#include "caseconvert_scan.h"
+#include "caseconvert_plan.h"
+#include "caseconvert_map.h"
+#include "caseconvert_words.h"
+#include <glib/gprintf.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Scintilla's search flags, as recorded by cc_convert_range() */
+#define SCFIND_WHOLEWORD  2
+#define SCFIND_MATCHCASE  4
+#define SCFIND_WORDSTART  0x00100000
+
+typedef struct {
+  guint   count;
+  gint64  total;
+  gint64  max;
+} op_stats_t;
+
+static const gchar *op_names[CC_REC_COUNT] = {
+  NULL,
+  "rules",
+  "selection",
+  "range"
+};
+
+static gboolean is_word_char(gchar c)
+{
+  return isalnum((guchar)c) || c == '_';
+}
+
+/* whether "needle" occurs at "pos" in "hay" honoring the search flags */
+static gboolean matches_at(const gchar *hay, gint haysz, gint pos,
+                           const gchar *needle, gint needlesz, gint flags)
+{
+  if (flags & SCFIND_MATCHCASE) {
+    if (strncmp(hay + pos, needle, needlesz) != 0)
+      return FALSE;
+  }
+  else if (g_ascii_strncasecmp(hay + pos, needle, needlesz) != 0)
+    return FALSE;
+
+  if ((flags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART)) && pos > 0 && is_word_char(hay[pos-1]))
+    return FALSE;
+
+  if ((flags & SCFIND_WHOLEWORD) && pos + needlesz < haysz && is_word_char(hay[pos+needlesz]))
+    return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * Replays a range conversion: converts the text, then replaces every hit in
+ * the recorded range the way SCI_SEARCHINTARGET/SCI_REPLACETARGET would.
+ *
+ * @return the number of hits, or -1 if the text couldn't be converted
+ */
+static gint replay_range(const cc_rec_t *rec)
+{
+  GString *doc = NULL;
+  gchar   *repl = NULL;
+  gint    replsz = 0;
+  gint    pos = 0;
+  gint    nr_hits = 0;
+
+  repl = cc_convert_text(rec->txt, rec->size, &replsz);
+  if (!repl)
+    return -1;
+
+  if (rec->txtsz == 0) {
+    cc_free(repl);
+    return 0;
+  }
+
+  doc = g_string_new_len(rec->range, rec->rangesz);
+  replsz = strlen(repl);
+
+  while (pos + rec->txtsz <= (gint)doc->len) {
+    if (matches_at(doc->str, doc->len, pos, rec->txt, rec->txtsz, rec->flags)) {
+      g_string_erase(doc, pos, rec->txtsz);
+      g_string_insert_len(doc, pos, repl, replsz);
+      pos += replsz;
+      ++nr_hits;
+    }
+    else
+      ++pos;
+  }
+
+  g_string_free(doc, TRUE);
+  cc_free(repl);
+
+  return nr_hits;
+}
+
+static int replay(const gchar *path, gboolean verbose)
+{
+  cc_rec_reader_t *reader = NULL;
+  cc_rec_t        rec;
+  op_stats_t      stats[CC_REC_COUNT];
+  gint64          t0 = 0, dt = 0;
+  gint            result = 0;
+  guint           nr_ops = 0;
+  gint            i;
+
+  reader = cc_rec_reader_open(path);
+  if (!reader) {
+    g_fprintf(stderr, "caseconvert-tool: unable to read trace '%s'\n", path);
+    return 1;
+  }
+
+  memset(stats, 0, sizeof(stats));
+
+  while (cc_rec_read(reader, &rec)) {
+    t0 = g_get_monotonic_time();
+
+    switch (rec.op)
+    {
+      case CC_REC_RULES:
+        cc_clear_rules();
+        cc_get_config()->capitalize = rec.flags;
+        cc_set_acronyms(rec.acronyms);
+        cc_set_boundaries(rec.boundaries);
+        result = cc_parse_rules(rec.txt);
+      break;
+
+      case CC_REC_SELECTION:
+      {
+        gint  outsz = 0;
+        gchar *out = cc_convert_text(rec.txt, rec.size, &outsz);
+
+        result = out ? outsz : -1;
+        cc_free(out);
+      }
+      break;
+
+      case CC_REC_RANGE:
+        result = replay_range(&rec);
+      break;
+
+      default:
+      break;
+    }
+
+    dt = g_get_monotonic_time() - t0;
+
+    stats[rec.op].count++;
+    stats[rec.op].total += dt;
+    stats[rec.op].max = MAX(stats[rec.op].max, dt);
+    ++nr_ops;
+
+    if (verbose) {
+      g_printf("%6u %-10s %8.0fus size=%d result=%d '%s'\n",
+        nr_ops, op_names[rec.op], (gdouble)dt, rec.op == CC_REC_RANGE ? rec.rangesz : rec.txtsz,
+        result, rec.op == CC_REC_RULES ? "" : rec.txt);
+    }
+  }
+
+  cc_rec_reader_close(reader);
+  cc_clear_rules();
+  cc_set_acronyms(NULL);
+  cc_set_boundaries(NULL);
+
+  g_printf("%-10s %8s %12s %10s %10s\n", "op", "count", "total (us)", "mean (us)", "max (us)");
+
+  for (i = CC_REC_RULES; i < CC_REC_COUNT; ++i) {
+    if (!stats[i].count)
+      continue;
+
+    g_printf("%-10s %8u %12.0f %10.2f %10.0f\n",
+      op_names[i], stats[i].count, (gdouble)stats[i].total,
+      (gdouble)stats[i].total / stats[i].count, (gdouble)stats[i].max);
+  }
+
+  return 0;
+}
+
+/* stress: every rule set the editor publishes is one of these, with the
+ * first rule enabled or not, so any conversion must yield what one of them
+ * yields; every %d is the state */
+#define STRESS_STATES 4
+
+static const gchar *stress_rules =
+  "[1,Getter,1,1,1,p%d_,2,p%d_,1,get%d][2,Type,1,2,2,V%d,4,V%d,3,_t%d]";
+
+typedef struct {
+  gchar       **inputs;
+  GHashTable  **valid;      /* per input, the results it may convert to */
+  guint       conversions;
+  guint       failures;
+} stress_worker_t;
+
+static volatile gint stress_done = 0;
+
+static void stress_load(gint state, gboolean enabled)
+{
+  gchar *defs = g_strdup_printf(stress_rules, state, state, state, state, state, state);
+
+  cc_clear_rules();
+  cc_parse_rules(defs);
+  g_free(defs);
+
+  if (!enabled) {
+    cc_get_rules()->enabled = FALSE;
+    cc_rules_changed();
+  }
+}
+
+static gpointer stress_convert(gpointer data)
+{
+  stress_worker_t *w = data;
+  gchar           *out = NULL;
+  gint            outsz = 0;
+  gint            i;
+
+  while (!g_atomic_int_get(&stress_done)) {
+    for (i = 0; w->inputs[i]; ++i) {
+      out = cc_convert_text(w->inputs[i], strlen(w->inputs[i]), &outsz);
+
+      if (!g_hash_table_lookup(w->valid[i], out ? out : "")) {
+        if (w->failures++ < 10)
+          g_fprintf(stderr, "caseconvert-tool: '%s' converted to unexpected '%s'\n",
+            w->inputs[i], out ? out : "(null)");
+      }
+
+      cc_free(out);
+      ++w->conversions;
+    }
+  }
+
+  return NULL;
+}
+
+static int stress(gint nr_threads, gint nr_edits)
+{
+  stress_worker_t *workers = g_new0(stress_worker_t, nr_threads);
+  GThread         **threads = g_new0(GThread*, nr_threads);
+  gchar           **inputs = g_new0(gchar*, STRESS_STATES * 2 + 1);
+  GHashTable      **valid = g_new0(GHashTable*, STRESS_STATES * 2);
+  cc_mem_stats_t  mem;
+  guint           conversions = 0, failures = 0;
+  gint64          t0 = 0;
+  gint            state, enabled, i, e;
+
+  for (i = 0; i < STRESS_STATES; ++i) {
+    inputs[i * 2] = g_strdup_printf("p%d_foo_bar", i);
+    inputs[i * 2 + 1] = g_strdup_printf("fooBarV%d", i);
+  }
+
+  /* what every input converts to under every state */
+  for (i = 0; inputs[i]; ++i)
+    valid[i] = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (state = 0; state < STRESS_STATES; ++state) {
+    for (enabled = 0; enabled < 2; ++enabled) {
+      stress_load(state, enabled);
+
+      for (i = 0; inputs[i]; ++i) {
+        gint  outsz = 0;
+        gchar *out = cc_convert_text(inputs[i], strlen(inputs[i]), &outsz);
+
+        g_hash_table_insert(valid[i], g_strdup(out ? out : ""), GINT_TO_POINTER(1));
+        cc_free(out);
+      }
+    }
+  }
+
+  t0 = g_get_monotonic_time();
+
+  for (i = 0; i < nr_threads; ++i) {
+    workers[i].inputs = inputs;
+    workers[i].valid = valid;
+    threads[i] = g_thread_new("stress", stress_convert, &workers[i]);
+  }
+
+  /* reload the rules or edit them in place, as the dialogs would */
+  for (e = 0; e < nr_edits; ++e) {
+    if (e % 2)
+      stress_load(e % STRESS_STATES, TRUE);
+    else {
+      cc_get_rules()->enabled = !cc_get_rules()->enabled;
+      cc_rules_changed();
+    }
+  }
+
+  g_atomic_int_set(&stress_done, 1);
+
+  for (i = 0; i < nr_threads; ++i) {
+    g_thread_join(threads[i]);
+    conversions += workers[i].conversions;
+    failures += workers[i].failures;
+  }
+
+  g_printf("%u conversions on %d threads during %d edits in %.0fms, %u unexpected\n",
+    conversions, nr_threads, nr_edits, (gdouble)(g_get_monotonic_time() - t0) / 1000, failures);
+
+  /* every rule set must have been released by now */
+  cc_clear_rules();
+  cc_mem_get_stats(CC_MEM_RULES, &mem);
+
+  if (mem.live) {
+    g_fprintf(stderr, "caseconvert-tool: %d rule blocks leaked\n", mem.live);
+    ++failures;
+  }
+
+  for (i = 0; inputs[i]; ++i)
+    g_hash_table_destroy(valid[i]);
+
+  g_strfreev(inputs);
+  g_free(valid);
+  g_free(threads);
+  g_free(workers);
+
+  return failures ? 1 : 0;
+}
+
+static int import(const gchar *path, const gchar *out)
+{
+  gchar   *problem = NULL;
+  gint    nr_rules = 0;
+  gint64  t0 = g_get_monotonic_time();
+
+  nr_rules = cc_import_rules(path, &problem);
+
+  if (nr_rules < 0) {
+    g_fprintf(stderr, "caseconvert-tool: nothing imported from '%s', %s\n", path, problem);
+    g_free(problem);
+    return 1;
+  }
+
+  g_printf("%d rules imported in %.2fms\n", nr_rules, (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+  if (out && !cc_export_rules(out, &nr_rules))
+    return 1;
+
+  cc_clear_rules();
+
+  return 0;
+}
+
+static int search(const gchar *path, const gchar *query)
+{
+  cc_search_t *index = NULL;
+  GHashTable  *hits = NULL;
+  rule_t      *rule = NULL;
+  gchar       *problem = NULL;
+  gchar       *typed = NULL;
+  gint64      t0 = 0;
+  gsize       i;
+
+  if (cc_import_rules(path, &problem) < 0) {
+    g_fprintf(stderr, "caseconvert-tool: nothing imported from '%s', %s\n", path, problem);
+    g_free(problem);
+    return 1;
+  }
+
+  t0 = g_get_monotonic_time();
+  index = cc_search_new();
+
+  for (rule = cc_get_rules(); rule != NULL; rule = rule->next)
+    cc_search_set_rule(index, rule, NULL);
+
+  cc_search_sweep(index);
+
+  g_printf("indexed the rules in %.2fms\n", (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+  for (i = 1; i <= strlen(query); ++i) {
+    typed = g_strndup(query, i);
+
+    t0 = g_get_monotonic_time();
+    hits = cc_search_query(index, typed);
+
+    g_printf("%8.3fms %6d '%s'\n", (gdouble)(g_get_monotonic_time() - t0) / 1000,
+      hits ? (gint)g_hash_table_size(hits) : -1, typed);
+
+    if (hits)
+      g_hash_table_destroy(hits);
+
+    g_free(typed);
+  }
+
+  cc_search_free(index);
+  cc_clear_rules();
+
+  return 0;
+}
+
+/* lines [first, last] joined back */
+static gchar* join_lines(GPtrArray *lines, guint first, guint last)
+{
+  GString *text = g_string_new(NULL);
+  guint   i;
+
+  for (i = first; i <= last; ++i) {
+    g_string_append(text, g_ptr_array_index(lines, i));
+    if (i < last)
+      g_string_append_c(text, '\n');
+  }
+
+  return g_string_free(text, FALSE);
+}
+
+/*
+ * Replaces "len" bytes at column "col" of line "line" with "ins", keeping
+ * the index in step the way on_editor_notify() does.
+ *
+ * @return how long updating the index took
+ */
+static gint64 edit(cc_occur_t *index, GPtrArray *lines, guint line, gsize col, gsize len,
+                   const gchar *ins)
+{
+  GString *text = NULL;
+  gchar   *old = NULL, **parts = NULL;
+  gsize   left = len, linesz;
+  guint   last = line, nr_parts, i;
+  gint64  t0, dt = 0;
+
+  /* the lines the edit touches */
+  while ((linesz = strlen(g_ptr_array_index(lines, last)) - (last == line ? col : 0)) < left
+         && last + 1 < lines->len) {
+    left -= linesz + 1;
+    ++last;
+  }
+
+  old = join_lines(lines, line, last);
+
+  t0 = g_get_monotonic_time();
+  cc_occur_remove_text(index, old, strlen(old), line);
+  dt += g_get_monotonic_time() - t0;
+
+  text = g_string_new(old);
+  g_string_erase(text, col, MIN(len, text->len - col));
+  g_string_insert(text, col, ins);
+
+  /* the lines it leaves in their place, at least an empty one */
+  parts = g_strsplit(text->str, "\n", -1);
+  if (!(nr_parts = g_strv_length(parts))) {
+    g_strfreev(parts);
+    parts = g_new0(gchar*, 2);
+    parts[0] = g_strdup("");
+    nr_parts = 1;
+  }
+
+  for (i = line; i <= last; ++i)
+    g_free(g_ptr_array_index(lines, i));
+  g_ptr_array_remove_range(lines, line, last - line + 1);
+
+  for (i = 0; i < nr_parts; ++i)
+    g_ptr_array_add(lines, NULL);
+  memmove(lines->pdata + line + nr_parts, lines->pdata + line,
+    sizeof(gpointer) * (lines->len - nr_parts - line));
+  for (i = 0; i < nr_parts; ++i)
+    lines->pdata[line + i] = parts[i];
+
+  t0 = g_get_monotonic_time();
+  cc_occur_shift(index, last + 1, (gint)nr_parts - 1 - (gint)(last - line));
+  cc_occur_add_text(index, text->str, text->len, line);
+  dt += g_get_monotonic_time() - t0;
+
+  g_free(parts);
+  g_free(old);
+  g_string_free(text, TRUE);
+
+  return dt;
+}
+
+static gboolean same_hits(GArray *a, GArray *b)
+{
+  return a->len == b->len && memcmp(a->data, b->data, a->len * sizeof(cc_occur_pos_t)) == 0;
+}
+
+static int occur(const gchar *path, gint nr_edits)
+{
+  static const gchar *inserts[] = { "x", "_", " ", "\n", "fooBar", "foo_bar(", "\n\tbaz = qux;\n", "" };
+  cc_occur_t      *index = NULL, *fresh = NULL;
+  GHashTable      *names = NULL;
+  GHashTableIter  iter;
+  gpointer        name;
+  GPtrArray       *lines = NULL;
+  GArray          *hits = NULL, *expected = NULL;
+  GRand           *rand = g_rand_new_with_seed(42);
+  cc_occur_pos_t  at;
+  gchar           *doc = NULL, **split = NULL;
+  gsize           docsz = 0, begin, end, pos, bol, namesz;
+  guint           line;
+  gint64          t0 = 0, t_edits = 0, t_index = 0, t_scan = 0;
+  gint            i, failures = 0, nr_names = 0, n;
+
+  if (!g_file_get_contents(path, &doc, &docsz, NULL)) {
+    g_fprintf(stderr, "caseconvert-tool: unable to read '%s'\n", path);
+    return 1;
+  }
+
+  /* the lines below are split at '\n' only, a lone '\r' ends one too */
+  for (pos = 0; pos < docsz; ++pos)
+    if (doc[pos] == '\r' && (pos + 1 == docsz || doc[pos+1] != '\n'))
+      doc[pos] = '\n';
+
+  t0 = g_get_monotonic_time();
+  index = cc_occur_new();
+  cc_occur_add_text(index, doc, docsz, 0);
+
+  g_printf("indexed %d identifiers of %lu bytes in %.2fms\n", cc_occur_size(index),
+    (gulong)docsz, (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+  /* the document is edited as lines, the way Scintilla hands them out */
+  split = g_strsplit(doc, "\n", -1);
+  lines = g_ptr_array_new();
+  for (i = 0; split[i]; ++i)
+    g_ptr_array_add(lines, split[i]);
+  g_free(split);
+  g_free(doc);
+
+  for (i = 0; i < nr_edits; ++i) {
+    line = g_rand_int_range(rand, 0, lines->len);
+    pos = g_rand_int_range(rand, 0, strlen(g_ptr_array_index(lines, line)) + 1);
+
+    if (g_rand_boolean(rand))
+      t_edits += edit(index, lines, line, pos, g_rand_int_range(rand, 1, 24), "");
+    else
+      t_edits += edit(index, lines, line, pos, 0, inserts[g_rand_int_range(rand, 0, G_N_ELEMENTS(inserts))]);
+  }
+
+  g_printf("followed %d edits in %.2fms\n", nr_edits, (gdouble)t_edits / 1000);
+
+  /* whatever the edits did, the index must read as if built just now */
+  doc = join_lines(lines, 0, lines->len - 1);
+  docsz = strlen(doc);
+
+  fresh = cc_occur_new();
+  cc_occur_add_text(fresh, doc, docsz, 0);
+
+  if (cc_occur_size(index) != cc_occur_size(fresh)) {
+    g_fprintf(stderr, "caseconvert-tool: %d identifiers indexed, %d in the text\n",
+      cc_occur_size(index), cc_occur_size(fresh));
+    ++failures;
+  }
+
+  names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  for (begin = 0; begin < docsz; begin = end + 1) {
+    while (begin < docsz && !CC_OCCUR_IS_WORD_CHAR(doc[begin]))
+      ++begin;
+    for (end = begin; end < docsz && CC_OCCUR_IS_WORD_CHAR(doc[end]); ++end);
+
+    if (begin < end)
+      g_hash_table_insert(names, g_strndup(doc + begin, end - begin), NULL);
+  }
+
+  hits = g_array_new(FALSE, FALSE, sizeof(cc_occur_pos_t));
+  expected = g_array_new(FALSE, FALSE, sizeof(cc_occur_pos_t));
+
+  g_hash_table_iter_init(&iter, names);
+  while (g_hash_table_iter_next(&iter, &name, NULL))
+  {
+    namesz = strlen(name);
+
+    for (n = 0; n < 2; ++n) {
+      g_array_set_size(hits, 0);
+      g_array_set_size(expected, 0);
+
+      t0 = g_get_monotonic_time();
+      /* the candidates, which the scan below looks for ignoring ASCII case */
+      cc_occur_find(index, name, namesz, n == 0, TRUE, hits);
+      t_index += g_get_monotonic_time() - t0;
+
+      /* what Convert All would have searched the whole text for */
+      t0 = g_get_monotonic_time();
+      for (pos = 0, bol = 0, at.line = 0; pos + namesz <= docsz; ++pos) {
+        if (doc[pos] == '\n') {
+          ++at.line;
+          bol = pos + 1;
+        }
+
+        if (g_ascii_strncasecmp(doc + pos, name, namesz) != 0)
+          continue;
+
+        if (n == 0 && ((pos > 0 && CC_OCCUR_IS_WORD_CHAR(doc[pos-1]))
+                   || (pos + namesz < docsz && CC_OCCUR_IS_WORD_CHAR(doc[pos+namesz]))))
+          continue;
+
+        at.col = pos - bol;
+        g_array_append_val(expected, at);
+
+        /* past it, it has no newline */
+        if (n == 1)
+          pos += namesz - 1;
+      }
+      t_scan += g_get_monotonic_time() - t0;
+
+      if (!same_hits(hits, expected) && failures++ < 10)
+        g_fprintf(stderr, "caseconvert-tool: '%s' (%s) found %u times, occurs %u times\n",
+          (gchar*)name, n == 0 ? "whole" : "within", hits->len, expected->len);
+    }
+
+    if (++nr_names == 1000)
+      break;
+  }
+
+  g_printf("looked up %d identifiers in %.2fms, scanning for them took %.2fms\n",
+    nr_names, (gdouble)t_index / 1000, (gdouble)t_scan / 1000);
+
+  g_array_free(hits, TRUE);
+  g_array_free(expected, TRUE);
+  g_hash_table_destroy(names);
+  for (line = 0; line < lines->len; ++line)
+    g_free(g_ptr_array_index(lines, line));
+  g_ptr_array_free(lines, TRUE);
+  cc_occur_free(index);
+  cc_occur_free(fresh);
+  g_free(doc);
+  g_rand_free(rand);
+
+  return failures ? 1 : 0;
+}
+
+/* the text with the plan's edits made */
+static gchar* apply_plan(const gchar *text, gsize textsz, const cc_plan_t *plan)
+{
+  GString         *out = g_string_sized_new(textsz + textsz / 8);
+  cc_plan_edit_t  *edit = NULL;
+  gsize           from = 0;
+  guint           i;
+
+  for (i = 0; i < plan->edits->len; ++i) {
+    edit = &g_array_index(plan->edits, cc_plan_edit_t, i);
+    g_string_append_len(out, text + from, edit->pos - from);
+    g_string_append(out, g_ptr_array_index(plan->texts, edit->text));
+    from = edit->pos + edit->len;
+  }
+
+  g_string_append_len(out, text + from, textsz - from);
+
+  return g_string_free(out, FALSE);
+}
+
+/* the lines of a text, as the plan's diff counts them */
+static gchar** split_lines(const gchar *text)
+{
+  gchar **lines = g_strsplit(text, "\r\n", -1);
+  gchar *lf = g_strjoinv("\n", lines);
+
+  g_strfreev(lines);
+  g_strdelimit(lf, "\r", '\n');
+  lines = g_strsplit(lf, "\n", -1);
+  g_free(lf);
+
+  return lines;
+}
+
+/* whether every hunk of a diff has the line as it was and as it became */
+static gboolean check_diff(const gchar *diff, const gchar *before, const gchar *after,
+                           gint *nr_hunks)
+{
+  gchar     **lines = g_strsplit(diff, "\n", -1);
+  gchar     **was = split_lines(before), **now = split_lines(after);
+  guint     nr_was = g_strv_length(was), nr_now = g_strv_length(now), i;
+  gint      line = 0, other = 0;
+  gboolean  ok = TRUE;
+
+  *nr_hunks = 0;
+
+  for (i = 2; ok && lines[i] && lines[i+1] && lines[i+2]; i += 3) {
+    ok = sscanf(lines[i], "@@ -%d +%d @@", &line, &other) == 2 && line == other &&
+         line >= 1 && (guint)line <= MIN(nr_was, nr_now) &&
+         lines[i+1][0] == '-' && strcmp(lines[i+1] + 1, was[line-1]) == 0 &&
+         lines[i+2][0] == '+' && strcmp(lines[i+2] + 1, now[line-1]) == 0;
+    ++*nr_hunks;
+  }
+
+  g_strfreev(lines);
+  g_strfreev(was);
+  g_strfreev(now);
+
+  return ok;
+}
+
+/* the text with the plan's edits made the way cc_plan_estimate() picks */
+static gchar* apply_spans(const gchar *text, gsize textsz, const cc_plan_t *plan,
+                          cc_plan_cost_t *cost)
+{
+  GString         *out = g_string_sized_new(textsz + textsz / 8);
+  GArray          *spans = g_array_new(FALSE, FALSE, sizeof(cc_plan_span_t));
+  cc_plan_span_t  *span = NULL;
+  cc_plan_edit_t  *edit = NULL;
+  gchar           *old = NULL, *repl = NULL;
+  gint            *lines = g_new(gint, MAX(plan->edits->len, 1));
+  gint            line = 0;
+  gsize           from = 0;
+  guint           i;
+
+  /* the line of every edit, as the editor counts them */
+  for (i = 0; i < plan->edits->len; ++i) {
+    edit = &g_array_index(plan->edits, cc_plan_edit_t, i);
+
+    for (; from < (gsize)edit->pos; ++from)
+      if (text[from] == '\n' || (text[from] == '\r' && text[from+1] != '\n'))
+        ++line;
+
+    lines[i] = line;
+  }
+
+  cc_plan_estimate(plan, lines, cost, spans);
+
+  for (i = 0, from = 0; i < spans->len; ++i) {
+    span = &g_array_index(spans, cc_plan_span_t, i);
+    old = g_strndup(text + span->pos, span->len);
+    repl = cc_plan_compose(plan, span, old);
+
+    g_string_append_len(out, text + from, span->pos - from);
+    g_string_append(out, repl);
+    from = span->pos + span->len;
+
+    cc_free(repl);
+    g_free(old);
+  }
+
+  g_string_append_len(out, text + from, textsz - from);
+
+  g_array_free(spans, TRUE);
+  g_free(lines);
+
+  return g_string_free(out, FALSE);
+}
+
+static int bulk(const gchar *path, const gchar *pack)
+{
+  static const gint nr_threads[] = { 1, CC_PLAN_THREADS };
+  cc_plan_t       *plan = NULL;
+  cc_plan_cost_t  cost;
+  GString         *expected = NULL, *modes = NULL;
+  gchar           *doc = NULL, *out = NULL, *repl = NULL, *problem = NULL;
+  gchar           *diff = NULL, *applied = NULL;
+  gsize           docsz = 0, begin = 0, end = 0, from = 0;
+  gint64          t0 = 0;
+  gint            replsz = 0, nr_names = 0, nr_hunks = 0, failures = 0, mode;
+  guint           i;
+
+  if (!g_file_get_contents(path, &doc, &docsz, NULL)) {
+    g_fprintf(stderr, "caseconvert-tool: unable to read '%s'\n", path);
+    return 1;
+  }
+
+  if (pack && cc_import_rules(pack, &problem) < 0) {
+    g_fprintf(stderr, "caseconvert-tool: nothing imported from '%s', %s\n", pack, problem);
+    g_free(problem);
+    g_free(doc);
+    return 1;
+  }
+
+  /* every occurrence converted on its own, as Convert Selection would */
+  t0 = g_get_monotonic_time();
+  expected = g_string_sized_new(docsz + docsz / 8);
+
+  for (begin = 0; begin < docsz; begin = end) {
+    for (; begin < docsz && !CC_OCCUR_IS_WORD_CHAR(doc[begin]); ++begin);
+    for (end = begin; end < docsz && CC_OCCUR_IS_WORD_CHAR(doc[end]); ++end);
+
+    if (begin == end || g_ascii_isdigit(doc[begin]))
+      continue;
+
+    ++nr_names;
+
+    if ((repl = cc_convert_text(doc + begin, end - begin, &replsz)) != NULL) {
+      g_string_append_len(expected, doc + from, begin - from);
+      g_string_append(expected, repl);
+      from = end;
+      cc_free(repl);
+    }
+  }
+
+  g_string_append_len(expected, doc + from, docsz - from);
+
+  g_printf("converted %d names one by one in %.2fms\n", nr_names,
+    (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+  for (i = 0; i < G_N_ELEMENTS(nr_threads); ++i) {
+    t0 = g_get_monotonic_time();
+    plan = cc_plan_names(doc, docsz, 0, nr_threads[i]);
+
+    g_printf("planned %d names (%d distinct) into %d edits on %d threads in %.2fms\n",
+      plan->nr_names, plan->nr_distinct, plan->edits->len, nr_threads[i],
+      (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+    out = apply_plan(doc, docsz, plan);
+
+    if (plan->nr_names != nr_names || strcmp(out, expected->str) != 0) {
+      g_fprintf(stderr, "caseconvert-tool: the plan on %d threads converts differently\n", nr_threads[i]);
+      ++failures;
+    }
+
+    /* the preview of it */
+    if (i == G_N_ELEMENTS(nr_threads) - 1) {
+      t0 = g_get_monotonic_time();
+      diff = cc_plan_diff(plan, doc, docsz, 0, path, G_MAXINT);
+
+      g_printf("diffed %d bytes replaced by %d in %.2fms\n", plan->removed, plan->added,
+        (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+      if (!check_diff(diff, doc, out, &nr_hunks) || (nr_hunks == 0) != (plan->edits->len == 0)) {
+        g_fprintf(stderr, "caseconvert-tool: the plan's diff doesn't match the text\n");
+        ++failures;
+      }
+
+      g_free(diff);
+
+      /* and applying it, the modes that can't are no candidates */
+      applied = apply_spans(doc, docsz, plan, &cost);
+      modes = g_string_new("");
+
+      for (mode = CC_PLAN_EACH; mode < CC_PLAN_NR_MODES; ++mode)
+        if (cost.undo[mode] != CC_PLAN_INELIGIBLE)
+          g_string_append_printf(modes, "%s%s %lu", modes->len ? ", " : "",
+            cc_plan_mode_name(mode), (gulong)cost.undo[mode]);
+
+      g_printf("applying it by %s: %lu replacements of up to %lu bytes, undo history of about "
+        "%lu bytes (%s)\n", cc_plan_mode_name(cost.mode), (gulong)cost.calls[cost.mode],
+        (gulong)cost.peak, (gulong)cost.undo[cost.mode], modes->str);
+
+      g_string_free(modes, TRUE);
+
+      if (strcmp(applied, out) != 0) {
+        g_fprintf(stderr, "caseconvert-tool: applying the plan %s converts differently\n",
+          cc_plan_mode_name(cost.mode));
+        ++failures;
+      }
+
+      g_free(applied);
+    }
+
+    g_free(out);
+    cc_plan_free(plan);
+  }
+
+  cc_clear_rules();
+  g_string_free(expected, TRUE);
+  g_free(doc);
+
+  return failures ? 1 : 0;
+}
+
+/* runs a scan to the end, rewriting the files found if "rewrite" is set */
+static void run_scan(cc_scan_t *scan, const gchar *dir, gboolean rewrite,
+                     gint *nr_files, gint *nr_hits)
+{
+  cc_scan_file_t *file = NULL;
+  gboolean       busy = TRUE;
+
+  *nr_files = *nr_hits = 0;
+  cc_scan_start(scan, dir, NULL);
+
+  /* once it isn't busy, whatever is left was handed back already */
+  while (busy) {
+    busy = cc_scan_busy(scan);
+
+    if (!(file = cc_scan_pop(scan))) {
+      if (busy)
+        g_usleep(1000);
+      continue;
+    }
+
+    busy = TRUE;
+
+    if (file->rewritten) {
+      if (file->error)
+        g_fprintf(stderr, "caseconvert-tool: unable to rewrite '%s': %s\n", file->path, file->error);
+      else
+        *nr_hits += file->nr_replaced;
+    }
+    else {
+      ++*nr_files;
+
+      if (rewrite)
+        cc_scan_rewrite(scan, file->path);
+      else
+        *nr_hits += file->hits->len;
+    }
+
+    cc_scan_file_free(file);
+  }
+}
+
+static int scan_tree(const gchar *dir, const gchar *symbol, const gchar *to)
+{
+  cc_scan_t *scan = NULL;
+  gint64    t0 = 0, t_single = 0, t_pool = 0;
+  gint      nr_files = 0, nr_hits = 0, nr_files_pool = 0, nr_hits_pool = 0, nr_looked = 0;
+
+  if (to) {
+    t0 = g_get_monotonic_time();
+    scan = cc_scan_new(symbol, to, CC_SCAN_THREADS);
+    run_scan(scan, dir, TRUE, &nr_files, &nr_hits);
+    nr_looked = cc_scan_nr_files(scan) - nr_files;
+    cc_scan_free(scan);
+
+    g_printf("replaced %d occurrences in %d of %d files in %.2fms\n", nr_hits, nr_files,
+      nr_looked, (gdouble)(g_get_monotonic_time() - t0) / 1000);
+    return 0;
+  }
+
+  t0 = g_get_monotonic_time();
+  scan = cc_scan_new(symbol, symbol, 1);
+  run_scan(scan, dir, FALSE, &nr_files, &nr_hits);
+  nr_looked = cc_scan_nr_files(scan);
+  cc_scan_free(scan);
+  t_single = g_get_monotonic_time() - t0;
+
+  t0 = g_get_monotonic_time();
+  scan = cc_scan_new(symbol, symbol, CC_SCAN_THREADS);
+  run_scan(scan, dir, FALSE, &nr_files_pool, &nr_hits_pool);
+  cc_scan_free(scan);
+  t_pool = g_get_monotonic_time() - t0;
+
+  g_printf("found %d occurrences in %d of %d files\n", nr_hits, nr_files, nr_looked);
+  g_printf("1 thread: %.2fms, %d threads: %.2fms\n", (gdouble)t_single / 1000,
+    CC_SCAN_THREADS, (gdouble)t_pool / 1000);
+
+  if (nr_files != nr_files_pool || nr_hits != nr_hits_pool) {
+    g_fprintf(stderr, "caseconvert-tool: the pool found %d occurrences in %d files\n",
+      nr_hits_pool, nr_files_pool);
+    return 1;
+  }
+
+  return 0;
+}
+
+static void usage();
+
+static int map_files(gint argc, gchar **argv)
+{
+  cc_map_t  *map = NULL;
+  cc_plan_t *plan = NULL;
+  GError    *error = NULL;
+  gboolean  whole_word = FALSE, fallback = FALSE, in_place = FALSE;
+  gchar     *problem = NULL, *text = NULL, *out = NULL;
+  gsize     textsz = 0;
+  gint64    t0 = 0, t_plans = 0;
+  gint      arg, nr_pairs, nr_mapped = 0, nr_all_mapped = 0, nr_edits = 0, failures = 0;
+
+  for (arg = 0; arg < argc && argv[arg][0] == '-'; ++arg) {
+    if (strcmp(argv[arg], "-w") == 0)
+      whole_word = TRUE;
+    else if (strcmp(argv[arg], "-f") == 0)
+      fallback = TRUE;
+    else if (strcmp(argv[arg], "-i") == 0)
+      in_place = TRUE;
+    else
+      break;
+  }
+
+  if (argc - arg < 2) {
+    usage();
+    return 1;
+  }
+
+  t0 = g_get_monotonic_time();
+  map = cc_map_new(whole_word);
+
+  if ((nr_pairs = cc_map_load(map, argv[arg], &problem)) < 0) {
+    g_fprintf(stderr, "caseconvert-tool: nothing mapped from '%s', %s\n", argv[arg], problem);
+    g_free(problem);
+    cc_map_free(map);
+    return 1;
+  }
+
+  g_fprintf(stderr, "loaded %d pairs in %.2fms\n", nr_pairs,
+    (gdouble)(g_get_monotonic_time() - t0) / 1000);
+
+  for (++arg; arg < argc; ++arg) {
+    if (!g_file_get_contents(argv[arg], &text, &textsz, NULL)) {
+      g_fprintf(stderr, "caseconvert-tool: unable to read '%s'\n", argv[arg]);
+      ++failures;
+      continue;
+    }
+
+    t0 = g_get_monotonic_time();
+    plan = cc_map_plan(map, text, textsz, 0, fallback, &nr_mapped);
+    t_plans += g_get_monotonic_time() - t0;
+
+    nr_all_mapped += nr_mapped;
+    nr_edits += plan->edits->len;
+
+    if (!in_place)
+      out = cc_plan_diff(plan, text, textsz, 0, argv[arg], G_MAXINT);
+    else if (plan->edits->len)
+      out = apply_plan(text, textsz, plan);
+
+    if (!in_place && plan->edits->len)
+      g_printf("%s", out);
+    else if (out && !g_file_set_contents(argv[arg], out, -1, &error)) {
+      g_fprintf(stderr, "caseconvert-tool: unable to rewrite '%s', %s\n", argv[arg], error->message);
+      g_clear_error(&error);
+      ++failures;
+    }
+
+    g_free(out);
+    g_free(text);
+    cc_plan_free(plan);
+    out = NULL;
+  }
+
+  g_fprintf(stderr, "mapped %d names, and converted %d others, in %.2fms\n", nr_all_mapped,
+    nr_edits - nr_all_mapped, (gdouble)t_plans / 1000);
+
+  cc_map_free(map);
+
+  return failures ? 1 : 0;
+}
+
+/* check: what names convert to without any rules, and what cycling through
+ * the styles makes of them */
+static const gchar *check_conversions[][2] = {
+  /* the documented cases */
+  { "foo_bar", "fooBar" },
+  { "foo_BAR", "fooBAR" },
+  { "foo_BAR_zoo", "fooBARZoo" },
+  { "foo_bAR_zoo", "fooBARZoo" },
+  { "foo_bar__", "fooBar__" },
+  { "fooBar", "foo_bar" },
+  { "mCURLObj", "m_curl_obj" },
+  /* only '_' and the case delimit words, anything else stays in its word */
+  { "self.foo_bar", "self.fooBar" },
+  { "a->b_c", "a->bC" },
+  { "obj.fooBar", "obj.foo_bar" },
+  { "foo_bar-baz", "fooBar-baz" },
+  { "foo bar_baz", "foo barBaz" },
+  { "getX.setY", "get_x.set_y" },
+  { "x_y.z_w", "xY.zW" },
+  { "fooBar.bazQux", "foo_bar.baz_qux" },
+  { "$foo_bar", "$fooBar" },
+  { "$fooBar", "$foo_bar" },
+  /* runs of delimiters are kept, and so is the letter following them */
+  { "foo__bar_baz", "foo__barBaz" },
+  { "foo__barBaz", "foo__bar_baz" },
+  { "foo_bar__baz", "fooBar__baz" },
+  { "fooBar__baz", "foo_bar__baz" },
+  { "__foo_bar__", "__fooBar__" },
+  { "foo__Bar", "foo__bar" },
+  /* with nothing but runs there's nothing to convert */
+  { "foo__bar", NULL },
+  { "__init__", NULL },
+  { NULL, NULL }
+};
+
+/* the same under "delims=-." */
+static const gchar *check_delims[][2] = {
+  { "foo-bar", "fooBar" },
+  { "foo.bar-baz", "fooBarBaz" },
+  { "foo--bar.baz", "foo--barBaz" },
+  { "foo_bar", NULL },
+  { "fooBar", "foo_bar" },
+  { NULL, NULL }
+};
+
+static const struct {
+  const gchar *in;
+  cc_style_t  style;
+  const gchar *out;
+} check_styles[] = {
+  { "foo-bar", CC_STYLE_CAMEL, "fooBar" },
+  { "foo.bar_baz", CC_STYLE_KEBAB, "foo-bar-baz" },
+  { "foo bar", CC_STYLE_SNAKE, "foo_bar" },
+  { "self.fooBar", CC_STYLE_SCREAMING, "SELF_FOO_BAR" },
+  { "foo__bar-baz", CC_STYLE_DOT, "foo__bar.baz" },
+  { NULL, 0, NULL }
+};
+
+/* converts every name of "table" and counts the unexpected results */
+static gint check_table(const gchar *table[][2])
+{
+  gchar *out = NULL;
+  gint  outsz = 0;
+  gint  i, failures = 0;
+
+  for (i = 0; table[i][0]; ++i) {
+    out = cc_convert_text(table[i][0], strlen(table[i][0]), &outsz);
+
+    if (out && table[i][1] ? strcmp(out, table[i][1]) != 0 : out != table[i][1]) {
+      g_fprintf(stderr, "caseconvert-tool: '%s' converted to '%s', expected '%s'\n",
+        table[i][0], out ? out : "(null)", table[i][1] ? table[i][1] : "(null)");
+      ++failures;
+    }
+
+    cc_free(out);
+  }
+
+  return failures;
+}
+
+static gint check_convert()
+{
+  cc_grammar_t  *g = cc_grammar_with_delims(NULL, CC_STYLE_DELIMS);
+  cc_words_t    words;
+  gchar         *out = NULL;
+  gint          i, failures = 0;
+
+  failures += check_table(check_conversions);
+
+  cc_set_boundaries("aA 0A *A AAa delims=-.");
+  failures += check_table(check_delims);
+  cc_set_boundaries(NULL);
+
+  for (i = 0; check_styles[i].in; ++i) {
+    out = NULL;
+
+    if (cc_words_split(check_styles[i].in, -1, g, NULL, &words)) {
+      out = cc_words_convert(&words, check_styles[i].style, NULL);
+      cc_words_clear(&words);
+    }
+
+    if (!out || strcmp(out, check_styles[i].out) != 0) {
+      g_fprintf(stderr, "caseconvert-tool: '%s' cycled to %s '%s', expected '%s'\n",
+        check_styles[i].in, cc_style_name(check_styles[i].style), out ? out : "(null)",
+        check_styles[i].out);
+      ++failures;
+    }
+
+    cc_free(out);
+  }
+
+  cc_grammar_unref(g);
+
+  return failures;
+}
+
+/* analysis: removals strip bytes without looking at them, so a rule whose
+ * condition doesn't guarantee what it removes can never apply */
+static const gchar *check_rules =
+  "[1,blind,1,1,3,,2,xy]"
+  "[2,cross,1,1,1,m_,4,_t]"
+  "[3,longer,1,1,1,ab,2,abc]"
+  "[4,reverse,1,1,2,_t,2,_t]"
+  "[5,regex,1,1,4,^m_,2,m_]"
+  "[6,member,1,1,1,m_,2,m_]"
+  "[7,match,1,1,4,^(s_|g_),2,]"
+  "[8,getter,1,1,3,,1,get]";
+
+static const struct {
+  gint              id;
+  cc_rule_status_t  status;
+} check_statuses[] = {
+  { 1, CC_RULE_IMPOSSIBLE },
+  { 2, CC_RULE_IMPOSSIBLE },
+  { 3, CC_RULE_IMPOSSIBLE },
+  { 4, CC_RULE_IMPOSSIBLE },
+  { 5, CC_RULE_IMPOSSIBLE },
+  { 6, CC_RULE_LIVE },
+  { 7, CC_RULE_LIVE },
+  { 8, CC_RULE_LIVE },
+  { 0, 0 }
+};
+
+static const gchar *check_analyzed[][2] = {
+  { "ab_cd", "getAbCd" },
+  { "m_foo_bar", "fooBar" },
+  { "s_foo_bar", "fooBar" },
+  { NULL, NULL }
+};
+
+static gint check_analysis()
+{
+  rule_t  *rule = NULL;
+  gint    i, failures = 0;
+
+  cc_clear_rules();
+  cc_parse_rules(check_rules);
+  cc_analyze_rules();
+
+  for (i = 0; check_statuses[i].id; ++i) {
+    rule = cc_get_rule(check_statuses[i].id);
+
+    if (!rule || rule->prog.status != check_statuses[i].status) {
+      g_fprintf(stderr, "caseconvert-tool: rule %d analyzed as %d, expected %d\n",
+        check_statuses[i].id, rule ? (gint)rule->prog.status : -1, check_statuses[i].status);
+      ++failures;
+    }
+  }
+
+  failures += check_table(check_analyzed);
+  cc_clear_rules();
+
+  return failures;
+}
+
+/* the index folds ASCII case only, so it can't find what a case insensitive
+ * search for a non-ASCII name finds, the search has to go through the text */
+static gint check_occur()
+{
+  static const gchar  text[] = "int \xc3\x9c""ber = \xc3\xbc""ber + foo;\n";
+  cc_occur_t          *index = cc_occur_new();
+  GArray              *hits = g_array_new(FALSE, FALSE, sizeof(cc_occur_pos_t));
+  gint                failures = 0;
+
+  cc_occur_add_text(index, text, sizeof(text) - 1, 0);
+
+  if (cc_occur_find(index, "\xc3\xbc""ber", 5, TRUE, FALSE, hits)) {
+    g_fprintf(stderr, "caseconvert-tool: the index ignores non-ASCII case\n");
+    ++failures;
+  }
+
+  if (!cc_occur_find(index, "\xc3\xbc""ber", 5, TRUE, TRUE, hits) || hits->len != 1) {
+    g_fprintf(stderr, "caseconvert-tool: the index found a non-ASCII name %u times\n", hits->len);
+    ++failures;
+  }
+
+  g_array_set_size(hits, 0);
+
+  if (!cc_occur_find(index, "FOO", 3, TRUE, FALSE, hits) || hits->len != 1) {
+    g_fprintf(stderr, "caseconvert-tool: the index found an ASCII name %u times\n", hits->len);
+    ++failures;
+  }
+
+  g_array_free(hits, TRUE);
+  cc_occur_free(index);
+
+  return failures;
+}
+
+/* maps: where names overlap the one starting first wins, then the longest;
+ * whole words don't match inside identifiers; a name mapped to itself is
+ * left alone, and so is a name the rules would convert over a mapped one.
+ * The edits are then made the way cc_plan_estimate() picks, which can't be
+ * the whole range at once when they're on different lines */
+static const gchar *check_pairs[][2] = {
+  { "foo", "FOO" },
+  { "foobar", "foo_bar" },
+  { "oobarxyz", "OOBARXYZ" },
+  { "same", "same" },
+  { NULL, NULL }
+};
+
+static const struct {
+  gboolean        whole_word;
+  gboolean        fallback;
+  const gchar     *in;
+  const gchar     *out;
+  gint            nr_mapped;
+  cc_plan_mode_t  mode;
+  gboolean        whole;      /* whether the whole range may be replaced at once */
+} check_maps[] = {
+  { FALSE, FALSE, "foobarxyz foo;", "foo_barxyz FOO;", 2, CC_PLAN_CHUNKS, TRUE },
+  { FALSE, FALSE, "x = oobarxyz;", "x = OOBARXYZ;", 1, CC_PLAN_EACH, TRUE },
+  { TRUE, FALSE, "foobarx foo foo_x foobar;", "foobarx FOO foo_x foo_bar;", 2, CC_PLAN_CHUNKS, TRUE },
+  { FALSE, FALSE, "same(foo);", "same(FOO);", 1, CC_PLAN_EACH, TRUE },
+  { FALSE, TRUE, "fooBaz same_thing bar_baz;", "FOOBaz same_thing barBaz;", 1, CC_PLAN_CHUNKS, TRUE },
+  { TRUE, TRUE, "fooBaz foo same_thing;", "foo_baz FOO sameThing;", 1, CC_PLAN_CHUNKS, TRUE },
+  { FALSE, FALSE, "foo();\nfoo();\n", "FOO();\nFOO();\n", 2, CC_PLAN_EACH, FALSE },
+  { FALSE, FALSE, NULL, NULL, 0, 0, FALSE }
+};
+
+static gint check_map()
+{
+  cc_map_t        *map = NULL;
+  cc_plan_t       *plan = NULL;
+  cc_plan_cost_t  cost;
+  gchar           *out = NULL, *applied = NULL;
+  gint            i, j, nr_mapped = 0, failures = 0;
+
+  for (i = 0; check_maps[i].in; ++i) {
+    map = cc_map_new(check_maps[i].whole_word);
+
+    for (j = 0; check_pairs[j][0]; ++j)
+      cc_map_add(map, check_pairs[j][0], check_pairs[j][1]);
+
+    plan = cc_map_plan(map, check_maps[i].in, strlen(check_maps[i].in), 0,
+      check_maps[i].fallback, &nr_mapped);
+    out = apply_plan(check_maps[i].in, strlen(check_maps[i].in), plan);
+    applied = apply_spans(check_maps[i].in, strlen(check_maps[i].in), plan, &cost);
+
+    if (strcmp(out, check_maps[i].out) != 0 || nr_mapped != check_maps[i].nr_mapped) {
+      g_fprintf(stderr, "caseconvert-tool: '%s' mapped to '%s' (%d mapped), expected '%s' (%d)\n",
+        check_maps[i].in, out, nr_mapped, check_maps[i].out, check_maps[i].nr_mapped);
+      ++failures;
+    }
+
+    if (strcmp(applied, out) != 0 || cost.mode != check_maps[i].mode ||
+        (cost.calls[CC_PLAN_WHOLE] != CC_PLAN_INELIGIBLE) != check_maps[i].whole) {
+      g_fprintf(stderr, "caseconvert-tool: '%s' applied %s as '%s', expected %s%s\n",
+        check_maps[i].in, cc_plan_mode_name(cost.mode), applied,
+        cc_plan_mode_name(check_maps[i].mode), check_maps[i].whole ? "" : " and not whole");
+      ++failures;
+    }
+
+    g_free(applied);
+    g_free(out);
+    cc_plan_free(plan);
+    cc_map_free(map);
+  }
+
+  return failures;
+}
+
+/* a rule we added while they added theirs under the same id gets a new one,
+ * which must be the one it's saved with from then on */
+static gint check_merge()
+{
+  GHashTable  *ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  rule_t      *rules = NULL, *rule = NULL;
+  gchar       *defs = NULL;
+  gint        nr_rules = 0, failures = 0;
+
+  cc_clear_rules();
+  cc_parse_rules("[1,Ours,1,1,1,p_,2,p_,1,get]");
+  cc_free(cc_serialize_rules(&nr_rules));
+
+  cc_merge_rules("", cc_load_rules("[1,Theirs,1,2,2,V,4,V,3,_t]", &nr_rules));
+  defs = cc_serialize_rules(&nr_rules);
+  rules = cc_load_rules(defs, &nr_rules);
+
+  for (rule = rules; rule != NULL; rule = rule->next) {
+    if (g_hash_table_lookup(ids, GINT_TO_POINTER(rule->id))) {
+      g_fprintf(stderr, "caseconvert-tool: merged rules saved with id %d twice: %s\n", rule->id, defs);
+      ++failures;
+    }
+
+    g_hash_table_insert(ids, GINT_TO_POINTER(rule->id), rule);
+  }
+
+  if (nr_rules != 2) {
+    g_fprintf(stderr, "caseconvert-tool: merged rules saved as %d rules: %s\n", nr_rules, defs);
+    ++failures;
+  }
+
+  cc_free_rules(rules);
+  cc_free(defs);
+  cc_clear_rules();
+  g_hash_table_destroy(ids);
+
+  return failures;
+}
+
+/* budgets: a conversion allocates its result and nothing else, and nothing
+ * outlives a long run of them; they're made on several threads at once while
+ * this one keeps editing the rules, and none of them may count against the
+ * others */
+static volatile gint budget_done = 0;
+
+static gpointer check_budget_convert(G_GNUC_UNUSED gpointer data)
+{
+  const gchar     *names[] = { "p1_foo_bar", "fooBarV2", "mCURLObj", "self.foo_bar", NULL };
+  cc_mem_stats_t  snap, run;
+  gchar           *out = NULL;
+  gint            outsz = 0;
+  gint            i, n, failures = 0;
+
+  cc_mem_get_thread_stats(CC_MEM_CONVERTER, &run);
+
+  for (n = 0; n < 1000 || !g_atomic_int_get(&budget_done); ++n) {
+    for (i = 0; names[i]; ++i) {
+      cc_mem_get_thread_stats(CC_MEM_CONVERTER, &snap);
+      out = cc_convert_text(names[i], strlen(names[i]), &outsz);
+
+      if (!cc_mem_within_budget(CC_MEM_CONVERTER, &snap, 1, out ? 1 : 0))
+        ++failures;
+
+      cc_free(out);
+    }
+  }
+
+  if (!cc_mem_within_budget(CC_MEM_CONVERTER, &run, G_MAXUINT, 0))
+    ++failures;
+
+  return GINT_TO_POINTER(failures);
+}
+
+#define BUDGET_THREADS 4
+
+static gint check_budgets()
+{
+  GThread *threads[BUDGET_THREADS];
+  gint    failures = 0;
+  gint    i, e;
+
+  g_atomic_int_set(&budget_done, 0);
+
+  for (i = 0; i < BUDGET_THREADS; ++i)
+    threads[i] = g_thread_new("budget", check_budget_convert, NULL);
+
+  for (e = 0; e < 20000; ++e)
+    stress_load(e % STRESS_STATES, e % 2);
+
+  g_atomic_int_set(&budget_done, 1);
+
+  for (i = 0; i < BUDGET_THREADS; ++i)
+    failures += GPOINTER_TO_INT(g_thread_join(threads[i]));
+
+  cc_clear_rules();
+
+  if (failures)
+    g_fprintf(stderr, "caseconvert-tool: %d conversions over budget\n", failures);
+
+  return failures;
+}
+
+static int check()
+{
+  gint failures = 0;
+
+  failures += check_convert();
+  failures += check_analysis();
+  failures += check_occur();
+  failures += check_map();
+  failures += check_merge();
+  failures += check_budgets();
+
+  g_printf("%s\n", failures ? "FAILED" : "all checks passed");
+
+  return failures ? 1 : 0;
+}
+
+static void usage()
+{
+  fputs("usage: caseconvert-tool <command> [arguments]\n", stderr);
+  fputs("  replay [-v] <trace>\n"
+        "    re-runs a trace recorded with record=<path> (or CC_RECORD=<path>)\n"
+        "    and reports per-operation timings, -v lists every operation\n", stderr);
+  fputs("  stress [threads] [edits]\n"
+        "    converts on 4 (or the given number of) threads while the rules\n"
+        "    are edited 10000 (or the given number of) times\n", stderr);
+  fputs("  import <pack> [out]\n"
+        "    imports a rule pack and reports how long it took, exporting\n"
+        "    the rules into <out> if given\n", stderr);
+  fputs("  search <pack> <query>\n"
+        "    times the Edit Rules filter over a pack as the query is typed\n", stderr);
+  fputs("  occur <file> [edits]\n"
+        "    checks the document index against 10000 (or the given number\n"
+        "    of) random edits of a file and times looking identifiers up\n", stderr);
+  fputs("  bulk <file> [pack]\n"
+        "    times converting every name of a file one by one, then\n"
+        "    planned on one thread and on several, and checks the plan's diff\n", stderr);
+  fputs("  scan <dir> <symbol> [to]\n"
+        "    times looking for a symbol in every file under <dir>, on one\n"
+        "    thread then on the pool; renames it to <to> in them if given\n", stderr);
+  fputs("  map [-w] [-f] [-i] <map> <file>...\n"
+        "    replaces the names of a map in the files in a pass each and\n"
+        "    prints the diff, -i rewrites them instead; -w matches whole\n"
+        "    words only, -f converts the names not in the map by the rules\n", stderr);
+  fputs("  check\n"
+        "    checks the engine against known conversions, name maps, rule\n"
+        "    merges and allocation budgets\n", stderr);
+}
+
+int main(int argc, char **argv)
+{
+  gboolean verbose = FALSE;
+  gint     arg = 2;
+
+  if (argc >= 2 && strcmp(argv[1], "stress") == 0)
+    return stress(argc > 2 ? MAX(atoi(argv[2]), 1) : 4, argc > 3 ? MAX(atoi(argv[3]), 1) : 10000);
+
+  if (argc >= 3 && strcmp(argv[1], "import") == 0)
+    return import(argv[2], argc > 3 ? argv[3] : NULL);
+
+  if (argc >= 4 && strcmp(argv[1], "search") == 0)
+    return search(argv[2], argv[3]);
+
+  if (argc >= 3 && strcmp(argv[1], "occur") == 0)
+    return occur(argv[2], argc > 3 ? MAX(atoi(argv[3]), 0) : 10000);
+
+  if (argc >= 3 && strcmp(argv[1], "bulk") == 0)
+    return bulk(argv[2], argc > 3 ? argv[3] : NULL);
+
+  if (argc >= 4 && strcmp(argv[1], "scan") == 0)
+    return scan_tree(argv[2], argv[3], argc > 4 ? argv[4] : NULL);
+
+  if (argc >= 2 && strcmp(argv[1], "map") == 0)
+    return map_files(argc - 2, argv + 2);
+
+  if (argc >= 2 && strcmp(argv[1], "check") == 0)
+    return check();
+
+  if (argc < 3 || strcmp(argv[1], "replay") != 0) {
+    usage();
+    return 1;
+  }
+
+  if (strcmp(argv[arg], "-v") == 0) {
+    verbose = TRUE;
+    ++arg;
+  }
+
+  if (arg >= argc) {
+    usage();
+    return 1;
+  }
+
+  return replay(argv[arg], verbose);
+}
@@ -0,0 +1,106 @@
+/*
+ *  caseconvert_trace.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_trace.h"
+#include "caseconvert_probes.h"
+#include <glib/gprintf.h>
+#include <stdarg.h>
+#include <string.h>
+
+gboolean cc_trace_enabled = FALSE;
+
+#ifdef HAVE_SYS_SDT_H
+/* USDT semaphores, bumped by the tracer when a probe is attached */
+# define CC_PROBE_DEFINE_SEMAPHORE(name) \
+  unsigned short CC_PROBE_SEMAPHORE(name) __attribute__((section(".probes")));
+CC_PROBE_SEMAPHORES(CC_PROBE_DEFINE_SEMAPHORE)
+#endif
+
+static cc_trace_rec_t ring[CC_TRACE_RING_SZ];
+static volatile gint  ring_head = 0; /* total number of records pushed */
+
+static const gchar *event_names[CC_EV_COUNT] = {
+  "null",
+  "convert.begin",
+  "convert.end",
+  "rule.match",
+  "tokenized",
+  "range.begin",
+  "range.hit",
+  "range.end",
+  "settings.load",
+  "settings.save"
+};
+
+void cc_log(const char *fmt, ...)
+{
+  va_list args;
+  gchar *msg = NULL;
+
+  va_start(args, fmt);
+  g_vasprintf(&msg, fmt, args);
+  va_end(args);
+
+  fputs(msg, stdout);
+  g_free(msg);
+}
+
+void cc_trace_push(cc_event_t ev, gint32 a, gint32 b)
+{
+  /* the slot is claimed atomically so concurrent writers never share one */
+  guint slot = (guint)g_atomic_int_add(&ring_head, 1) & (CC_TRACE_RING_SZ - 1);
+  cc_trace_rec_t *rec = &ring[slot];
+
+  rec->ts = g_get_monotonic_time();
+  rec->event = ev;
+  rec->a = a;
+  rec->b = b;
+}
+
+void cc_trace_enable(gboolean on)
+{
+  if (on && !cc_trace_enabled) {
+    memset(ring, 0, sizeof(ring));
+    g_atomic_int_set(&ring_head, 0);
+  }
+
+  cc_trace_enabled = on;
+}
+
+void cc_trace_dump(FILE *out)
+{
+  guint head = (guint)g_atomic_int_get(&ring_head);
+  guint first = head > CC_TRACE_RING_SZ ? head - CC_TRACE_RING_SZ : 0;
+  guint i;
+  gint64 t0 = 0;
+
+  g_fprintf(out, "# caseconvert trace: %u events (%u dropped)\n", head - first, first);
+
+  for (i = first; i < head; ++i) {
+    cc_trace_rec_t *rec = &ring[i & (CC_TRACE_RING_SZ - 1)];
+
+    if (!t0) t0 = rec->ts;
+
+    g_fprintf(out, "%10ld us  %-14s %8d %8d\n",
+      (long)(rec->ts - t0),
+      rec->event < CC_EV_COUNT ? event_names[rec->event] : "?",
+      rec->a,
+      rec->b);
+  }
+}
@@ -0,0 +1,122 @@
+/*
+ *  caseconvert_trace.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_TRACE_H
+#define H_GEANY_CASE_CONVERT_TRACE_H
+
+#include <glib.h>
+#include <stdio.h>
+
+/* compile-time trace levels: any message above CC_TRACE_LEVEL is compiled
+ * out along with the evaluation of its arguments, ie:
+ *
+ *  gcc -DCC_TRACE_LEVEL=3 ...   => warnings, info and debug messages
+ *
+ * -DVERBOSE is still honoured and selects CC_TRACE_DEBUG
+ */
+#define CC_TRACE_NONE     0
+#define CC_TRACE_WARN     1
+#define CC_TRACE_INFO     2
+#define CC_TRACE_DEBUG    3
+#define CC_TRACE_VERBOSE  4 /* per-token and per-occurence chatter */
+
+#ifndef CC_TRACE_LEVEL
+# ifdef VERBOSE
+#  define CC_TRACE_LEVEL CC_TRACE_DEBUG
+# else
+#  define CC_TRACE_LEVEL CC_TRACE_WARN
+# endif
+#endif
+
+/* formats and prints a message, use the leveled macros below instead */
+void cc_log(const char *fmt, ...) G_GNUC_PRINTF(1, 2);
+
+/* "while (0) f(...)" keeps the call type-checked but never evaluates it */
+#define CC_TRACE_DISCARD while (0) cc_log
+
+#if CC_TRACE_LEVEL >= CC_TRACE_WARN
+# define cc_warn cc_log
+#else
+# define cc_warn CC_TRACE_DISCARD
+#endif
+
+#if CC_TRACE_LEVEL >= CC_TRACE_INFO
+# define cc_info cc_log
+#else
+# define cc_info CC_TRACE_DISCARD
+#endif
+
+#if CC_TRACE_LEVEL >= CC_TRACE_DEBUG
+# define cc_debug cc_log
+#else
+# define cc_debug CC_TRACE_DISCARD
+#endif
+
+#if CC_TRACE_LEVEL >= CC_TRACE_VERBOSE
+# define cc_verbose cc_log
+#else
+# define cc_verbose CC_TRACE_DISCARD
+#endif
+
+/*
+ * Runtime tracer for the hot paths.
+ *
+ * Events are written as fixed-size binary records into a ring buffer and are
+ * only formatted when the buffer is dumped, so recording an event costs a
+ * timestamp and three stores. When the tracer is disabled, cc_trace_event()
+ * is a single predictable branch.
+ */
+typedef enum {
+  CC_EV_NULL = 0,
+  CC_EV_CONVERT_BEGIN,  /* a: input length */
+  CC_EV_CONVERT_END,    /* a: input length, b: output length (-1 on failure) */
+  CC_EV_RULE_MATCH,     /* a: rule id, b: condition type */
+  CC_EV_TOKENIZED,      /* a: number of tokens */
+  CC_EV_RANGE_BEGIN,    /* a: range start, b: range end */
+  CC_EV_RANGE_HIT,      /* a: position of the occurence, b: its length */
+  CC_EV_RANGE_END,      /* a: number of replaced occurences */
+  CC_EV_SETTINGS_LOAD,  /* a: number of rules loaded */
+  CC_EV_SETTINGS_SAVE,  /* a: number of rules saved, b: bytes written */
+  CC_EV_COUNT
+} cc_event_t;
+
+typedef struct {
+  gint64  ts;     /* monotonic time in microseconds */
+  guint32 event;  /* cc_event_t */
+  gint32  a;
+  gint32  b;
+} cc_trace_rec_t;
+
+/* must be a power of 2 */
+#define CC_TRACE_RING_SZ 4096
+
+extern gboolean cc_trace_enabled;
+
+#define cc_trace_event(ev, a, b) \
+  do { if (G_UNLIKELY(cc_trace_enabled)) cc_trace_push((ev), (a), (b)); } while (0)
+
+void cc_trace_push(cc_event_t ev, gint32 a, gint32 b);
+
+/* enables or disables recording, enabling discards previous records */
+void cc_trace_enable(gboolean on);
+
+/* formats the recorded events, oldest first, into the given stream */
+void cc_trace_dump(FILE *out);
+
+#endif
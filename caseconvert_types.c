@@ -18,7 +18,8 @@
  */
 
 #include "caseconvert_types.h"
-#include "caseconvert.h"
+#include "caseconvert_engine.h"
+#include <string.h>
 
 static gint rule_id; /* generates IDs for rule objects */
 static gint get_rule_id();
@@ -26,17 +27,33 @@ static gint get_rule_id();
 /* helper for allocating a rule object */
 rule_t* cc_alloc_rule()
 {
-  rule_t* r = g_malloc(sizeof(rule_t));
+  return cc_alloc_rule_id(get_rule_id());
+}
+
+rule_t* cc_alloc_rule_id(gint id)
+{
+  rule_t* r = cc_malloc(CC_MEM_RULES, sizeof(rule_t));
   r->condition = NULL;
   r->actions = NULL;
   r->next = NULL;
-  r->id = get_rule_id();
+  r->id = id;
   r->label = NULL;
+  r->filetypes = NULL;
   r->enabled = TRUE;
+  r->def = NULL;
+  memset(&r->prog, 0, sizeof(cc_prog_t));
 
   return r;
 }
 
+void cc_set_rule_id(rule_t *r, gint id)
+{
+  r->id = id;
+
+  cc_free(r->def);
+  r->def = NULL;
+}
+
 /* helper for freeing a rule_t object, along with its condition and list of actions */
 void cc_free_rule(rule_t** in)
 {
@@ -56,21 +73,183 @@ void cc_free_rule(rule_t** in)
   }
 
   if (r->label) {
-    g_free(r->label);
+    cc_free(r->label);
     r->label = NULL;
   }
 
-  g_free(r);
+  cc_free(r->filetypes);
+  cc_free(r->def);
+
+  if (r->prog.regex)
+    g_regex_unref(r->prog.regex);
+
+  cc_free(r->prog.strings);
+  cc_free(r);
 
   (*in) = NULL;
   r = NULL;
 }
 
+/* copies "value" at "cursor", moving it past the copy */
+static const gchar* keep_value(gchar **cursor, const gchar *value)
+{
+  gchar *copy = *cursor;
+  gsize sz = strlen(value) + 1;
+
+  memcpy(copy, value, sz);
+  *cursor += sz;
+
+  return copy;
+}
+
+void cc_compile_rule(rule_t *r)
+{
+  cc_prog_t *prog = &r->prog;
+  action_t  *act = NULL;
+  cc_op_t   *op = NULL;
+  GRegex    *regex = prog->regex;
+  GError    *err = NULL;
+  gchar     *cursor = NULL;
+  gsize     sz = 0;
+  gint      i;
+
+  cc_free(prog->strings);
+  memset(prog, 0, sizeof(cc_prog_t));
+
+  cc_free(r->def);
+  r->def = NULL;
+
+  /* the values are copied into a single block the rule owns, so they stay
+   * as they were compiled until it's compiled again or freed */
+  if (r->condition && r->condition->value)
+    sz += strlen(r->condition->value) + 1;
+
+  for (act = r->actions, i = 0; act != NULL && i < CC_PROG_MAX_OPS; act = act->next, ++i)
+    sz += (act->value ? strlen(act->value) : 0) + 1;
+
+  if (sz)
+    prog->strings = cursor = cc_malloc(CC_MEM_RULES, sz);
+
+  if (r->condition) {
+    prog->cnd_type = r->condition->type;
+    prog->cnd_value = r->condition->value ? keep_value(&cursor, r->condition->value) : NULL;
+    prog->cnd_len = prog->cnd_value ? strlen(prog->cnd_value) : 0;
+  }
+
+  /* expressions are only compiled when they change */
+  if (prog->cnd_type == CC_CND_MATCHES) {
+    if (regex && g_strcmp0(g_regex_get_pattern(regex), prog->cnd_value) == 0) {
+      prog->regex = regex;
+      regex = NULL;
+    }
+    else if (!(prog->regex = g_regex_new(prog->cnd_value ? prog->cnd_value : "", G_REGEX_OPTIMIZE, 0, &err))) {
+      cc_warn("WARN: rule %d has an invalid expression, it will never match: %s\n", r->id, err->message);
+      prog->cnd_type = CC_CND_NULL;
+      g_error_free(err);
+    }
+  }
+
+  if (regex)
+    g_regex_unref(regex);
+
+  for (act = r->actions; act != NULL; act = act->next)
+  {
+    if (prog->nr_ops == CC_PROG_MAX_OPS) {
+      cc_warn("WARN: rule %d has more than %d actions, ignoring the rest\n", r->id, CC_PROG_MAX_OPS);
+      break;
+    }
+
+    op = &prog->ops[prog->nr_ops++];
+    op->type = act->type;
+    op->value = keep_value(&cursor, act->value ? act->value : "");
+    op->len = strlen(op->value);
+
+    switch (op->type)
+    {
+      case CC_ACT_ADD_PREFIX:
+        prog->add_prefix = op->value;
+        prog->add_prefix_len = op->len;
+      break;
+      case CC_ACT_ADD_SUFFIX:
+        prog->add_suffix = op->value;
+        prog->add_suffix_len = op->len;
+      break;
+      case CC_ACT_REM_PREFIX:
+        prog->rem_prefix += op->len;
+        prog->rem_prefix_match |= (op->len == 0 && prog->regex);
+      break;
+      case CC_ACT_REM_SUFFIX:
+        prog->rem_suffix += op->len;
+        prog->rem_suffix_match |= (op->len == 0 && prog->regex);
+      break;
+      default: ;
+    }
+  }
+}
+
+const gchar* cc_check_rule(const rule_t *r)
+{
+  const cc_prog_t *prog = &r->prog;
+  action_t        *act = NULL;
+  gint            nr_actions = 0;
+
+  if (r->domain != CC_RULE_S2C && r->domain != CC_RULE_C2S)
+    return "unknown domain";
+
+  if (!r->condition)
+    return "no condition";
+
+  switch (r->condition->type)
+  {
+    case CC_CND_HAS_PREFIX:
+    case CC_CND_HAS_SUFFIX:
+      if (!prog->cnd_len)
+        return "the condition has nothing to look for";
+    break;
+    case CC_CND_MATCHES:
+      if (!prog->regex)
+        return "invalid regular expression";
+    break;
+    case CC_CND_ALWAYS_TRUE:
+    break;
+    default:
+      return "unknown condition";
+  }
+
+  for (act = r->actions; act != NULL; act = act->next, ++nr_actions)
+  {
+    switch (act->type)
+    {
+      case CC_ACT_ADD_PREFIX:
+      case CC_ACT_ADD_SUFFIX:
+        if (!act->value || !*act->value)
+          return "an action has nothing to add";
+      break;
+      case CC_ACT_REM_PREFIX:
+      case CC_ACT_REM_SUFFIX:
+        /* removing the match, see cc_prog_t */
+        if ((!act->value || !*act->value) && !prog->regex)
+          return "an action has nothing to remove";
+      break;
+      default:
+        return "unknown action";
+    }
+  }
+
+  if (!nr_actions)
+    return "no actions";
+
+  if (nr_actions > CC_PROG_MAX_OPS)
+    return "too many actions";
+
+  return NULL;
+}
+
 condition_t* cc_alloc_cnd()
 {
   condition_t* c = NULL;
 
-  c = g_malloc(sizeof(condition_t));
+  c = cc_malloc(CC_MEM_RULES, sizeof(condition_t));
   if (!c)
     return NULL;
 
@@ -85,11 +264,11 @@ void cc_free_cnd(condition_t** in_c)
   condition_t* c = *in_c;
 
   if (c->value) {
-    g_free(c->value);
+    cc_free(c->value);
     c->value = NULL;
   }
 
-  g_free(c);
+  cc_free(c);
 
   (*in_c) = NULL;
 }
@@ -98,7 +277,7 @@ action_t* cc_alloc_act()
 {
   action_t* a = NULL;
 
-  a = g_malloc(sizeof(action_t));
+  a = cc_malloc(CC_MEM_RULES, sizeof(action_t));
   if (!a)
     return NULL;
 
@@ -114,27 +293,21 @@ void cc_free_act(action_t** in_a)
   action_t* a = *in_a;
 
   if (a->value) {
-    g_free(a->value);
+    cc_free(a->value);
     a->value = NULL;
   }
 
   a->next = NULL;
 
-  g_free(a);
+  cc_free(a);
 
   (*in_a) = NULL;
 }
 
+/* new rules are numbered after any rule ever registered */
 static gint get_rule_id()
 {
-  rule_t  *rules = cc_get_rules();
-  rule_t  *r = NULL;
-  gint    max_id = rule_id;
-
-  for (r = rules; r != NULL; r = r->next)
-    if (r->id > max_id) max_id = r->id;
-
-  rule_id = max_id + 1;
+  rule_id = MAX(rule_id, cc_get_config()->max_id) + 1;
 
   return rule_id;
 }
@@ -30,7 +30,8 @@ typedef struct {
     CC_CND_NULL = 0,
     CC_CND_HAS_PREFIX,
     CC_CND_HAS_SUFFIX,
-    CC_CND_ALWAYS_TRUE
+    CC_CND_ALWAYS_TRUE,
+    CC_CND_MATCHES    /* the value is a regular expression */
   } type;
 
   gchar *value; /* text to look for, if eligible */
@@ -49,6 +50,66 @@ struct action_t {
   action_t  *next;
 };
 
+/* an action compiled for the converter, the value is interned */
+typedef struct {
+  gint        type;
+  const gchar *value;
+  gint        len;
+} cc_op_t;
+
+#define CC_PROG_MAX_OPS 8
+
+/* what the rule set analysis found out about a rule, see cc_analyze_rules() */
+typedef enum {
+  CC_RULE_LIVE = 0,
+  CC_RULE_SHADOWED,   /* an earlier rule always applies first */
+  CC_RULE_DUPLICATE,  /* an earlier rule has the very same condition */
+  CC_RULE_IMPOSSIBLE  /* the rule can't apply as written */
+} cc_rule_status_t;
+
+/*
+ * A rule compiled by cc_compile_rule(): its condition and actions as a flat
+ * program, along with what running the actions amounts to so the converter
+ * never walks the action list nor measures a value. Applied to an input of
+ * "n" bytes, the actions produce exactly
+ *
+ *  add_prefix_len + MAX(n - rem_prefix - rem_suffix, 0) + add_suffix_len
+ *
+ * bytes for the case transform to work on, see CC_PROG_LENGTH().
+ *
+ * A regex rule's removals with an empty value remove the match instead:
+ * everything up to its end for prefixes, from its start for suffixes. The
+ * match is the first capture group if the expression has one, ie a rule
+ * matching "^(m_|s_)[a-z]" with an empty prefix removal turns "m_foo_bar"
+ * into "fooBar".
+ */
+typedef struct {
+  gchar       *strings;       /* the values below point into it, owned */
+
+  gint        cnd_type;
+  const gchar *cnd_value;
+  gint        cnd_len;
+  GRegex      *regex;         /* CC_CND_MATCHES, compiled once */
+
+  cc_op_t     ops[CC_PROG_MAX_OPS];
+  gint        nr_ops;
+
+  gint        rem_prefix;     /* bytes stripped off the front */
+  gint        rem_suffix;     /* bytes stripped off the back */
+  const gchar *add_prefix;    /* NULL if none, the last one wins */
+  gint        add_prefix_len;
+  const gchar *add_suffix;
+  gint        add_suffix_len;
+  gboolean    rem_prefix_match; /* see above */
+  gboolean    rem_suffix_match;
+
+  cc_rule_status_t status;    /* only live rules are ever tried */
+  gint        shadowed_by;    /* the earlier rule, if shadowed or a duplicate */
+} cc_prog_t;
+
+#define CC_PROG_LENGTH(prog, n) \
+  ((prog)->add_prefix_len + MAX((gint)(n) - (prog)->rem_prefix - (prog)->rem_suffix, 0) + (prog)->add_suffix_len)
+
 struct rule_t {
   enum {
     CC_RULE_NULL = 0,
@@ -60,14 +121,36 @@ struct rule_t {
   action_t    *actions;
   rule_t      *next;
   gchar       *label; /* optional identifier */
+  gchar       *filetypes; /* ';' separated Geany filetypes the rule is scoped
+                           * to, NULL if it applies to every document */
   gint        id;     /* unique identifier, automatically generated */
   gboolean    enabled;
+  cc_prog_t   prog;   /* see cc_compile_rule() */
+  gchar       *def;   /* the serialized rule, NULL until it's serialized and
+                       * whenever it's edited or renumbered since, see
+                       * cc_compile_rule() and cc_set_rule_id() */
 };
 
 /* helpers for allocating and freeing objects */
 rule_t*       cc_alloc_rule();
 void          cc_free_rule(rule_t**);
 
+/* allocates a rule with the given id instead of a new one, this doesn't
+ * look at the registered rules so it may be called from any thread */
+rule_t*       cc_alloc_rule_id(gint id);
+
+/* gives a rule another id, dropping its cached definition which has the old one */
+void          cc_set_rule_id(rule_t*, gint id);
+
+/* (re)compiles the condition and actions of a rule into its program; a
+ * rule is recompiled whenever it's edited, which also drops its cached
+ * definition */
+void          cc_compile_rule(rule_t*);
+
+/* checks a compiled rule can apply as written and would be read back from
+ * its definition, returns what's wrong with it or NULL */
+const gchar*  cc_check_rule(const rule_t*);
+
 condition_t*  cc_alloc_cnd();
 void          cc_free_cnd(condition_t**);
 
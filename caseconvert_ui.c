@@ -19,6 +19,8 @@
 
 #include "caseconvert_ui.h"
 #include "caseconvert.h"
+#include "caseconvert_rulelist.h"
+#include "caseconvert_probes.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -39,6 +41,7 @@ typedef struct {
   GtkRadioButton *opt_cnd_has_prefix;
   GtkRadioButton *opt_cnd_has_suffix;
   GtkRadioButton *opt_cnd_always_true;
+  GtkRadioButton *opt_cnd_matches;
 
   /* actions radio buttons */
   GtkCheckButton *opt_act_rem_prefix;
@@ -52,15 +55,9 @@ typedef struct {
   GtkEntry *txt_act_add_prefix;
   GtkEntry *txt_act_add_suffix;
 
-} add_rule_dlg_t;
+  GtkEntry *txt_filetypes;
 
-enum ER_COLS {
-    ER_COL_ID,
-    ER_COL_ENABLED,
-    ER_COL_LABEL,
-    ER_COL_CND,
-    ER_COL_ACT
-  };
+} add_rule_dlg_t;
 
 typedef struct {
 
@@ -72,6 +69,10 @@ typedef struct {
   GtkCellRendererText* cell_label;
   GtkCellRendererToggle* cell_enabled;
 
+  GtkTreeView *tree;
+  CcRuleList  *rules;     /* the model, over the rule store */
+  GtkEntry    *txt_filter;
+
 } edit_rules_dlg_t;
 
 typedef struct {
@@ -87,15 +88,29 @@ typedef struct {
   GtkCheckButton *opt_start_word;
 
   GtkEntry *txt_search;
+  GtkLabel *lbl_count;  /* how many there are, for indexed documents */
+
+  /* what converting in the document would change, planned while it's
+   * expanded; the conversion then applies that plan */
+  GtkExpander *exp_preview;
+  GtkTextView *txt_preview;
 } convert_more_dlg_t;
 
+#define CC_PREVIEW_HUNKS 500 /* lines shown in the Convert More preview */
+
 typedef struct {
   GtkWidget     *main_menu;
   GtkWidget     *convert_selection;
   GtkWidget     *convert_all;
   GtkWidget     *convert_more;
+  GtkWidget     *convert_everywhere;
+  GtkWidget     *convert_document;
+  GtkWidget     *convert_map;
+  GtkWidget     *cycle_style;
   GtkWidget     *add_rule;
   GtkWidget     *edit_rules;
+  GtkWidget     *import_rules;
+  GtkWidget     *export_rules;
 } menu_items_t;
 
 /* defined in caseconvert.c */
@@ -111,13 +126,15 @@ static edit_rules_dlg_t   *edit_rules_dlg = NULL;
 static convert_more_dlg_t *convert_more_dlg = NULL;
 static const char         *ui_file_path = "/home/kandie/Workspace/Projects/geany/caseconvert/caseconvert-ui.xml";
 
-static void populate_rule_list();
+static void setup_rule_list();
 
 /* UI event handlers */
 static void on_add_rule_btn_create(GtkWidget*);
 
 static void on_convert_more_btn_selection(GtkWidget*);
 static void on_convert_more_btn_document(GtkWidget*);
+static void on_convert_more_search_changed();
+static void on_convert_more_preview();
 
 static void on_er_enabled_toggled(GtkCellRendererToggle *cell,
                                    gchar                 *path_string,
@@ -127,6 +144,11 @@ static void on_er_label_edited (GtkCellRendererText *cell,
                                 gchar               *new_text,
                                 gpointer             user_data);
 static void on_er_btn_save();
+static void on_er_filter_changed();
+
+static void on_import_rules();
+static void on_convert_map();
+static void on_export_rules();
 
 /* keybindings */
 PLUGIN_KEY_GROUP(convert_case, KB_COUNT)
@@ -134,7 +156,7 @@ PLUGIN_KEY_GROUP(convert_case, KB_COUNT)
 static void load_ui_xml()
 {
   ui_xml_datasz = 26973;
-  ui_xml_data = g_malloc(sizeof(gchar) * (ui_xml_datasz + 1));
+  ui_xml_data = cc_malloc(CC_MEM_UI, sizeof(gchar) * (ui_xml_datasz + 1));
   memset(ui_xml_data, 0, ui_xml_datasz);
 
   strcat(ui_xml_data, "<?xml version='1.0' encoding='UTF-8'?><interface><requires lib='gtk+' version='2.24'/><object class='GtkDialog' id='cc_dlg_add_rule'><property name='width_request'>400</property><property name='can_focus'>False</property><property name='border_width'>5</property><property name='title' translatable='yes'>Case Convert - Add Rule</property><property name='modal'>True</property><property name='type_hint'>dialog</property><property name='has_separator'>True</property><signal name='delete-event' handler='gtk");
@@ -192,12 +214,12 @@ static void load_ui_xml()
   strcat(ui_xml_data, "ld><action-widgets><action-widget response='0'>cc_er_btn_save</action-widget><action-widget response='0'>cc_er_btn_cancel</action-widget></action-widgets></object><object class='GtkListStore' id='cc_er_rules_list'><columns><column type='gint'/><column type='gboolean'/><column type='gchararray'/><column type='gchararray'/><column type='gchararray'/></columns><data><row><col id='0'>0</col><col id='1'>False</col><col id='2' translatable='yes'>Foobar</col><col id='3' translatable='yes'>Begins with 'm'</col");
 
   ui_xml_data[ui_xml_datasz] = '\0';
-  cc_log("XML Data: %s\n", ui_xml_data);
+  cc_verbose("XML Data: %s\n", ui_xml_data);
 }
 
 static void unload_ui_xml()
 {
-  g_free(ui_xml_data);
+  cc_free(ui_xml_data);
   ui_xml_data = NULL;
 }
 
@@ -206,7 +228,11 @@ void cc_ui_init()
   GtkContainer *menu = NULL;
   GtkWidget *item = NULL;
   GError *err = NULL;
-  menu_items = g_malloc(sizeof(menu_items_t));
+  gint64 t0 = CC_PROBE_CLOCK(ui__init__return);
+
+  CC_PROBE0(ui__init__entry);
+
+  menu_items = cc_malloc(CC_MEM_UI, sizeof(menu_items_t));
 
 	item = gtk_menu_item_new_with_mnemonic(_("Con_vert Case"));
 	main_menu_item = item;
@@ -234,6 +260,26 @@ void cc_ui_init()
 	g_signal_connect(item, "activate", G_CALLBACK(cc_ui_show_convert_more_dialog), NULL);
   menu_items->convert_more = item;
 
+	item = gtk_menu_item_new_with_mnemonic(_("Convert _Everywhere"));
+	gtk_container_add(menu, item);
+	g_signal_connect(item, "activate", G_CALLBACK(cc_convert_everywhere), NULL);
+  menu_items->convert_everywhere = item;
+
+	item = gtk_menu_item_new_with_mnemonic(_("Convert _Names"));
+	gtk_container_add(menu, item);
+	g_signal_connect(item, "activate", G_CALLBACK(cc_convert_document), NULL);
+  menu_items->convert_document = item;
+
+	item = gtk_menu_item_new_with_mnemonic(_("Convert from Ma_p..."));
+	gtk_container_add(menu, item);
+	g_signal_connect(item, "activate", G_CALLBACK(on_convert_map), NULL);
+  menu_items->convert_map = item;
+
+	item = gtk_menu_item_new_with_mnemonic(_("C_ycle Case Style"));
+	gtk_container_add(menu, item);
+	g_signal_connect(item, "activate", G_CALLBACK(cc_cycle_selection), NULL);
+  menu_items->cycle_style = item;
+
   item = gtk_separator_menu_item_new();
 	gtk_widget_show(item);
 	gtk_container_add(GTK_CONTAINER(menu), item);
@@ -248,6 +294,16 @@ void cc_ui_init()
 	g_signal_connect(item, "activate", G_CALLBACK(cc_ui_show_edit_rules_dialog), NULL);
   menu_items->edit_rules = item;
 
+	item = gtk_menu_item_new_with_mnemonic(_("_Import Rules..."));
+	gtk_container_add(menu, item);
+	g_signal_connect(item, "activate", G_CALLBACK(on_import_rules), NULL);
+  menu_items->import_rules = item;
+
+	item = gtk_menu_item_new_with_mnemonic(_("E_xport Rules..."));
+	gtk_container_add(menu, item);
+	g_signal_connect(item, "activate", G_CALLBACK(on_export_rules), NULL);
+  menu_items->export_rules = item;
+
   gtk_widget_show_all(main_menu_item);
 
   load_ui_xml();
@@ -256,25 +312,26 @@ void cc_ui_init()
   /*if (gtk_builder_add_from_file(builder, ui_file_path, &err) == 0)*/
   if (gtk_builder_add_from_string(builder, ui_xml_data, ui_xml_datasz, &err) == 0)
   {
-    cc_log("unable to read GTK UI definition\n");
+    cc_warn("unable to read GTK UI definition\n");
     if (err->domain == GTK_BUILDER_ERROR)
-      cc_log("\tcause: builder error '%s'\n", err->message);
+      cc_warn("\tcause: builder error '%s'\n", err->message);
     else if (err->domain == G_MARKUP_ERROR)
-      cc_log("\tcause: markup error '%s'\n", err->message);
+      cc_warn("\tcause: markup error '%s'\n", err->message);
     else if (err->domain == G_FILE_ERROR)
-      cc_log("\tcause: file error '%s'\n", err->message);
+      cc_warn("\tcause: file error '%s'\n", err->message);
     else
-      cc_log("\tcause: unknown error\n");
+      cc_warn("\tcause: unknown error\n");
 
     unload_ui_xml();
+    CC_PROBE1(ui__init__return, CC_PROBE_ELAPSED(t0));
     return;
   }
 
   unload_ui_xml();
-  cc_log("read GTK UI definition successfully, binding widgets\n");
+  cc_info("read GTK UI definition successfully, binding widgets\n");
 
   /* set up the Add Rule dialog */
-  add_rule_dlg = g_malloc(sizeof(add_rule_dlg_t));
+  add_rule_dlg = cc_malloc(CC_MEM_UI, sizeof(add_rule_dlg_t));
 
   add_rule_dlg->dlg = (GtkDialog*)(gtk_builder_get_object(builder, "cc_dlg_add_rule"));
   add_rule_dlg->btn_cancel = (GtkButton*)(gtk_builder_get_object(builder, "btn_cancel"));
@@ -287,6 +344,16 @@ void cc_ui_init()
   add_rule_dlg->opt_cnd_has_suffix   = (GtkRadioButton*)(gtk_builder_get_object(builder, "opt_cnd_has_suffix"));
   add_rule_dlg->opt_cnd_always_true  = (GtkRadioButton*)(gtk_builder_get_object(builder, "opt_cnd_always_true"));
 
+  /* not in the UI definition, it goes right after "Always true" */
+  add_rule_dlg->opt_cnd_matches = (GtkRadioButton*)gtk_radio_button_new_with_label_from_widget(
+    add_rule_dlg->opt_cnd_has_prefix, _("Matches"));
+  gtk_widget_set_tooltip_text((GtkWidget*)add_rule_dlg->opt_cnd_matches,
+    _("Any string matching this regular expression will be captured by this rule, "
+      "empty removals remove the match (or its first group)"));
+  gtk_box_pack_start(GTK_BOX(gtk_widget_get_parent((GtkWidget*)add_rule_dlg->opt_cnd_always_true)),
+    (GtkWidget*)add_rule_dlg->opt_cnd_matches, TRUE, TRUE, 0);
+  gtk_widget_show((GtkWidget*)add_rule_dlg->opt_cnd_matches);
+
   add_rule_dlg->opt_act_rem_prefix  = (GtkCheckButton*)(gtk_builder_get_object(builder, "opt_act_rem_prefix"));
   add_rule_dlg->opt_act_rem_suffix  = (GtkCheckButton*)(gtk_builder_get_object(builder, "opt_act_rem_suffix"));
   add_rule_dlg->opt_act_add_prefix  = (GtkCheckButton*)(gtk_builder_get_object(builder, "opt_act_add_prefix"));
@@ -298,12 +365,26 @@ void cc_ui_init()
   add_rule_dlg->txt_act_add_prefix  = (GtkEntry*)(gtk_builder_get_object(builder, "txt_add_prefix"));
   add_rule_dlg->txt_act_add_suffix  = (GtkEntry*)(gtk_builder_get_object(builder, "txt_add_suffix"));
 
+  /* not in the UI definition either, it goes below the actions */
+  {
+    GtkWidget *box = gtk_hbox_new(FALSE, 6);
+
+    add_rule_dlg->txt_filetypes = (GtkEntry*)gtk_entry_new();
+    gtk_widget_set_tooltip_text((GtkWidget*)add_rule_dlg->txt_filetypes,
+      _("The filetypes this rule is limited to, separated by ';' (ie C;C++), "
+        "leave empty for the rule to apply to every document"));
+    gtk_box_pack_start(GTK_BOX(box), gtk_label_new(_("Filetypes:")), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), (GtkWidget*)add_rule_dlg->txt_filetypes, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(add_rule_dlg->dlg)), box, FALSE, FALSE, 0);
+    gtk_widget_show_all(box);
+  }
+
   g_signal_connect(add_rule_dlg->dlg, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
   g_signal_connect(add_rule_dlg->btn_create, "clicked", G_CALLBACK(on_add_rule_btn_create), NULL);
   g_signal_connect(add_rule_dlg->btn_cancel, "clicked", G_CALLBACK(cc_ui_hide_add_rule_dialog), NULL);
 
   /* set up the Convert dialog */
-  convert_more_dlg = g_malloc(sizeof(convert_more_dlg_t));
+  convert_more_dlg = cc_malloc(CC_MEM_UI, sizeof(convert_more_dlg_t));
 
   convert_more_dlg->dlg = (GtkDialog*)(gtk_builder_get_object(builder, "cc_dlg_convert"));
 
@@ -322,8 +403,43 @@ void cc_ui_init()
   g_signal_connect(convert_more_dlg->btn_selection, "clicked", G_CALLBACK(on_convert_more_btn_selection), NULL);
   g_signal_connect(convert_more_dlg->btn_document, "clicked", G_CALLBACK(on_convert_more_btn_document), NULL);
 
+  /* the dialog XML has no room for the count */
+  convert_more_dlg->lbl_count = (GtkLabel*)gtk_label_new(NULL);
+  gtk_misc_set_alignment(GTK_MISC(convert_more_dlg->lbl_count), 0, 0.5);
+  gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(convert_more_dlg->dlg)),
+    (GtkWidget*)convert_more_dlg->lbl_count, FALSE, FALSE, 0);
+
+  /* nor for the preview */
+  {
+    GtkWidget             *scroll = gtk_scrolled_window_new(NULL, NULL);
+    PangoFontDescription  *font = pango_font_description_from_string("Monospace");
+
+    convert_more_dlg->txt_preview = (GtkTextView*)gtk_text_view_new();
+    gtk_text_view_set_editable(convert_more_dlg->txt_preview, FALSE);
+    gtk_text_view_set_cursor_visible(convert_more_dlg->txt_preview, FALSE);
+    gtk_widget_modify_font((GtkWidget*)convert_more_dlg->txt_preview, font);
+    pango_font_description_free(font);
+
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scroll), GTK_SHADOW_IN);
+    gtk_widget_set_size_request(scroll, -1, 200);
+    gtk_container_add(GTK_CONTAINER(scroll), (GtkWidget*)convert_more_dlg->txt_preview);
+
+    convert_more_dlg->exp_preview = (GtkExpander*)gtk_expander_new_with_mnemonic(_("_Preview"));
+    gtk_container_add(GTK_CONTAINER(convert_more_dlg->exp_preview), scroll);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(convert_more_dlg->dlg)),
+      (GtkWidget*)convert_more_dlg->exp_preview, TRUE, TRUE, 0);
+  }
+
+  g_signal_connect(convert_more_dlg->exp_preview, "notify::expanded", G_CALLBACK(on_convert_more_preview), NULL);
+
+  g_signal_connect(convert_more_dlg->txt_search, "changed", G_CALLBACK(on_convert_more_search_changed), NULL);
+  g_signal_connect(convert_more_dlg->opt_case_sensitive, "toggled", G_CALLBACK(on_convert_more_search_changed), NULL);
+  g_signal_connect(convert_more_dlg->opt_whole_word, "toggled", G_CALLBACK(on_convert_more_search_changed), NULL);
+  g_signal_connect(convert_more_dlg->opt_start_word, "toggled", G_CALLBACK(on_convert_more_search_changed), NULL);
+
   /* set up the Edit Rules dialog */
-  edit_rules_dlg = g_malloc(sizeof(edit_rules_dlg_t));
+  edit_rules_dlg = cc_malloc(CC_MEM_UI, sizeof(edit_rules_dlg_t));
 
   edit_rules_dlg->dlg = (GtkDialog*)(gtk_builder_get_object(builder, "cc_dlg_edit_rules"));
   g_signal_connect(edit_rules_dlg->dlg, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
@@ -338,6 +454,9 @@ void cc_ui_init()
   edit_rules_dlg->cell_enabled = (GtkCellRendererToggle*)(gtk_builder_get_object(builder, "cc_er_list_enabled_cell"));
   g_signal_connect(edit_rules_dlg->cell_enabled, "toggled", G_CALLBACK(on_er_enabled_toggled), NULL);
 
+  edit_rules_dlg->tree = (GtkTreeView*)(gtk_builder_get_object(builder, "cc_er_rules_tree"));
+  setup_rule_list();
+
   g_signal_connect(edit_rules_dlg->btn_save, "clicked", G_CALLBACK(on_er_btn_save), NULL);
   g_signal_connect(edit_rules_dlg->btn_cancel, "clicked", G_CALLBACK(cc_ui_hide_edit_rules_dialog), NULL);
 
@@ -348,7 +467,16 @@ void cc_ui_init()
      GDK_9, GDK_CONTROL_MASK, "cc_convert_all", _("Convert All"), menu_items->convert_all);
   keybindings_set_item(plugin_key_group, KB_CONVERT_MORE, cc_ui_show_convert_more_dialog,
      GDK_9, GDK_CONTROL_MASK, "cc_convert_more", _("Convert More"), menu_items->convert_more);
-
+  keybindings_set_item(plugin_key_group, KB_CONVERT_EVERYWHERE, cc_convert_everywhere,
+     0, 0, "cc_convert_everywhere", _("Convert Everywhere"), menu_items->convert_everywhere);
+  keybindings_set_item(plugin_key_group, KB_CONVERT_DOCUMENT, cc_convert_document,
+     0, 0, "cc_convert_document", _("Convert Names"), menu_items->convert_document);
+  keybindings_set_item(plugin_key_group, KB_CONVERT_MAP, on_convert_map,
+     0, 0, "cc_convert_map", _("Convert from Map"), menu_items->convert_map);
+  keybindings_set_item(plugin_key_group, KB_CYCLE_STYLE, cc_cycle_selection,
+     0, 0, "cc_cycle_style", _("Cycle Case Style"), menu_items->cycle_style);
+
+  CC_PROBE1(ui__init__return, CC_PROBE_ELAPSED(t0));
 }
 
 void cc_ui_cleanup()
@@ -356,24 +484,25 @@ void cc_ui_cleanup()
 
   if (add_rule_dlg) {
     gtk_widget_destroy((GtkWidget*)add_rule_dlg->dlg);
-    g_free(add_rule_dlg);
+    cc_free(add_rule_dlg);
     add_rule_dlg = NULL;
   }
 
   if (edit_rules_dlg) {
     gtk_widget_destroy((GtkWidget*)edit_rules_dlg->dlg);
-    g_free(edit_rules_dlg);
+    g_object_unref(edit_rules_dlg->rules);
+    cc_free(edit_rules_dlg);
     edit_rules_dlg = NULL;
   }
 
   if (convert_more_dlg) {
     gtk_widget_destroy((GtkWidget*)convert_more_dlg->dlg);
-    g_free(convert_more_dlg);
+    cc_free(convert_more_dlg);
     convert_more_dlg = NULL;
   }
 
   if (menu_items) {
-    g_free(menu_items);
+    cc_free(menu_items);
     menu_items = NULL;
   }
 
@@ -406,8 +535,25 @@ void cc_ui_show_edit_rules_dialog()
   if (edit_rules_dlg == NULL)
     return;
 
+  /* whatever was left unsaved last time is dropped, and so is the filter */
+  gtk_tree_view_set_model(edit_rules_dlg->tree, NULL);
+  gtk_entry_set_text(edit_rules_dlg->txt_filter, "");
+  cc_rule_list_filter(edit_rules_dlg->rules, NULL);
+  cc_rule_list_reload(edit_rules_dlg->rules, FALSE);
+  gtk_tree_view_set_model(edit_rules_dlg->tree, GTK_TREE_MODEL(edit_rules_dlg->rules));
+
   gtk_widget_show_all((GtkWidget*)edit_rules_dlg->dlg);
-  populate_rule_list();
+}
+
+void cc_ui_rules_changed()
+{
+  if (edit_rules_dlg == NULL || !gtk_widget_get_visible((GtkWidget*)edit_rules_dlg->dlg))
+    return;
+
+  /* the rows point into the rule store */
+  gtk_tree_view_set_model(edit_rules_dlg->tree, NULL);
+  cc_rule_list_reload(edit_rules_dlg->rules, TRUE);
+  gtk_tree_view_set_model(edit_rules_dlg->tree, GTK_TREE_MODEL(edit_rules_dlg->rules));
 }
 
 void cc_ui_hide_edit_rules_dialog()
@@ -433,7 +579,11 @@ void cc_ui_show_convert_more_dialog()
   if (txt)
   {
     gtk_entry_set_text(convert_more_dlg->txt_search, txt);
+    cc_free(txt);
   }
+
+  /* the document may have changed since it was last counted */
+  on_convert_more_search_changed();
 }
 
 void cc_ui_hide_convert_more_dialog()
@@ -450,8 +600,7 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
   rule_t      *rule = cc_alloc_rule();
   condition_t *cnd = NULL;
   action_t    *act = NULL, *tmpact = NULL;
-
-  /* TODO: validate entries before creating the rule */
+  const gchar *problem = NULL;
 
   if (!rule) return;
 
@@ -461,6 +610,10 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
     rule->domain = is_c2s ? CC_RULE_C2S : CC_RULE_S2C;
   }
 
+  /* and the filetypes it's scoped to, if any */
+  if (*gtk_entry_get_text(add_rule_dlg->txt_filetypes))
+    rule->filetypes = cc_strdup(CC_MEM_RULES, gtk_entry_get_text(add_rule_dlg->txt_filetypes));
+
   /* parse the condition */
   {
     cnd = cc_alloc_cnd();
@@ -470,17 +623,34 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
       return;
     }
 
-    cnd->value = g_strdup(gtk_entry_get_text(add_rule_dlg->txt_cnd));
+    cnd->value = cc_strdup(CC_MEM_RULES, gtk_entry_get_text(add_rule_dlg->txt_cnd));
     rule->condition = cnd;
 
-    cc_log("cond value: %s => %s\n", gtk_entry_get_text(add_rule_dlg->txt_cnd), cnd->value);
+    cc_debug("cond value: %s => %s\n", gtk_entry_get_text(add_rule_dlg->txt_cnd), cnd->value);
 
     if (gtk_toggle_button_get_active((GtkToggleButton*)add_rule_dlg->opt_cnd_has_prefix))
       cnd->type = CC_CND_HAS_PREFIX;
     else if (gtk_toggle_button_get_active((GtkToggleButton*)add_rule_dlg->opt_cnd_has_suffix))
       cnd->type = CC_CND_HAS_SUFFIX;
+    else if (gtk_toggle_button_get_active((GtkToggleButton*)add_rule_dlg->opt_cnd_matches))
+      cnd->type = CC_CND_MATCHES;
     else
       cnd->type = CC_CND_ALWAYS_TRUE;
+
+    /* an expression that doesn't compile would never match, refuse it */
+    if (cnd->type == CC_CND_MATCHES) {
+      GError *err = NULL;
+      GRegex *regex = g_regex_new(cnd->value, 0, 0, &err);
+
+      if (!regex) {
+        dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Invalid regular expression: %s"), err->message);
+        g_error_free(err);
+        cc_free_rule(&rule);
+        return;
+      }
+
+      g_regex_unref(regex);
+    }
   }
 
   /* parse the actions */
@@ -488,7 +658,7 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
     if (gtk_toggle_button_get_active((GtkToggleButton*)add_rule_dlg->opt_act_rem_prefix)) {
       act = cc_alloc_act();
       act->type = CC_ACT_REM_PREFIX;
-      act->value = g_strdup(gtk_entry_get_text(add_rule_dlg->txt_act_rem_prefix));
+      act->value = cc_strdup(CC_MEM_RULES, gtk_entry_get_text(add_rule_dlg->txt_act_rem_prefix));
       act->next = NULL;
 
       rule->actions = act;
@@ -499,7 +669,7 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
 
       act = cc_alloc_act();
       act->type = CC_ACT_REM_SUFFIX;
-      act->value = g_strdup(gtk_entry_get_text(add_rule_dlg->txt_act_rem_suffix));
+      act->value = cc_strdup(CC_MEM_RULES, gtk_entry_get_text(add_rule_dlg->txt_act_rem_suffix));
       act->next = NULL;
 
       if (tmpact) {
@@ -516,7 +686,7 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
 
       act = cc_alloc_act();
       act->type = CC_ACT_ADD_PREFIX;
-      act->value = g_strdup(gtk_entry_get_text(add_rule_dlg->txt_act_add_prefix));
+      act->value = cc_strdup(CC_MEM_RULES, gtk_entry_get_text(add_rule_dlg->txt_act_add_prefix));
       act->next = NULL;
 
       if (tmpact) {
@@ -533,7 +703,7 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
 
       act = cc_alloc_act();
       act->type = CC_ACT_ADD_SUFFIX;
-      act->value = g_strdup(gtk_entry_get_text(add_rule_dlg->txt_act_add_suffix));
+      act->value = cc_strdup(CC_MEM_RULES, gtk_entry_get_text(add_rule_dlg->txt_act_add_suffix));
       act->next = NULL;
 
       if (tmpact) {
@@ -546,7 +716,17 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
     }
   } /* end of parsing actions */
 
+  /* refuse what couldn't apply, or be read back once saved */
+  cc_compile_rule(rule);
+  if ((problem = cc_check_rule(rule)) != NULL) {
+    dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("The rule can't be created: %s."), problem);
+    cc_free_rule(&rule);
+    return;
+  }
+
   cc_add_rule(rule);
+  cc_ui_rules_changed();
+  cc_save_settings();
   rule = NULL;
   act = tmpact = NULL;
   cnd = NULL;
@@ -554,6 +734,66 @@ void on_add_rule_btn_create(G_GNUC_UNUSED GtkWidget* dlg)
   cc_ui_hide_add_rule_dialog();
 }
 
+/* the search flags the dialog is set to */
+static int convert_more_flags()
+{
+  int flags = 0;
+
+  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_case_sensitive))
+    flags |= SCFIND_MATCHCASE;
+  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_whole_word))
+    flags |= SCFIND_WHOLEWORD;
+  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_start_word))
+    flags |= SCFIND_WORDSTART;
+
+  return flags;
+}
+
+/* counts the occurrences as the search is typed, if the document is indexed,
+ * and previews converting them */
+void on_convert_more_search_changed()
+{
+  gchar *label = NULL;
+  gint  nr_hits = cc_count_occurrences(gtk_entry_get_text(convert_more_dlg->txt_search),
+                                       convert_more_flags());
+
+  if (nr_hits >= 0)
+    label = g_strdup_printf(_("Occurrences in the document: %d"), nr_hits);
+
+  gtk_label_set_text(convert_more_dlg->lbl_count, label ? label : "");
+  g_free(label);
+
+  on_convert_more_preview();
+}
+
+/* plans converting in the document, as its button would, and shows the diff;
+ * the button then finds the plan made */
+void on_convert_more_preview()
+{
+  GtkTextBuffer   *buffer = gtk_text_view_get_buffer(convert_more_dlg->txt_preview);
+  GeanyDocument   *doc = document_get_current();
+  const cc_plan_t *plan = NULL;
+  const gchar     *txt = gtk_entry_get_text(convert_more_dlg->txt_search);
+  gchar           *diff = NULL;
+
+  if (!gtk_expander_get_expanded(convert_more_dlg->exp_preview))
+    return;
+
+  if (doc && *txt)
+    plan = cc_plan_range(0, sci_get_length(doc->editor->sci)+1, txt,
+                         gtk_entry_get_text_length(convert_more_dlg->txt_search) + 1,
+                         convert_more_flags());
+
+  if (!plan) {
+    gtk_text_buffer_set_text(buffer, "", -1);
+    return;
+  }
+
+  diff = cc_preview_plan(plan, CC_PREVIEW_HUNKS);
+  gtk_text_buffer_set_text(buffer, diff, -1);
+  g_free(diff);
+}
+
 void on_convert_more_btn_selection(G_GNUC_UNUSED GtkWidget* dlg)
 {
   ScintillaObject *sci = NULL;
@@ -579,13 +819,7 @@ void on_convert_more_btn_selection(G_GNUC_UNUSED GtkWidget* dlg)
 
   begin = sci_get_selection_start(sci);
   end = sci_get_selection_end(sci);
-
-  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_case_sensitive))
-    flags |= SCFIND_MATCHCASE;
-  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_whole_word))
-    flags |= SCFIND_WHOLEWORD;
-  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_start_word))
-    flags |= SCFIND_WORDSTART;
+  flags = convert_more_flags();
 
   cc_convert_range(begin, end, txt, txtsz + 1, flags);
 }
@@ -609,12 +843,7 @@ void on_convert_more_btn_document(G_GNUC_UNUSED GtkWidget* dlg)
   if (!txt || txtsz == 1)
     return;
 
-  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_case_sensitive))
-    flags |= SCFIND_MATCHCASE;
-  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_whole_word))
-    flags |= SCFIND_WHOLEWORD;
-  if (gtk_toggle_button_get_active((GtkToggleButton*)convert_more_dlg->opt_start_word))
-    flags |= SCFIND_WORDSTART;
+  flags = convert_more_flags();
 
   cc_convert_range(0, sci_get_length(sci)+1, txt, txtsz + 1, flags);
 }
@@ -623,19 +852,15 @@ static void on_er_enabled_toggled(G_GNUC_UNUSED GtkCellRendererToggle *cell,
                                   gchar *path_string,
                                   G_GNUC_UNUSED gpointer user_data)
 {
-  GtkListStore *liststore = (GtkListStore*)gtk_builder_get_object(builder, "cc_er_rules_list");
-  GtkTreeIter iter;
-  gboolean res = gtk_tree_model_get_iter_from_string((GtkTreeModel*)liststore, &iter, path_string);
-
-  if (res == TRUE) {
-    gboolean flag = FALSE;
-    gtk_tree_model_get((GtkTreeModel*)liststore, &iter, ER_COL_ENABLED, &flag, -1);
-
-    gtk_list_store_set(liststore, &iter, ER_COL_ENABLED, (gboolean) !flag, -1);
-    cc_log("rule has been %s!\n", flag ? "disabled" : "enabled");
+  GtkTreeModel  *model = GTK_TREE_MODEL(edit_rules_dlg->rules);
+  GtkTreeIter   iter;
+  gboolean      flag = FALSE;
+
+  if (gtk_tree_model_get_iter_from_string(model, &iter, path_string)) {
+    flag = cc_rule_list_get_enabled(edit_rules_dlg->rules, &iter);
+    cc_rule_list_set_enabled(edit_rules_dlg->rules, &iter, !flag);
+    cc_debug("rule has been %s!\n", flag ? "disabled" : "enabled");
   }
-
-  return;
 }
 
 
@@ -644,126 +869,182 @@ static void on_er_label_edited (G_GNUC_UNUSED GtkCellRendererText *cell,
                                 gchar *new_text,
                                 G_GNUC_UNUSED gpointer user_data)
 {
-  GtkListStore *liststore = (GtkListStore*)gtk_builder_get_object(builder, "cc_er_rules_list");
-  GtkTreeIter iter;
-  gboolean res = gtk_tree_model_get_iter_from_string((GtkTreeModel*)liststore, &iter, path_string);
+  GtkTreeModel  *model = GTK_TREE_MODEL(edit_rules_dlg->rules);
+  GtkTreeIter   iter;
 
-  if (res == TRUE) {
-    gtk_list_store_set(liststore, &iter, ER_COL_LABEL, new_text, -1);
-    cc_log("rule label has been modified to '%s'!\n", new_text);
+  if (gtk_tree_model_get_iter_from_string(model, &iter, path_string)) {
+    cc_rule_list_set_label(edit_rules_dlg->rules, &iter, new_text);
+    cc_debug("rule label has been modified to '%s'!\n", new_text);
   }
 }
 
-static gboolean
-traverse_rules(GtkTreeModel *model,
-               G_GNUC_UNUSED GtkTreePath  *path,
-               GtkTreeIter  *iter,
-               G_GNUC_UNUSED gpointer      user_data)
+/* every keystroke filters the list through its index */
+static void on_er_filter_changed()
 {
-  gchar *in_label;
-  gint in_id;
-  gboolean in_enabled;
-  rule_t *rule = NULL;
-
-  gtk_tree_model_get (model, iter,
-                      ER_COL_ID, &in_id,
-                      ER_COL_LABEL, &in_label,
-                      ER_COL_ENABLED, &in_enabled,
-                      -1);
-
-  rule = cc_get_rule(in_id);
-
-  if (rule) {
-    cc_log("Rule (%d) '%s' => %s\n", in_id, in_label, in_enabled ? "enabled" : "disabled");
-    rule->label = g_strdup(in_label);
-    rule->enabled = in_enabled;
-  }
+  gtk_tree_view_set_model(edit_rules_dlg->tree, NULL);
+  cc_rule_list_filter(edit_rules_dlg->rules, gtk_entry_get_text(edit_rules_dlg->txt_filter));
+  gtk_tree_view_set_model(edit_rules_dlg->tree, GTK_TREE_MODEL(edit_rules_dlg->rules));
+}
 
-  g_free(in_label);
+static void on_er_btn_save()
+{
+  /* only the edited rules are touched, and published at once */
+  if (cc_rule_list_commit(edit_rules_dlg->rules))
+    cc_save_settings();
+}
 
-  return FALSE; /* get next row */
+/*
+ * The list is a view over the rule store (see caseconvert_rulelist.h) in
+ * fixed height mode, so only the rows on screen are ever formatted however
+ * many rules there are. That needs fixed size columns, and the rows follow
+ * the store's order so they can't be sorted or dragged around either.
+ *
+ * The dialog's definition has neither a scrolled window for the list nor a
+ * filter entry, both are put in here.
+ */
+static void setup_rule_list()
+{
+  static const gint widths[] = { 40, 64, 160, 260, 260 };
+  GtkTreeViewColumn *col = NULL;
+  GtkWidget         *vbox = gtk_widget_get_parent((GtkWidget*)edit_rules_dlg->tree);
+  GtkWidget         *scroll = gtk_scrolled_window_new(NULL, NULL);
+  gint              i;
+
+  edit_rules_dlg->rules = cc_rule_list_new();
+
+  edit_rules_dlg->txt_filter = (GtkEntry*)gtk_entry_new();
+  gtk_widget_set_tooltip_text((GtkWidget*)edit_rules_dlg->txt_filter,
+    _("Show the rules whose label, condition, actions, filetypes or domain have every word typed in"));
+  g_signal_connect(edit_rules_dlg->txt_filter, "changed", G_CALLBACK(on_er_filter_changed), NULL);
+
+  g_object_ref(edit_rules_dlg->tree);
+  gtk_container_remove(GTK_CONTAINER(vbox), (GtkWidget*)edit_rules_dlg->tree);
+  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+  gtk_widget_set_size_request(scroll, -1, 360);
+  gtk_container_add(GTK_CONTAINER(scroll), (GtkWidget*)edit_rules_dlg->tree);
+  g_object_unref(edit_rules_dlg->tree);
+
+  gtk_box_pack_start(GTK_BOX(vbox), (GtkWidget*)edit_rules_dlg->txt_filter, FALSE, FALSE, 0);
+  gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
+
+  for (i = 0; (col = gtk_tree_view_get_column(edit_rules_dlg->tree, i)) != NULL; ++i) {
+    gtk_tree_view_column_set_sizing(col, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(col, widths[MIN(i, (gint)G_N_ELEMENTS(widths) - 1)]);
+    gtk_tree_view_column_set_sort_column_id(col, -1);
+  }
+
+  gtk_tree_view_set_reorderable(edit_rules_dlg->tree, FALSE);
+  gtk_tree_view_set_fixed_height_mode(edit_rules_dlg->tree, TRUE);
+  gtk_tree_view_set_model(edit_rules_dlg->tree, GTK_TREE_MODEL(edit_rules_dlg->rules));
 }
 
-static void on_er_btn_save()
+/* asks for a rule pack to read or write, NULL if cancelled */
+static gchar* choose_pack(const gchar *title, GtkFileChooserAction action)
 {
-  GtkListStore *liststore = (GtkListStore*)gtk_builder_get_object(builder, "cc_er_rules_list");
-  gtk_tree_model_foreach(GTK_TREE_MODEL(liststore), traverse_rules, NULL);
+  GtkWidget *dlg = NULL;
+  gchar     *path = NULL;
 
-  cc_save_settings();
+  dlg = gtk_file_chooser_dialog_new(title, GTK_WINDOW(geany->main_widgets->window), action,
+    GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+    action == GTK_FILE_CHOOSER_ACTION_SAVE ? GTK_STOCK_SAVE : GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT,
+    NULL);
+
+  gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dlg), TRUE);
+
+  if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT)
+    path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+
+  gtk_widget_destroy(dlg);
+
+  return path;
 }
 
-static void populate_rule_list()
+static void on_import_rules()
 {
-  rule_t *rule;
-  GtkListStore *liststore = (GtkListStore*)gtk_builder_get_object(builder, "cc_er_rules_list");
-  /* first, remove all entries */
-  gtk_list_store_clear(liststore);
+  gchar *path = choose_pack(_("Import Rules"), GTK_FILE_CHOOSER_ACTION_OPEN);
+  gchar *problem = NULL;
+  gint  nr_rules = 0;
 
-  for (rule = cc_get_rules(); rule != NULL; rule = rule->next)
-  {
-    GtkTreeIter   iter;
+  if (!path)
+    return;
 
-    gchar *cnd_txt = NULL, *act_txt = NULL;
+  nr_rules = cc_import_rules(path, &problem);
 
-    /* condition to human-readable string */
-    {
-      if (rule->condition->type == CC_CND_HAS_PREFIX)
-      {
-        cnd_txt = g_malloc(sizeof(gchar) * (strlen("Begins with ") + strlen(rule->condition->value) + 1));
-        g_sprintf(cnd_txt, "Begins with %s", rule->condition->value);
-      }
-      else if (rule->condition->type == CC_CND_HAS_SUFFIX)
-      {
-        cnd_txt = g_malloc(sizeof(gchar) * (strlen("Ends with ") + strlen(rule->condition->value) + 1));
-        g_sprintf(cnd_txt, "Ends with %s", rule->condition->value);
-      }
-      else if (rule->condition->type == CC_CND_ALWAYS_TRUE)
-      {
-        cnd_txt = g_strdup("Always true");
-      }
-      else
-      {
-        cnd_txt = g_strdup("Invalid!");
-      }
-    }
+  if (nr_rules < 0) {
+    dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Nothing was imported from %s, %s."), path, problem);
+    g_free(problem);
+  }
+  else {
+    cc_save_settings();
+    ui_set_statusbar(FALSE, _("Imported %d rules from %s"), nr_rules, path);
 
-    /* actions to human-readable string */
-    {
-      action_t *a = NULL;
-      for (a = rule->actions; a != NULL; a = a->next) {
-        gchar *msg = NULL;
-        switch (a->type)
-        {
-          case CC_ACT_ADD_PREFIX: msg = g_strdup("Add Prefix "); break;
-          case CC_ACT_ADD_SUFFIX: msg = g_strdup("Add Suffix "); break;
-          case CC_ACT_REM_PREFIX: msg = g_strdup("Rem Prefix "); break;
-          case CC_ACT_REM_SUFFIX: msg = g_strdup("Rem Suffix "); break;
-          default:
-          msg = g_strdup("Invalid");
-        }
-
-        if (act_txt) {
-          gchar *tmp = g_strdup(act_txt);
-          act_txt = g_malloc(sizeof(gchar) * (strlen(tmp) + strlen(msg) + strlen(a->value) + 4));
-          sprintf(act_txt, "%s, %s %s", tmp, msg, a->value);
-          g_free(tmp);
-        } else {
-          act_txt = g_malloc(sizeof(gchar) * (strlen(msg) + strlen(a->value) + 2));
-          sprintf(act_txt, "%s %s", msg, a->value);
-        }
-      }
-    }
+    cc_ui_rules_changed();
+  }
+
+  g_free(path);
+}
+
+/* asks for a name map, and how to apply it, then applies it */
+static void on_convert_map()
+{
+  static gboolean whole_word = TRUE, fallback = FALSE, all_documents = FALSE;
+  GtkWidget       *dlg = NULL, *box = NULL, *opt_whole_word = NULL;
+  GtkWidget       *opt_fallback = NULL, *opt_all_documents = NULL;
+  gchar           *path = NULL, *problem = NULL;
+
+  dlg = gtk_file_chooser_dialog_new(_("Convert from Map"), GTK_WINDOW(geany->main_widgets->window),
+    GTK_FILE_CHOOSER_ACTION_OPEN,
+    GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+    GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT,
+    NULL);
+
+  /* the options go below the files */
+  box = gtk_vbox_new(FALSE, 0);
+
+  opt_whole_word = gtk_check_button_new_with_mnemonic(_("Match only a _whole word"));
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(opt_whole_word), whole_word);
+  gtk_box_pack_start(GTK_BOX(box), opt_whole_word, FALSE, FALSE, 0);
+
+  opt_fallback = gtk_check_button_new_with_mnemonic(_("Convert the names not in the map by the _rules"));
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(opt_fallback), fallback);
+  gtk_box_pack_start(GTK_BOX(box), opt_fallback, FALSE, FALSE, 0);
+
+  opt_all_documents = gtk_check_button_new_with_mnemonic(_("In all _open documents"));
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(opt_all_documents), all_documents);
+  gtk_box_pack_start(GTK_BOX(box), opt_all_documents, FALSE, FALSE, 0);
+
+  gtk_widget_show_all(box);
+  gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(dlg), box);
+
+  if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT) {
+    path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+    whole_word = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(opt_whole_word));
+    fallback = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(opt_fallback));
+    all_documents = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(opt_all_documents));
+  }
+
+  gtk_widget_destroy(dlg);
 
-    gtk_list_store_append(liststore, &iter);
-    gtk_list_store_set (liststore, &iter,
-                        ER_COL_ID,      rule->id,
-                        ER_COL_ENABLED, rule->enabled,
-                        ER_COL_LABEL,   rule->label ? rule->label : "Unlabelled",
-                        ER_COL_CND,     cnd_txt,
-                        ER_COL_ACT,     act_txt,
-                        -1);
-
-    g_free(cnd_txt);
-    g_free(act_txt);
+  if (path && cc_convert_map(path, whole_word, fallback, all_documents, &problem) < 0) {
+    dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("The names could not be mapped from %s, %s."), path, problem);
+    g_free(problem);
   }
+
+  g_free(path);
+}
+
+static void on_export_rules()
+{
+  gchar *path = choose_pack(_("Export Rules"), GTK_FILE_CHOOSER_ACTION_SAVE);
+  gint  nr_rules = 0;
+
+  if (!path)
+    return;
+
+  if (cc_export_rules(path, &nr_rules))
+    ui_set_statusbar(FALSE, _("Exported %d rules to %s"), nr_rules, path);
+  else
+    dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("The rules could not be exported to %s."), path);
+
+  g_free(path);
 }
@@ -42,6 +42,10 @@ enum {
   KB_CONVERT_SELECTION,
   KB_CONVERT_MORE,
   KB_CONVERT_ALL,
+  KB_CONVERT_EVERYWHERE,
+  KB_CONVERT_DOCUMENT,
+  KB_CONVERT_MAP,
+  KB_CYCLE_STYLE,
   KB_TEST,
   KB_COUNT
 };
@@ -55,6 +59,10 @@ void cc_ui_hide_add_rule_dialog();
 void cc_ui_show_edit_rules_dialog();
 void cc_ui_hide_edit_rules_dialog();
 
+/* must be called when rules are added or removed, the Edit Rules list
+ * points into the rule store */
+void cc_ui_rules_changed();
+
 void cc_ui_show_convert_more_dialog();
 void cc_ui_hide_convert_more_dialog();
 
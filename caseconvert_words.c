@@ -0,0 +1,485 @@
+/*
+ *  caseconvert_words.c
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "caseconvert_words.h"
+#include "caseconvert_mem.h"
+#include <ctype.h>
+#include <string.h>
+
+static const gchar *style_names[CC_STYLE_COUNT] = {
+  "snake_case",
+  "camelCase",
+  "PascalCase",
+  "kebab-case",
+  "SCREAMING_SNAKE_CASE",
+  "dot.case"
+};
+
+static const gchar style_delims[CC_STYLE_COUNT] = {
+  '_', 0, 0, '-', '_', '.'
+};
+
+static gboolean is_delim(gchar c)
+{
+  return c && strchr(CC_STYLE_DELIMS, c) != NULL;
+}
+
+/* the length of "in", never reading past insz bytes */
+static gint text_length(const gchar *in, gint insz)
+{
+  gint n = 0;
+
+  if (insz < 0)
+    return strlen(in);
+
+  while (n < insz && in[n] != '\0') ++n;
+
+  return n;
+}
+
+static void push_span(cc_words_t *words, const gchar *ptr, gint begin, gint len, gint gap)
+{
+  cc_span_t *span = NULL;
+
+  if (words->nr_words == words->capacity) {
+    words->capacity *= 2;
+
+    if (words->spans == words->inline_spans) {
+      words->spans = cc_malloc(CC_MEM_CONVERTER, sizeof(cc_span_t) * words->capacity);
+      memcpy(words->spans, words->inline_spans, sizeof(words->inline_spans));
+    }
+    else
+      words->spans = cc_realloc(CC_MEM_CONVERTER, words->spans, sizeof(cc_span_t) * words->capacity);
+  }
+
+  span = &words->spans[words->nr_words++];
+  span->ptr = ptr;
+  span->begin = begin;
+  span->len = len;
+  span->gap = gap;
+}
+
+/* the character at offset "off" of the whole name */
+static gchar char_at(const cc_words_t *words, gint off)
+{
+  gint s;
+
+  for (s = 0; off >= words->seglens[s]; ++s)
+    off -= words->seglens[s];
+
+  return words->segs[s][off];
+}
+
+/* copies "len" characters of the whole name from offset "off", across segments */
+static gchar* copy_range(const cc_words_t *words, gint off, gint len, gchar *out)
+{
+  gint s, n;
+
+  for (s = 0; s < words->nr_segs && len > 0; ++s) {
+    if (off >= words->seglens[s]) {
+      off -= words->seglens[s];
+      continue;
+    }
+
+    n = MIN(words->seglens[s] - off, len);
+    memcpy(out, words->segs[s] + off, n);
+    out += n;
+    len -= n;
+    off = 0;
+  }
+
+  return out;
+}
+
+#define MAX_RUN_ACRONYMS 8
+
+/*
+ * Cuts the run of capitals at "p" into known acronyms, longest first. The
+ * last capital of a run followed by a lower case letter starts the next
+ * word ("XMLHttp"), unless that letter is a lone plural 's' ("URLs").
+ *
+ * @return
+ * the number of acronyms, their lengths in "lens", or 0 if the run isn't made
+ * of acronyms only. "closed" tells whether the last one ends its word, and
+ * "plural" whether it takes the 's' following it.
+ */
+static gint cut_acronyms(const cc_words_t *words, const gchar *p, gint len,
+                         gint *lens, gboolean *closed, gboolean *plural)
+{
+  const cc_grammar_t  *g = words->grammar;
+  gint                k = 0, run, off, n = 0, l;
+
+  while (k < len && CC_GRAMMAR_CLASS(g, p[k]) == CC_CLASS_UPPER) ++k;
+
+  run = k;
+  *closed = *plural = FALSE;
+
+  if (k < len && CC_GRAMMAR_CLASS(g, p[k]) == CC_CLASS_LOWER) {
+    *plural = p[k] == 's' && (k + 1 == len || CC_GRAMMAR_CLASS(g, p[k+1]) != CC_CLASS_LOWER);
+
+    if (!*plural) {
+      run = k - 1;
+      *closed = TRUE;
+    }
+  }
+
+  for (off = 0; off < run && n < MAX_RUN_ACRONYMS; off += l) {
+    for (l = MIN(cc_acronyms_max_len(words->acronyms), run - off); l > 0; --l)
+      if (cc_acronyms_lookup(words->acronyms, p + off, l))
+        break;
+
+    if (l == 0)
+      return 0;
+
+    lens[n++] = l;
+  }
+
+  return off == run ? n : 0;
+}
+
+gboolean cc_words_split(const gchar *in, gint insz, const cc_grammar_t *grammar,
+                        const cc_acronyms_t *acronyms, cc_words_t *words)
+{
+  gint n = text_length(in, insz);
+
+  return cc_words_split_view(&in, &n, 1, grammar, acronyms, words);
+}
+
+gboolean cc_words_split_view(const gchar * const *segs, const gint *seglens, gint nr_segs,
+                             const cc_grammar_t *grammar, const cc_acronyms_t *acronyms,
+                             cc_words_t *words)
+{
+  const cc_grammar_t *g = grammar ? grammar : cc_grammar_default();
+  gint  s, j, i = 0;
+  gint  base = 0, end = 0;
+  gint  begin = -1, gap = 0;
+  gint  state = CC_GRAMMAR_START;
+  gint  lens[MAX_RUN_ACRONYMS];
+  const gchar *word = NULL;
+
+  g_return_val_if_fail(nr_segs <= CC_WORDS_MAX_SEGS, FALSE);
+
+  memset(words, 0, sizeof(cc_words_t));
+
+  for (s = 0; s < nr_segs; ++s) {
+    if (!segs[s] || seglens[s] <= 0)
+      continue;
+
+    words->segs[words->nr_segs] = segs[s];
+    words->seglens[words->nr_segs++] = seglens[s];
+    words->len += seglens[s];
+  }
+
+  /* leading and trailing delimiters don't delimit anything, and leading
+   * sigils don't belong to the first word */
+  end = words->len;
+  while (i < end && (CC_GRAMMAR_CLASS(g, char_at(words, i)) == CC_CLASS_DELIM
+                  || CC_GRAMMAR_CLASS(g, char_at(words, i)) == CC_CLASS_SIGIL)) ++i;
+  while (end > i && CC_GRAMMAR_CLASS(g, char_at(words, end-1)) == CC_CLASS_DELIM) --end;
+
+  /* unless they're all there is */
+  if (i == end) {
+    for (i = 0; i < words->len && CC_GRAMMAR_CLASS(g, char_at(words, i)) == CC_CLASS_DELIM; ++i);
+    for (end = words->len; end > i && CC_GRAMMAR_CLASS(g, char_at(words, end-1)) == CC_CLASS_DELIM; --end);
+  }
+
+  if (i == end) {
+    memset(words, 0, sizeof(cc_words_t));
+    return FALSE;
+  }
+
+  words->lead = i;
+  words->trail = words->len - end;
+  words->screaming = TRUE;
+  words->grammar = g;
+  words->acronyms = acronyms;
+  words->spans = words->inline_spans;
+  words->capacity = CC_WORDS_INLINE;
+
+  for (s = 0; s < words->nr_segs; base += words->seglens[s++])
+  {
+    const gchar *p = words->segs[s];
+    gint        len = words->seglens[s];
+
+    /* every segment starts a word of its own */
+    state = CC_GRAMMAR_START;
+
+    for (j = MAX(words->lead - base, 0); j < len && base + j < end; ++j)
+    {
+      guchar c = (guchar)p[j];
+      guint8 t = g->table[begin < 0 ? CC_GRAMMAR_START : state][c];
+
+      i = base + j;
+      state = t >> 2;
+
+      switch (t & 3)
+      {
+        case CC_STEP_DELIM:
+          if (begin >= 0)
+            push_span(words, word, begin, i - begin, gap);
+
+          gap = begin >= 0 ? 1 : gap + 1;
+          begin = -1;
+          continue;
+
+        case CC_STEP_BREAK:
+          if (begin >= 0) {
+            push_span(words, word, begin, i - begin, gap);
+            gap = 0;
+          }
+
+          begin = -1;
+        break;
+
+        /* "CURLObj" => CURL Obj, but "IDs" stays whole */
+        case CC_STEP_BREAK_BACK:
+          if (i - 1 - begin > 1) {
+            push_span(words, word, begin, i - 1 - begin, gap);
+            gap = 0;
+            begin = i - 1;
+            word = p + j - 1;
+          }
+        break;
+      }
+
+      if (CC_GRAMMAR_CLASS(g, c) == CC_CLASS_LOWER)
+        words->screaming = FALSE;
+
+      /* a run of capitals made of known acronyms, the last one stays open
+       * for whatever follows it ("HTTP2", "URLs") unless it's closed */
+      if (acronyms && CC_GRAMMAR_CLASS(g, c) == CC_CLASS_UPPER
+      && (j == 0 || CC_GRAMMAR_CLASS(g, p[j-1]) != CC_CLASS_UPPER))
+      {
+        gboolean  closed = FALSE, plural = FALSE;
+        gint      k, n = cut_acronyms(words, p + j, MIN(len, end - base) - j, lens, &closed, &plural);
+
+        if (n > 0) {
+          if (begin >= 0)
+            push_span(words, word, begin, i - begin, gap);
+
+          for (k = 0; k < n - 1; ++k) {
+            push_span(words, p + j, base + j, lens[k], begin >= 0 || k > 0 ? 0 : gap);
+            j += lens[k];
+          }
+
+          gap = begin >= 0 || n > 1 ? 0 : gap;
+          begin = base + j;
+          word = p + j;
+          j += lens[n-1] - 1 + (plural ? 1 : 0);
+          state = plural ? CC_GRAMMAR_STATE(CC_CLASS_LOWER, 0)
+                         : CC_GRAMMAR_STATE(CC_CLASS_UPPER, lens[n-1] > 1);
+
+          if (closed) {
+            push_span(words, word, begin, base + j + 1 - begin, gap);
+            begin = -1;
+            gap = 0;
+          }
+
+          continue;
+        }
+      }
+
+      if (begin < 0) {
+        begin = i;
+        word = p + j;
+      }
+    }
+  }
+
+  push_span(words, word, begin, end - begin, gap);
+
+  return TRUE;
+}
+
+void cc_words_clear(cc_words_t *words)
+{
+  if (words->spans != words->inline_spans)
+    cc_free(words->spans);
+
+  memset(words, 0, sizeof(cc_words_t));
+}
+
+gint cc_words_length(const cc_words_t *words, cc_style_t style)
+{
+  gint sz = words->lead + words->trail;
+  gint i;
+
+  for (i = 0; i < words->nr_words; ++i) {
+    sz += words->spans[i].len;
+
+    if (i == 0)
+      continue;
+
+    /* runs of delimiters are kept as they are, otherwise camel humps take
+     * no delimiter and the other styles their own */
+    if (words->spans[i].gap > 1)
+      sz += words->spans[i].gap;
+    else if (style_delims[style])
+      sz += 1;
+  }
+
+  return sz;
+}
+
+/* the length of the known acronym spelling the word, if any: "url" => 3,
+ * and so does the plural "urls" */
+static gint known_acronym(const cc_words_t *words, const cc_span_t *span)
+{
+  if (!words->acronyms)
+    return 0;
+
+  if (cc_acronyms_lookup(words->acronyms, span->ptr, span->len))
+    return span->len;
+
+  if (span->len > 2 && span->ptr[span->len-1] == 's'
+  &&  cc_acronyms_lookup(words->acronyms, span->ptr, span->len - 1))
+    return span->len - 1;
+
+  return 0;
+}
+
+/* camelCase and PascalCase only touch the first letter of every word and keep
+ * the rest, so acronyms survive ("foo_HTTP" => "fooHTTP"), unless the whole
+ * name was upper case to begin with or the acronym leads a camelCased name;
+ * known acronyms are spelled in capitals whatever the source did */
+static gchar* emit_hump(const cc_words_t *words, cc_style_t style, gint w, gchar *out)
+{
+  const cc_span_t *span = &words->spans[w];
+  const gchar     *in = span->ptr;
+  gboolean        acronym = TRUE;
+  gint            known = known_acronym(words, span);
+  gint            i;
+
+  for (i = 0; i < span->len && acronym; ++i)
+    acronym = !islower((guchar)in[i]);
+
+  acronym = acronym || known;
+
+  if (w == 0 && style == CC_STYLE_CAMEL) {
+    for (i = 0; i < span->len; ++i)
+      *out++ = (i == 0 || acronym) ? tolower((guchar)in[i]) : in[i];
+
+    return out;
+  }
+
+  /* a run of delimiters is kept, and so is the letter following it */
+  if (w > 0 && span->gap > 1) {
+    out = copy_range(words, span->begin - span->gap, span->gap, out);
+    *out++ = in[0];
+  }
+  else
+    *out++ = toupper((guchar)in[0]);
+
+  for (i = 1; i < span->len; ++i) {
+    if (i < known)
+      *out++ = toupper((guchar)in[i]);
+    else
+      *out++ = words->screaming ? tolower((guchar)in[i]) : in[i];
+  }
+
+  return out;
+}
+
+void cc_words_emit(const cc_words_t *words, cc_style_t style, gchar *out)
+{
+  gchar delim = style_delims[style];
+  gint  w, i;
+
+  out = copy_range(words, 0, words->lead, out);
+
+  for (w = 0; w < words->nr_words; ++w)
+  {
+    const cc_span_t *span = &words->spans[w];
+
+    if (!delim) {
+      out = emit_hump(words, style, w, out);
+      continue;
+    }
+
+    if (w > 0 && span->gap > 1)
+      out = copy_range(words, span->begin - span->gap, span->gap, out);
+    else if (w > 0)
+      *out++ = delim;
+
+    if (style == CC_STYLE_SCREAMING)
+      for (i = 0; i < span->len; ++i) *out++ = toupper((guchar)span->ptr[i]);
+    else
+      for (i = 0; i < span->len; ++i) *out++ = tolower((guchar)span->ptr[i]);
+  }
+
+  out = copy_range(words, words->len - words->trail, words->trail, out);
+  *out = '\0';
+}
+
+gchar* cc_words_convert(const cc_words_t *words, cc_style_t style, gint *outsz)
+{
+  gint  sz = cc_words_length(words, style);
+  gchar *out = cc_malloc(CC_MEM_CONVERTER, sz + 1);
+
+  cc_words_emit(words, style, out);
+
+  if (outsz)
+    *outsz = sz;
+
+  return out;
+}
+
+cc_style_t cc_words_style(const gchar *in, gint insz)
+{
+  gint      n = text_length(in, insz);
+  gint      i = 0, end = n;
+  gboolean  has_lower = FALSE, has_upper = FALSE;
+  gchar     delim = 0;
+  gchar     first = 0;
+
+  while (i < n && is_delim(in[i])) ++i;
+  while (end > i && is_delim(in[end-1])) --end;
+
+  for (; i < end; ++i) {
+    guchar c = (guchar)in[i];
+
+    if (is_delim(c) && delim != '-' && delim != '.')
+      delim = c;
+    else if (islower(c))
+      has_lower = TRUE;
+    else if (isupper(c))
+      has_upper = TRUE;
+
+    if (!first && isalpha(c))
+      first = c;
+  }
+
+  if (delim == '-')
+    return CC_STYLE_KEBAB;
+  else if (delim == '.')
+    return CC_STYLE_DOT;
+  else if (has_upper && !has_lower)
+    return CC_STYLE_SCREAMING;
+  else if (delim)
+    return CC_STYLE_SNAKE;
+  else if (isupper((guchar)first))
+    return CC_STYLE_PASCAL;
+
+  return CC_STYLE_CAMEL;
+}
+
+const gchar* cc_style_name(cc_style_t style)
+{
+  return style < CC_STYLE_COUNT ? style_names[style] : "unknown";
+}
@@ -0,0 +1,133 @@
+/*
+ *  caseconvert_words.h
+ *
+ *  Copyright 2012 Ahmad Amireh <ahmad@amireh.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef H_GEANY_CASE_CONVERT_WORDS_H
+#define H_GEANY_CASE_CONVERT_WORDS_H
+
+#include <glib.h>
+#include "caseconvert_grammar.h"
+#include "caseconvert_acronyms.h"
+
+/*
+ * Word boundaries and case styles.
+ *
+ * cc_words_split() finds the words of a name once and records them as spans
+ * into the source, any style can then be emitted from those spans without
+ * looking at the boundaries again:
+ *
+ *  cc_words_t words;
+ *  if (cc_words_split("parseHTTPRequest", -1, NULL, NULL, &words)) {
+ *    gchar *kebab = cc_words_convert(&words, CC_STYLE_KEBAB, NULL);
+ *    ...
+ *    cc_words_clear(&words);
+ *  }
+ *
+ * Words are delimited wherever the boundary grammar says (see
+ * caseconvert_grammar.h), by default by '_', by a lower case letter or a
+ * digit followed by an upper case one ("fooBar") and by the last letter of
+ * an acronym ("CURLObj"); other characters are copied along with the word
+ * they're in. Leading and trailing delimiters are kept verbatim, and so are
+ * runs of them between words and leading sigils.
+ *
+ * Cycling through the styles reads kebab-case and dot.case too, it splits
+ * with cc_grammar_with_delims(grammar, CC_STYLE_DELIMS) instead.
+ *
+ * Given an acronym dictionary, a run of capitals made only of known acronyms
+ * is cut into them ("HTTPURLParser" => HTTP URL Parser), a trailing 's'
+ * staying with the last one ("URLs"), and camelCase spells them in capitals.
+ *
+ * cc_words_split_view() reads a name made of several segments without
+ * joining them first, every segment starts a new word. The converter uses
+ * it to split [prefix][stripped input][suffix] in place.
+ */
+
+typedef enum {
+  CC_STYLE_SNAKE = 0, /* foo_bar */
+  CC_STYLE_CAMEL,     /* fooBar */
+  CC_STYLE_PASCAL,    /* FooBar */
+  CC_STYLE_KEBAB,     /* foo-bar */
+  CC_STYLE_SCREAMING, /* FOO_BAR */
+  CC_STYLE_DOT,       /* foo.bar */
+  CC_STYLE_COUNT
+} cc_style_t;
+
+/* the delimiters of the styles, and the space */
+#define CC_STYLE_DELIMS "_-. "
+
+typedef struct {
+  const gchar *ptr;   /* the word, never crosses segments */
+  gint        begin;  /* offset of the word in the name */
+  gint        len;
+  gint        gap;    /* length of the delimiters preceding the word */
+} cc_span_t;
+
+#define CC_WORDS_INLINE 16 /* names with more words than this need an allocation */
+#define CC_WORDS_MAX_SEGS 3
+
+/* the spans point into the segments, which must outlive the words; the
+ * struct refers to itself so it must not be copied around either */
+typedef struct {
+  const gchar *segs[CC_WORDS_MAX_SEGS];
+  gint        seglens[CC_WORDS_MAX_SEGS];
+  gint        nr_segs;
+  gint        len;        /* of the whole name */
+  gint        lead;       /* number of leading delimiters */
+  gint        trail;      /* number of trailing delimiters */
+  gboolean    screaming;  /* the source has no lower case letters */
+  const cc_grammar_t  *grammar;  /* must outlive the words */
+  const cc_acronyms_t *acronyms; /* may be NULL, must outlive the words */
+  gint        nr_words;
+  gint        capacity;
+  cc_span_t   *spans;
+  cc_span_t   inline_spans[CC_WORDS_INLINE];
+} cc_words_t;
+
+/**
+ * Finds the words of "in", reading at most "insz" bytes or up to the NUL
+ * if "insz" is negative. A NULL grammar is the default one, "acronyms" may
+ * be NULL.
+ *
+ * @return FALSE if "in" has no words, "words" needs no clearing then
+ */
+gboolean    cc_words_split(const gchar *in, gint insz, const cc_grammar_t *grammar,
+                           const cc_acronyms_t *acronyms, cc_words_t *words);
+
+/* splits the name made of the given segments, in order; empty or NULL
+ * segments are skipped */
+gboolean    cc_words_split_view(const gchar * const *segs, const gint *seglens, gint nr_segs,
+                                const cc_grammar_t *grammar, const cc_acronyms_t *acronyms,
+                                cc_words_t *words);
+void        cc_words_clear(cc_words_t *words);
+
+/* the exact size of the given style, not counting the NUL */
+gint        cc_words_length(const cc_words_t *words, cc_style_t style);
+
+/* writes the given style and a NUL into "out", which must have room for
+ * cc_words_length() + 1 bytes */
+void        cc_words_emit(const cc_words_t *words, cc_style_t style, gchar *out);
+
+/* emits the given style into a new string, free with cc_free() */
+gchar*      cc_words_convert(const cc_words_t *words, cc_style_t style, gint *outsz);
+
+/* guesses the style "in" is written in */
+cc_style_t  cc_words_style(const gchar *in, gint insz);
+
+const gchar* cc_style_name(cc_style_t style);
+
+#endif
@@ -1,8 +1,33 @@
 #!/usr/bin/env bash
 
-CFLAGS="-Wall -Wextra -ansi -pedantic -g -DVERBOSE"
+# trace levels: 0 none, 1 warnings (default), 2 info, 3 debug, 4 verbose
+CFLAGS="-Wall -Wextra -ansi -pedantic -g"
+#~ CFLAGS="-Wall -Wextra -ansi -pedantic -g -DCC_TRACE_LEVEL=3 -DCC_MEM_BUDGETS"
 #~ CFLAGS="-Wall -Wextra -ansi -pedantic -O2"
+
+# USDT probes (see caseconvert_probes.h) when systemtap's sdt.h is around
+if [ -f /usr/include/sys/sdt.h ]; then
+  CFLAGS="$CFLAGS -DHAVE_SYS_SDT_H"
+fi
+
 gcc -c caseconvert.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert.o
 gcc -c caseconvert_ui.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_ui.o
+gcc -c caseconvert_rulelist.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_rulelist.o
 gcc -c caseconvert_types.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_types.o
-gcc caseconvert_ui.o caseconvert_types.o caseconvert.o -g -o caseconvert.so -shared `pkg-config --libs geany`
+gcc -c caseconvert_trace.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_trace.o
+gcc -c caseconvert_mem.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_mem.o
+gcc -c caseconvert_engine.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_engine.o
+gcc -c caseconvert_record.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_record.o
+gcc -c caseconvert_words.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_words.o
+gcc -c caseconvert_ruleset.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_ruleset.o
+gcc -c caseconvert_acronyms.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_acronyms.o
+gcc -c caseconvert_grammar.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_grammar.o
+gcc -c caseconvert_search.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_search.o
+gcc -c caseconvert_occur.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_occur.o
+gcc -c caseconvert_scan.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_scan.o
+gcc -c caseconvert_plan.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_plan.o
+gcc -c caseconvert_map.c $CFLAGS -fPIC `pkg-config --cflags geany` -o caseconvert_map.o
+gcc caseconvert_ui.o caseconvert_rulelist.o caseconvert_types.o caseconvert_trace.o caseconvert_mem.o caseconvert_engine.o caseconvert_record.o caseconvert_words.o caseconvert_ruleset.o caseconvert_acronyms.o caseconvert_grammar.o caseconvert_search.o caseconvert_occur.o caseconvert_scan.o caseconvert_plan.o caseconvert_map.o caseconvert.o -g -o caseconvert.so -shared `pkg-config --libs geany`
+
+# the headless engine driver, only needs glib
+gcc caseconvert_tool.c caseconvert_engine.c caseconvert_ruleset.c caseconvert_acronyms.c caseconvert_grammar.c caseconvert_search.c caseconvert_occur.c caseconvert_scan.c caseconvert_plan.c caseconvert_map.c caseconvert_record.c caseconvert_words.c caseconvert_types.c caseconvert_trace.c caseconvert_mem.c $CFLAGS `pkg-config --cflags --libs glib-2.0` -o caseconvert-tool